@@ -0,0 +1,333 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: adpcm.cpp
+///
+/// summary: IMA ADPCM audio codec (WAVE format 0x0011 block layout)
+//////////////////////////////////////////////////////////////////////////
+
+#include "adpcm.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include <future>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define KVASIR_HAVE_SSE2
+# include <emmintrin.h>
+#endif
+
+namespace kvasir
+{
+
+namespace
+{
+
+constexpr int StepTable[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+	11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+	32767
+};
+
+constexpr int IndexTable[16] = {
+	-1, -1, -1, -1, 2, 4, 6, 8,
+	-1, -1, -1, -1, 2, 4, 6, 8
+};
+
+constexpr int MaxIndex = 88;
+
+// Number of blocks encoded by one pool job
+constexpr size_t BlocksPerJob = 64;
+
+//////////////////////////////////////////////////////////////////////////
+struct CodecState
+{
+	int predictor;
+	int index;
+};
+
+//////////////////////////////////////////////////////////////////////////
+inline uint8_t EncodeSample(CodecState& state, int sample)
+{
+	int step = StepTable[state.index];
+	int diff = sample - state.predictor;
+	uint8_t code = 0;
+	if (diff < 0)
+	{
+		code = 8;
+		diff = -diff;
+	}
+
+	int vpdiff = step >> 3;
+	if (diff >= step)
+	{
+		code |= 4;
+		diff -= step;
+		vpdiff += step;
+	}
+	step >>= 1;
+	if (diff >= step)
+	{
+		code |= 2;
+		diff -= step;
+		vpdiff += step;
+	}
+	step >>= 1;
+	if (diff >= step)
+	{
+		code |= 1;
+		vpdiff += step;
+	}
+
+	state.predictor += (code & 8) ? -vpdiff : vpdiff;
+	state.predictor = std::clamp(state.predictor, -32768, 32767);
+	state.index = std::clamp(state.index + IndexTable[code], 0, MaxIndex);
+	return code;
+}
+
+//////////////////////////////////////////////////////////////////////////
+inline int16_t DecodeSample(CodecState& state, uint8_t code)
+{
+	const int step = StepTable[state.index];
+	int vpdiff = step >> 3;
+	if (code & 4)
+		vpdiff += step;
+	if (code & 2)
+		vpdiff += step >> 1;
+	if (code & 1)
+		vpdiff += step >> 2;
+
+	state.predictor += (code & 8) ? -vpdiff : vpdiff;
+	state.predictor = std::clamp(state.predictor, -32768, 32767);
+	state.index = std::clamp(state.index + IndexTable[code], 0, MaxIndex);
+	return static_cast<int16_t>(state.predictor);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Blocks do not inherit the step index from their predecessors, so the
+/// first step is guessed from the opening of the block itself
+//////////////////////////////////////////////////////////////////////////
+int InitialIndex(const int16_t* samples, size_t count)
+{
+	if (count < 2)
+		return 0;
+
+	const int delta = std::abs(samples[1] - samples[0]);
+	const auto found = std::lower_bound(std::begin(StepTable), std::end(StepTable), delta);
+	return static_cast<int>(std::min<ptrdiff_t>(found - std::begin(StepTable), MaxIndex));
+}
+
+//////////////////////////////////////////////////////////////////////////
+void WriteHeader(uint8_t* out, const CodecState& state)
+{
+	const uint16_t predictor = static_cast<uint16_t>(state.predictor);
+	out[0] = static_cast<uint8_t>(predictor & 0xFF);
+	out[1] = static_cast<uint8_t>(predictor >> 8);
+	out[2] = static_cast<uint8_t>(state.index);
+	out[3] = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+inline void PutNibble(uint8_t* out, size_t position, uint8_t code)
+{
+	// Low nibble goes first
+	uint8_t& byte = out[4 + position / 2];
+	if (position & 1)
+		byte |= static_cast<uint8_t>(code << 4);
+	else
+		byte = code;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void EncodeBlock(const int16_t* samples, size_t samplesPerBlock, uint8_t* out)
+{
+	CodecState state{ samples[0], InitialIndex(samples, samplesPerBlock) };
+	WriteHeader(out, state);
+	for (size_t i = 1; i < samplesPerBlock; ++i)
+		PutNibble(out, i - 1, EncodeSample(state, samples[i]));
+}
+
+#ifdef KVASIR_HAVE_SSE2
+//////////////////////////////////////////////////////////////////////////
+/// The same algorithm as EncodeSample() run for four blocks in the lanes
+/// of SSE2 registers. Only the step table lookup stays scalar.
+//////////////////////////////////////////////////////////////////////////
+void EncodeBlocks4(const int16_t* const samples[4], size_t samplesPerBlock, uint8_t* const out[4])
+{
+	alignas(16) int32_t lanes[4];
+	alignas(16) int32_t codes[4];
+
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		const CodecState state{ samples[lane][0], InitialIndex(samples[lane], samplesPerBlock) };
+		WriteHeader(out[lane], state);
+		lanes[lane] = state.index;
+	}
+
+	const __m128i allOnes = _mm_set1_epi32(-1);
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i two = _mm_set1_epi32(2);
+	const __m128i four = _mm_set1_epi32(4);
+	const __m128i six = _mm_set1_epi32(6);
+	const __m128i seven = _mm_set1_epi32(7);
+	const __m128i eight = _mm_set1_epi32(8);
+	const __m128i maxIndex = _mm_set1_epi32(MaxIndex);
+
+	__m128i index = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+	__m128i predictor = _mm_set_epi32(samples[3][0], samples[2][0], samples[1][0], samples[0][0]);
+
+	for (size_t i = 1; i < samplesPerBlock; ++i)
+	{
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), index);
+		__m128i step = _mm_set_epi32(StepTable[lanes[3]], StepTable[lanes[2]],
+			StepTable[lanes[1]], StepTable[lanes[0]]);
+		const __m128i sample = _mm_set_epi32(samples[3][i], samples[2][i], samples[1][i], samples[0][i]);
+
+		// Sign and magnitude of the difference
+		__m128i diff = _mm_sub_epi32(sample, predictor);
+		const __m128i sign = _mm_srai_epi32(diff, 31);
+		diff = _mm_sub_epi32(_mm_xor_si128(diff, sign), sign);
+		__m128i code = _mm_and_si128(sign, eight);
+		__m128i vpdiff = _mm_srai_epi32(step, 3);
+
+		// Successive approximation of the magnitude
+		__m128i ge = _mm_xor_si128(_mm_cmpgt_epi32(step, diff), allOnes);
+		code = _mm_or_si128(code, _mm_and_si128(ge, four));
+		diff = _mm_sub_epi32(diff, _mm_and_si128(ge, step));
+		vpdiff = _mm_add_epi32(vpdiff, _mm_and_si128(ge, step));
+		step = _mm_srai_epi32(step, 1);
+
+		ge = _mm_xor_si128(_mm_cmpgt_epi32(step, diff), allOnes);
+		code = _mm_or_si128(code, _mm_and_si128(ge, two));
+		diff = _mm_sub_epi32(diff, _mm_and_si128(ge, step));
+		vpdiff = _mm_add_epi32(vpdiff, _mm_and_si128(ge, step));
+		step = _mm_srai_epi32(step, 1);
+
+		ge = _mm_xor_si128(_mm_cmpgt_epi32(step, diff), allOnes);
+		code = _mm_or_si128(code, _mm_and_si128(ge, one));
+		vpdiff = _mm_add_epi32(vpdiff, _mm_and_si128(ge, step));
+
+		// Update the predictor, saturating pack clamps it to 16 bits
+		predictor = _mm_add_epi32(predictor, _mm_sub_epi32(_mm_xor_si128(vpdiff, sign), sign));
+		const __m128i packed = _mm_packs_epi32(predictor, predictor);
+		predictor = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+
+		// Step index adjustment: -1 for magnitudes below 4, 2 * magnitude - 6 otherwise
+		const __m128i magnitude = _mm_and_si128(code, seven);
+		const __m128i small = _mm_cmplt_epi32(magnitude, four);
+		const __m128i adjust = _mm_or_si128(small,
+			_mm_andnot_si128(small, _mm_sub_epi32(_mm_slli_epi32(magnitude, 1), six)));
+		index = _mm_add_epi32(index, adjust);
+		index = _mm_andnot_si128(_mm_srai_epi32(index, 31), index);
+		const __m128i over = _mm_cmpgt_epi32(index, maxIndex);
+		index = _mm_or_si128(_mm_and_si128(over, maxIndex), _mm_andnot_si128(over, index));
+
+		_mm_store_si128(reinterpret_cast<__m128i*>(codes), code);
+		for (int lane = 0; lane < 4; ++lane)
+			PutNibble(out[lane], i - 1, static_cast<uint8_t>(codes[lane]));
+	}
+}
+#endif // KVASIR_HAVE_SSE2
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+std::vector<uint8_t> EncodeImaAdpcm(const std::vector<int16_t>& samples,
+	size_t blockAlign, ThreadPool* pool)
+{
+	if (blockAlign < 8 || blockAlign % 4)
+		throw std::invalid_argument("invalid IMA ADPCM block size: " + std::to_string(blockAlign));
+
+	const size_t samplesPerBlock = ImaAdpcmSamplesPerBlock(blockAlign);
+	const size_t blockCount = (samples.size() + samplesPerBlock - 1) / samplesPerBlock;
+	std::vector<uint8_t> result(blockCount * blockAlign);
+	if (!blockCount)
+		return result;
+
+	// Only the last block may need padding
+	std::vector<int16_t> tail(samples.begin() + (blockCount - 1) * samplesPerBlock, samples.end());
+	tail.resize(samplesPerBlock, tail.back());
+
+	const auto blockSamples = [&](size_t block)
+	{
+		return block + 1 < blockCount ? samples.data() + block * samplesPerBlock : tail.data();
+	};
+
+	const auto encodeRange = [&](size_t first, size_t last)
+	{
+		size_t block = first;
+#ifdef KVASIR_HAVE_SSE2
+		for (; block + 4 <= last; block += 4)
+		{
+			const int16_t* const in[4] = {
+				blockSamples(block), blockSamples(block + 1), blockSamples(block + 2), blockSamples(block + 3)
+			};
+			uint8_t* const out[4] = {
+				&result[block * blockAlign], &result[(block + 1) * blockAlign],
+				&result[(block + 2) * blockAlign], &result[(block + 3) * blockAlign]
+			};
+			EncodeBlocks4(in, samplesPerBlock, out);
+		}
+#endif // KVASIR_HAVE_SSE2
+		for (; block < last; ++block)
+			EncodeBlock(blockSamples(block), samplesPerBlock, &result[block * blockAlign]);
+	};
+
+	if (!pool || blockCount <= BlocksPerJob)
+	{
+		encodeRange(0, blockCount);
+		return result;
+	}
+
+	std::vector<std::future<void>> jobs;
+	for (size_t first = 0; first < blockCount; first += BlocksPerJob)
+	{
+		const size_t last = std::min(first + BlocksPerJob, blockCount);
+		jobs.emplace_back(pool->Submit([&encodeRange, first, last] { encodeRange(first, last); }));
+	}
+
+	for (auto& job : jobs)
+		job.get();
+
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::vector<int16_t> DecodeImaAdpcm(const std::vector<uint8_t>& data,
+	size_t blockAlign, size_t sampleCount)
+{
+	if (blockAlign < 8 || blockAlign % 4)
+		throw std::invalid_argument("invalid IMA ADPCM block size: " + std::to_string(blockAlign));
+
+	const size_t samplesPerBlock = ImaAdpcmSamplesPerBlock(blockAlign);
+	std::vector<int16_t> result;
+	result.reserve(sampleCount);
+
+	for (size_t offset = 0; offset + blockAlign <= data.size() && result.size() < sampleCount; offset += blockAlign)
+	{
+		const uint8_t* block = &data[offset];
+		CodecState state{
+			static_cast<int16_t>(block[0] | (block[1] << 8)),
+			std::min<int>(block[2], MaxIndex)
+		};
+		result.push_back(static_cast<int16_t>(state.predictor));
+
+		for (size_t i = 0; i + 1 < samplesPerBlock && result.size() < sampleCount; ++i)
+		{
+			const uint8_t byte = block[4 + i / 2];
+			const uint8_t code = (i & 1) ? (byte >> 4) : (byte & 0x0F);
+			result.push_back(DecodeSample(state, code));
+		}
+	}
+
+	if (result.size() != sampleCount)
+		throw std::runtime_error("truncated IMA ADPCM stream");
+
+	return result;
+}
+
+} // namespace kvasir
@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: adpcm.h
+///
+/// summary: IMA ADPCM audio codec (WAVE format 0x0011 block layout)
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_ADPCM_H_INCLUDED
+#define KVASIR_ADPCM_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kvasir
+{
+
+class ThreadPool;
+
+//////////////////////////////////////////////////////////////////////////
+/// Default size of the encoded mono block: 4 bytes of the header plus
+/// 2 samples per byte, 2041 samples per block (~4:1 compression)
+//////////////////////////////////////////////////////////////////////////
+constexpr size_t ImaAdpcmBlockAlign = 1024;
+
+//////////////////////////////////////////////////////////////////////////
+/// Number of samples in the mono block of the given size
+//////////////////////////////////////////////////////////////////////////
+constexpr size_t ImaAdpcmSamplesPerBlock(size_t blockAlign)
+{
+	return 1 + (blockAlign - 4) * 2;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Encode mono 16-bit samples into IMA ADPCM blocks. Every block is
+///   self-contained (its header carries the predictor and the step index),
+///   so blocks are encoded independently: four blocks at once in SIMD
+///   lanes and groups of blocks in parallel on the pool, if given.
+///   The last block is padded with the last sample.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+std::vector<uint8_t> EncodeImaAdpcm(const std::vector<int16_t>& samples,
+	size_t blockAlign = ImaAdpcmBlockAlign, ThreadPool* pool = nullptr);
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Decode IMA ADPCM blocks back into 16-bit samples
+/// </summary>
+///
+/// <param name="data"> Sequence of encoded blocks </param>
+/// <param name="blockAlign"> Size of the block, bytes </param>
+/// <param name="sampleCount"> Number of samples to decode (from the 'fact' chunk) </param>
+//////////////////////////////////////////////////////////////////////////
+std::vector<int16_t> DecodeImaAdpcm(const std::vector<uint8_t>& data,
+	size_t blockAlign, size_t sampleCount);
+
+} // namespace kvasir
+
+#endif // KVASIR_ADPCM_H_INCLUDED
@@ -0,0 +1,110 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: adpcm_test.cpp
+///
+/// summary: encode/decode round trip of the IMA ADPCM codec
+//////////////////////////////////////////////////////////////////////////
+
+#include "adpcm.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+
+namespace
+{
+
+constexpr double Pi = 3.14159265358979323846;
+
+int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////
+void Check(bool condition, const std::string& what)
+{
+	if (condition)
+		return;
+	std::cerr << "FAILED: " << what << std::endl;
+	++failures;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Voice-like test signal: two tones and some noise, 16 kHz
+//////////////////////////////////////////////////////////////////////////
+std::vector<int16_t> MakeSignal(size_t count)
+{
+	std::mt19937 random(42);
+	std::normal_distribution<double> noise(0, 300);
+	std::vector<int16_t> samples(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const double t = static_cast<double>(i) / 16000;
+		const double value = 9000 * std::sin(2 * Pi * 440 * t) + 4000 * std::sin(2 * Pi * 1250 * t) + noise(random);
+		samples[i] = static_cast<int16_t>(std::lround(std::max(-32768.0, std::min(32767.0, value))));
+	}
+	return samples;
+}
+
+//////////////////////////////////////////////////////////////////////////
+double SignalToNoise(const std::vector<int16_t>& original, const std::vector<int16_t>& decoded)
+{
+	double signal = 0, noise = 0;
+	for (size_t i = 0; i < original.size(); ++i)
+	{
+		const double error = static_cast<double>(original[i]) - decoded[i];
+		signal += static_cast<double>(original[i]) * original[i];
+		noise += error * error;
+	}
+	return 10 * std::log10(signal / std::max(noise, 1.0));
+}
+
+//////////////////////////////////////////////////////////////////////////
+void TestRoundTrip(size_t count, size_t blockAlign)
+{
+	const std::string name = std::to_string(count) + " samples in blocks of " + std::to_string(blockAlign);
+	const size_t perBlock = kvasir::ImaAdpcmSamplesPerBlock(blockAlign);
+	const size_t blocks = (count + perBlock - 1) / perBlock;
+
+	const std::vector<int16_t> samples = MakeSignal(count);
+	const std::vector<uint8_t> encoded = kvasir::EncodeImaAdpcm(samples, blockAlign);
+	Check(encoded.size() == blocks * blockAlign, name + ": encoded size");
+
+	const std::vector<int16_t> decoded = kvasir::DecodeImaAdpcm(encoded, blockAlign, count);
+	Check(decoded.size() == count, name + ": decoded size");
+	if (decoded.size() != count)
+		return;
+
+	// The header of every block carries its first sample as is
+	for (size_t block = 0; block < blocks; ++block)
+		Check(decoded[block * perBlock] == samples[block * perBlock], name + ": first sample of block " + std::to_string(block));
+
+	if (count >= perBlock)
+	{
+		const double snr = SignalToNoise(samples, decoded);
+		Check(snr > 30, name + ": SNR " + std::to_string(snr) + " dB");
+	}
+
+	// Blocks are independent: the parallel encoder gives the same bytes
+	kvasir::ThreadPool pool(4);
+	Check(kvasir::EncodeImaAdpcm(samples, blockAlign, &pool) == encoded, name + ": parallel encoding");
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+int main()
+{
+	TestRoundTrip(0, kvasir::ImaAdpcmBlockAlign);
+	TestRoundTrip(1, kvasir::ImaAdpcmBlockAlign);
+	TestRoundTrip(kvasir::ImaAdpcmSamplesPerBlock(kvasir::ImaAdpcmBlockAlign), kvasir::ImaAdpcmBlockAlign);
+	TestRoundTrip(16000 * 10 + 7, kvasir::ImaAdpcmBlockAlign);
+	TestRoundTrip(16000 * 3 + 1, 256);
+
+	if (failures)
+		std::cerr << failures << " checks failed" << std::endl;
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
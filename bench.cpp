@@ -0,0 +1,499 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: bench.cpp
+///
+/// summary: microbenchmarks of the hot paths
+//////////////////////////////////////////////////////////////////////////
+
+#include "serial_transport.h"
+#include "scan_settings.h"
+#include "scanner.h"
+#include "channel.h"
+#include "logger.h"
+#include "group.h"
+#include "trace.h"
+#include "name_index.h"
+
+#include <unordered_map>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <new>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <ctime>
+
+#ifdef _WIN32
+# define safe_localtime(timePoint,brokenTime) localtime_s(brokenTime, timePoint)
+#else
+# define safe_localtime(timepoint,brokenTime) localtime_r(timepoint, brokenTime)
+#endif // _WIN32
+
+// The replaced operators new and delete must not be inlined: GCC would
+// see malloc() paired with the operator delete or vice versa and report
+// a mismatch
+#ifdef _MSC_VER
+# define BENCH_NOINLINE __declspec(noinline)
+#else
+# define BENCH_NOINLINE __attribute__((noinline))
+#endif // _MSC_VER
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+using BenchClock = std::chrono::steady_clock;
+
+// Results are accumulated here so that the compiler can't drop the work
+volatile size_t g_sink = 0;
+
+// Heap allocations made by the process, counted by the operator new below
+std::atomic<size_t> g_allocations{ 0 };
+
+//////////////////////////////////////////////////////////////////////////
+struct BenchResult
+{
+	std::string name;
+	double nanoseconds;                     // Per operation
+	double allocations;                     // Per operation
+	size_t iterations;
+};
+
+std::vector<BenchResult> g_results;
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+BENCH_NOINLINE void* operator new(std::size_t size)
+{
+	g_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+//////////////////////////////////////////////////////////////////////////
+BENCH_NOINLINE void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+//////////////////////////////////////////////////////////////////////////
+BENCH_NOINLINE void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Run the operation in batches of growing size until a batch takes
+///   long enough to measure, then report the time and the number of heap
+///   allocations per operation
+/// </summary>
+///
+/// <param name="name"> Name of the benchmark </param>
+/// <param name="minTime"> Minimal duration of the measured batch </param>
+/// <param name="operation"> Operation to measure </param>
+//////////////////////////////////////////////////////////////////////////
+void Run(const std::string& name, std::chrono::milliseconds minTime, const std::function<void()>& operation)
+{
+	size_t iterations = 1;
+	for (;;)
+	{
+		const size_t allocations = g_allocations.load(std::memory_order_relaxed);
+		const BenchClock::time_point start = BenchClock::now();
+		for (size_t i = 0; i < iterations; ++i)
+			operation();
+		const BenchClock::duration elapsed = BenchClock::now() - start;
+
+		if (elapsed >= minTime || iterations >= (size_t(1) << 32))
+		{
+			BenchResult result;
+			result.name = name;
+			result.nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+			result.allocations = double(g_allocations.load(std::memory_order_relaxed) - allocations) / iterations;
+			result.iterations = iterations;
+
+			std::cout << std::left << std::setw(28) << name << std::right
+				<< std::setw(12) << std::fixed << std::setprecision(1) << result.nanoseconds << " ns/op"
+				<< std::setw(10) << std::setprecision(2) << result.allocations << " allocs/op"
+				<< std::setw(14) << iterations << " iterations" << std::endl;
+			g_results.push_back(std::move(result));
+			return;
+		}
+		iterations *= 2;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Preamble of the log message as it was formatted before the caching
+//////////////////////////////////////////////////////////////////////////
+std::string LegacyPreamble(kvasir::LogLevel level)
+{
+	std::ostringstream buf;
+	const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+	const std::time_t timeNow = std::chrono::system_clock::to_time_t(now);
+	std::tm brokenTime;
+	safe_localtime(&timeNow, &brokenTime);
+	std::chrono::system_clock::duration milliseconds = now.time_since_epoch();
+	milliseconds -= std::chrono::duration_cast<std::chrono::seconds>(milliseconds);
+
+	buf << std::setw(4) << std::setfill('0') << brokenTime.tm_year + 1900
+		<< '-' << std::setw(2) << std::setfill('0') << brokenTime.tm_mon + 1
+		<< '-' << std::setw(2) << std::setfill('0') << brokenTime.tm_mday
+		<< ' ' << std::setw(2) << std::setfill('0') << brokenTime.tm_hour
+		<< ':' << std::setw(2) << std::setfill('0') << brokenTime.tm_min
+		<< ':' << std::setw(2) << std::setfill('0') << brokenTime.tm_sec
+		<< '.' << std::setw(3) << std::setfill('0') << milliseconds / std::chrono::milliseconds(1)
+		<< ' ' << std::hex << std::this_thread::get_id() << ' ';
+
+	switch (level)
+	{
+	case kvasir::LOG_DEBUG:
+		buf << "DBG ";
+		break;
+	case kvasir::LOG_INFO:
+		buf << "INF ";
+		break;
+	case kvasir::LOG_ERROR:
+		buf << "ERR ";
+		break;
+	case kvasir::LOG_NONE:
+		break;
+	}
+
+	return buf.str();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void LoggerBenchmarks(std::chrono::milliseconds minTime)
+{
+	const std::string message = "GLG,01234567,NFM,,0,,,Fire Dispatch,1,0,,,";
+
+	Run("preamble/legacy", minTime, [] {
+		g_sink = g_sink + LegacyPreamble(kvasir::LOG_INFO).size();
+	});
+
+	Run("preamble/cached", minTime, [] {
+		char buffer[kvasir::LogPreambleCapacity];
+		g_sink = g_sink + kvasir::FormatLogPreamble(kvasir::LOG_INFO, std::chrono::system_clock::now(), buffer);
+	});
+
+	// Whole message written to a file: the former PutMessage body against
+	// the logger itself
+	const fs::path logDir = fs::temp_directory_path() / "kvasir-bench";
+	fs::create_directories(logDir);
+	{
+		std::ofstream legacyFile(logDir / "legacy.log");
+		Run("put_message/legacy", minTime, [&] {
+			std::unique_ptr<std::ostringstream> text(new std::ostringstream());
+			*text << message;
+			const std::string preamble = LegacyPreamble(kvasir::LOG_INFO);
+			legacyFile << preamble << text->str() << std::endl;
+		});
+	}
+
+	kvasir::Logger& log = kvasir::Logger::GetInstance();
+	log.EnableConsoleChannel(kvasir::LOG_NONE);
+	log.EnableFileChannel(logDir.string(), false, kvasir::LOG_INFO);
+	Run("put_message/current", minTime, [&] {
+		log.Info() << message;
+	});
+
+	// Debug statement while the debug level is off: the former printer
+	// allocated and formatted before the level was checked
+	const std::string index = "42";
+	Run("debug_disabled/legacy", minTime, [&] {
+		std::unique_ptr<std::ostringstream> text(new std::ostringstream());
+		*text << "reading system " << index;
+		g_sink = g_sink + text->str().size();
+	});
+	Run("debug_disabled/printer", minTime, [&] {
+		log.Debug() << "reading system " << index;
+	});
+	Run("debug_disabled/macro", minTime, [&] {
+		KVASIR_LOG(DEBUG) << "reading system " << index;
+	});
+	log.EnableFileChannel(logDir.string(), false, kvasir::LOG_NONE);
+
+	std::error_code err;
+	fs::remove_all(logDir, err);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void TraceBenchmarks(std::chrono::milliseconds minTime)
+{
+	const std::string reply = "GLG,01234567,NFM,,0,,,Fire Dispatch,1,0,,,\r";
+
+	Run("trace/closed", minTime, [&] {
+		KVASIR_TRACE("reply {} in {} us", reply, 1234);
+	});
+
+	const fs::path tracePath = fs::temp_directory_path() / "kvasir-bench.trace";
+	kvasir::Tracer::Open(tracePath.string());
+	Run("trace/open", minTime, [&] {
+		KVASIR_TRACE("reply {} in {} us", reply, 1234);
+	});
+	kvasir::Tracer::Close();
+
+	std::error_code err;
+	fs::remove(tracePath, err);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Radio answering from memory at once: the host side of a transaction
+///   without the wire
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class MemoryTransport : public kvasir::SerialTransport
+{
+	std::unordered_map<std::string, std::string> m_replies;
+	const std::string* m_reply = nullptr;
+	size_t m_offset = 0;
+
+public:
+	void Add(const std::string& command, const std::string& reply)
+	{
+		m_replies[command + '\r'] = reply + '\r';
+	}
+
+	void Write(const char* data, size_t size) override
+	{
+		const auto found = m_replies.find(std::string(data, size));
+		if (found == m_replies.end())
+			throw std::runtime_error("no reply to " + std::string(data, size));
+		m_reply = &found->second;
+		m_offset = 0;
+	}
+
+	size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds) override
+	{
+		const size_t size = std::min(capacity, m_reply->size() - m_offset);
+		std::copy_n(m_reply->data() + m_offset, size, buffer);
+		m_offset += size;
+		return size;
+	}
+
+	bool IsOpen() const noexcept override
+	{
+		return true;
+	}
+
+	void Close() override
+	{}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// SIN reply of the system in the chain of the given length
+//////////////////////////////////////////////////////////////////////////
+std::string SystemInfo(int index, int count)
+{
+	std::vector<std::string> sin(28);
+	sin[0] = index % 2 ? "MOT" : "CNV";
+	sin[1] = "System " + std::to_string(index);
+	sin[2] = ".";
+	sin[3] = sin[4] = "0";
+	sin[5] = "2";
+	sin[11] = index ? std::to_string(index - 1) : "-1";
+	sin[12] = index + 1 < count ? std::to_string(index + 1) : "-1";
+	sin[13] = sin[14] = "-1";
+	sin[15] = std::to_string(index + 1);
+	sin[16] = ".";
+	sin[22] = "NONE";
+	sin[23] = sin[24] = sin[26] = "0";
+	sin[25] = "400";
+
+	std::string reply = "SIN";
+	for (const auto& value : sin)
+		reply += ',' + value;
+	return reply;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// TRN reply of a trunked system showing decimal IDs
+//////////////////////////////////////////////////////////////////////////
+std::string TrunkInfo()
+{
+	std::vector<std::string> trn(29, "0");
+	trn[20] = trn[21] = trn[22] = trn[23] = "-1";
+
+	std::string reply = "TRN";
+	for (const auto& value : trn)
+		reply += ',' + value;
+	return reply;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void ParsingBenchmarks(std::chrono::milliseconds minTime)
+{
+	const std::string glg = "0154.4300,NFM,0,0,County,Fire,Dispatch,1,0,NONE,1,NONE";
+	const std::string sin = SystemInfo(5, 10).substr(4);
+
+	Run("split_string/glg", minTime, [&] {
+		g_sink = g_sink + kvasir::SplitString(glg).size();
+	});
+	Run("split_string/sin", minTime, [&] {
+		g_sink = g_sink + kvasir::SplitString(sin).size();
+	});
+
+	const std::string modulations[] = { "AM", "FM", "NFM", "WFM", "FMB" };
+	size_t next = 0;
+	Run("mod_from_string", minTime, [&] {
+		g_sink = g_sink + static_cast<size_t>(kvasir::ModFromString(modulations[next++ % 5]));
+	});
+
+	const std::string systemTypes[] = { "CNV", "MOT", "EDC", "LTR", "P25S" };
+	Run("system_type_from_string", minTime, [&] {
+		g_sink = g_sink + static_cast<size_t>(*kvasir::SystemTypeFromString(systemTypes[next++ % 5]));
+	});
+
+	const std::string ids[] = { "0154.4300", "0851.0125", "2416", "1F4A", "05-123" };
+	Run("freq_or_tgid", minTime, [&] {
+		g_sink = g_sink + kvasir::ParseFreqOrTgid(ids[next++ % 5]).value;
+	});
+
+	// Whole transactions against the radio answering at once
+	constexpr int SystemCount = 100;
+	auto transport = std::make_unique<MemoryTransport>();
+	transport->Add("GLG", "GLG," + glg);
+	transport->Add("PRG", "PRG,OK");
+	transport->Add("EPG", "EPG,OK");
+	transport->Add("SCT", "SCT," + std::to_string(SystemCount));
+	transport->Add("SIH", "SIH,0");
+	transport->Add("SIT", "SIT," + std::to_string(SystemCount - 1));
+	for (int i = 0; i < SystemCount; ++i)
+	{
+		transport->Add("SIN, " + std::to_string(i), SystemInfo(i, SystemCount));
+		transport->Add("TRN," + std::to_string(i), TrunkInfo());
+	}
+
+	kvasir::Scanner scanner;
+	scanner.Connect(std::move(transport));
+	const kvasir::ScanSettings noSystems;
+	Run("reception_status", minTime, [&] {
+		g_sink = g_sink + scanner.GetReceptionStatus(noSystems).freq.value;
+	});
+
+	// Building System objects from the SIN replies
+	Run("scan_settings/load_100", minTime, [&] {
+		kvasir::ScanSettings settings;
+		settings.Load(scanner);
+		g_sink = g_sink + settings.Systems().size();
+	});
+
+	// Readers of the published settings, alone and while a reload replaces them
+	kvasir::ScanSettingsStore store;
+	store.Reload(scanner);
+	Run("scan_settings/snapshot", minTime, [&] {
+		g_sink = g_sink + store.Current()->Systems().size();
+	});
+
+	std::atomic<bool> reloading{ true };
+	std::thread reloader([&] {
+		while (reloading)
+			store.Reload(scanner);
+	});
+	Run("scan_settings/snapshot_reloading", minTime, [&] {
+		g_sink = g_sink + store.Current()->Systems().size();
+	});
+	reloading = false;
+	reloader.join();
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Search of 100k made-up alpha tags as the operator types
+//////////////////////////////////////////////////////////////////////////
+void NameIndexBenchmarks(std::chrono::milliseconds minTime)
+{
+	const char* const places[] = { "CITY", "COUNTY", "STATE", "NORTH", "SOUTH", "METRO", "VALLEY", "HARBOR" };
+	const char* const services[] = { "FIRE", "POLICE", "EMS", "PW", "SCHOOL", "TRANSIT", "SHERIFF", "UTIL" };
+	const char* const talkgroups[] = { "DISPATCH", "TAC", "OPS", "CMD", "FIREGROUND", "MAIN", "ALT", "EVENTS" };
+
+	constexpr int NameCount = 100000;
+	kvasir::NameIndex index;
+	for (int i = 0; i < NameCount; ++i)
+	{
+		const std::string name = std::string(places[i % 8]) + ' ' + services[i / 8 % 8] + ' ' +
+			talkgroups[i / 64 % 8] + ' ' + std::to_string(i / 512 % 20);
+		index.Add(kvasir::NameRef{ kvasir::NameKind::Channel, i / 10000, i / 100 % 100, i % 100 }, name);
+	}
+	std::cout << "name index of " << index.Size() << " names: " << index.MemoryUsage() / 1024 << " KiB" << std::endl;
+
+	const std::string queries[] = { "f", "fi", "fire", "fire d", "fire disp", "tac 3" };
+	size_t next = 0;
+	Run("name_index/find_100k", minTime, [&] {
+		g_sink = g_sink + index.Find(queries[next++ % 6]).size();
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Write the results as JSON for comparison between the builds:
+///   {"benchmarks": [{"name", "ns_per_op", "allocs_per_op", "iterations"}]}
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+void WriteResults(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open " + path);
+
+	file << "{\n  \"benchmarks\": [";
+	for (size_t i = 0; i < g_results.size(); ++i)
+	{
+		const BenchResult& result = g_results[i];
+		file << (i ? "," : "") << "\n    {\"name\": \"" << result.name << '"'
+			<< std::fixed << std::setprecision(2)
+			<< ", \"ns_per_op\": " << result.nanoseconds
+			<< ", \"allocs_per_op\": " << result.allocations
+			<< ", \"iterations\": " << result.iterations << '}';
+	}
+	file << "\n  ]\n}\n";
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+try
+{
+	// Options: min duration of the measurement, ms; file for the results
+	std::chrono::milliseconds minTime(200);
+	std::string jsonPath;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		if ("--min-time" == option)
+			minTime = std::chrono::milliseconds(std::strtoul(argv[i + 1], nullptr, 10));
+		else if ("--json" == option)
+			jsonPath = argv[i + 1];
+	}
+
+	ParsingBenchmarks(minTime);
+	LoggerBenchmarks(minTime);
+	TraceBenchmarks(minTime);
+	NameIndexBenchmarks(minTime);
+
+	if (!jsonPath.empty())
+		WriteResults(jsonPath);
+	return 0;
+}
+catch (const std::exception& e)
+{
+	std::cerr << "failure: " << e.what() << std::endl;
+	return 1;
+}
@@ -0,0 +1,136 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: bounded_queue.h
+///
+/// summary: lock-free bounded multiple producers queue
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_BOUNDED_QUEUE_H_INCLUDED
+#define KVASIR_BOUNDED_QUEUE_H_INCLUDED
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Bounded queue based on the array of sequenced cells (D. Vyukov):
+///   any number of threads may push and pop concurrently, none of them
+///   takes a lock. Push fails instead of waiting when the queue is full.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+template<typename T>
+class BoundedQueue
+{
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	const size_t m_mask;
+	std::unique_ptr<Cell[]> m_cells;
+	alignas(64) std::atomic<size_t> m_enqueuePos;
+	alignas(64) std::atomic<size_t> m_dequeuePos;
+
+	static size_t RoundUp(size_t value)
+	{
+		size_t result = 2;
+		while (result < value)
+			result <<= 1;
+		return result;
+	}
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// Capacity is rounded up to the next power of two
+	//////////////////////////////////////////////////////////////////////////
+	explicit BoundedQueue(size_t capacity)
+		: m_mask(RoundUp(capacity) - 1)
+		, m_cells(new Cell[m_mask + 1])
+		, m_enqueuePos(0)
+		, m_dequeuePos(0)
+	{
+		for (size_t i = 0; i <= m_mask; ++i)
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	size_t Capacity() const noexcept
+	{
+		return m_mask + 1;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Returns false if the queue is full, the item is left intact then
+	//////////////////////////////////////////////////////////////////////////
+	bool TryPush(T& item)
+	{
+		Cell* cell;
+		size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const ptrdiff_t diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos);
+			if (diff == 0)
+			{
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->data = std::move(item);
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Returns false if the queue is empty
+	//////////////////////////////////////////////////////////////////////////
+	bool TryPop(T& item)
+	{
+		Cell* cell;
+		size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &m_cells[pos & m_mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const ptrdiff_t diff = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		item = std::move(cell->data);
+		cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_BOUNDED_QUEUE_H_INCLUDED
@@ -17,13 +17,18 @@
 namespace kvasir
 {
 
+// Scanner audio is voice band. Below the telephone rate, the pre-roll and
+// the 5 ms blocks of the squelch are down to a handful of samples, and at
+// 0 the recorder has no buffer and divides by the rate
+constexpr unsigned int MinimumSampleRate = 8000;
+
 struct Config::Impl
 {
 	QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
 
 	Impl(const std::string& configPath)
 	{
-		Logger::GetInstance().Debug() << "reading configuration file " << configPath;
+		KVASIR_LOG(DEBUG) << "reading configuration file " << configPath;
 		db.setDatabaseName(QString(configPath.c_str()));
 		if (!db.open())
 		{
@@ -44,6 +49,7 @@ Config::Config(const std::string& path)
 	:m_impl(std::make_unique<Impl>(path))
 {
 	ReadDevices();
+	ReadRecordings();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -52,6 +58,12 @@ const std::vector<Device>& Config::GetDevices() const noexcept
 	return m_devices;
 }
 
+//////////////////////////////////////////////////////////////////////////
+const std::vector<Recording>& Config::GetRecordings() const noexcept
+{
+	return m_recordings;
+}
+
 //////////////////////////////////////////////////////////////////////////
 void Config::ReadDevices()
 {
@@ -66,7 +78,37 @@ void Config::ReadDevices()
 		const bool parityCheck = query.value(5).toBool();
 		m_devices.emplace_back(Device{ name, port, bauds, dataBits, stopBits, parityCheck });
 	}
-	Logger::GetInstance().Debug() << m_devices.size() << " devices are configured";
+	KVASIR_LOG(DEBUG) << m_devices.size() << " devices are configured";
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Config::ReadRecordings()
+{
+	// Recording settings are optional
+	if (!m_impl->db.tables().contains("recording"))
+		return;
+
+	QSqlQuery query("select device, audio_input, directory, sample_rate, pre_roll_ms, hang_time_ms, squelch_db, codec, padding_ms from recording");
+	while (query.next())
+	{
+		const auto device = query.value(0).toString().toStdString();
+		const auto audioInput = query.value(1).toString().toStdString();
+		const auto directory = query.value(2).toString().toStdString();
+		const unsigned int sampleRate = query.value(3).toUInt();
+		if (sampleRate < MinimumSampleRate)
+		{
+			throw std::runtime_error("recording of device " + device + ": sample rate " + std::to_string(sampleRate) +
+				" Hz is below " + std::to_string(MinimumSampleRate) + " Hz");
+		}
+		const unsigned int preRollMs = query.value(4).toUInt();
+		const unsigned int hangTimeMs = query.value(5).toUInt();
+		const int squelchDb = query.value(6).toInt();
+		const auto codec = query.value(7).toString().toStdString();
+		const int paddingMs = query.value(8).toInt();
+		m_recordings.emplace_back(Recording{ device, audioInput, directory, sampleRate, preRollMs,
+			hangTimeMs, squelchDb, codec, paddingMs });
+	}
+	KVASIR_LOG(DEBUG) << m_recordings.size() << " recordings are configured";
 }
 
 } // namespace kvasir
\ No newline at end of file
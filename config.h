@@ -24,19 +24,35 @@ struct Device
 	bool parityCheck;
 };
 
+struct Recording
+{
+	std::string device;          // Name of the device the audio input is wired to
+	std::string audioInput;      // Name of the audio input, empty means default one
+	std::string directory;       // Directory for recorded clips, empty means default one
+	unsigned int sampleRate;     // Capture sample rate, Hz
+	unsigned int preRollMs;      // Audio kept before the squelch opens, ms
+	unsigned int hangTimeMs;     // Time to wait after the squelch closes, ms
+	int squelchDb;               // Audio level to detect the transmission at, dBFS (0 - off)
+	std::string codec;           // Encoding of the clips: "pcm" or "adpcm"
+	int paddingMs;               // Silence kept around the speech, ms (negative - no trimming)
+};
+
 class Config
 {
 	struct Impl;
 	std::unique_ptr<Impl> m_impl;
 	std::vector<Device> m_devices;
+	std::vector<Recording> m_recordings;
 
 	void ReadDevices();
+	void ReadRecordings();
 
 public:
 	explicit Config(const std::string& path);
 	~Config();
 
 	const std::vector<Device>& GetDevices() const noexcept;	
+	const std::vector<Recording>& GetRecordings() const noexcept;
 };
 
 #endif // KVASIR_CONFIG_H_INCLUDED
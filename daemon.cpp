@@ -0,0 +1,363 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: daemon.cpp
+///
+/// summary: sharing of the radio among local processes
+//////////////////////////////////////////////////////////////////////////
+
+#include "daemon.h"
+#include "scanner.h"
+#include "metrics.h"
+#include "logger.h"
+#include "timebase.h"
+#include "socket_transport.h"
+
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QLocalServer>
+#include <QtNetwork/QLocalSocket>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <deque>
+
+namespace kvasir
+{
+
+namespace
+{
+
+// Commands are a few dozens of bytes: anything longer is not a client
+constexpr int MaxCommandSize = 1024;
+
+//////////////////////////////////////////////////////////////////////////
+/// Commands which only read the radio: asking twice at once gets the same
+//////////////////////////////////////////////////////////////////////////
+bool IsCoalescable(const std::string& command)
+{
+	static const char* const queries[] = { "GLG", "MDL", "VER", "SCT", "SIH", "SIT", "SIN" };
+	return std::any_of(std::begin(queries), std::end(queries),
+		[&command](const char* query) { return command.compare(0, 3, query) == 0; });
+}
+
+//////////////////////////////////////////////////////////////////////////
+CommandPriority PriorityOf(const std::string& command)
+{
+	if (command.compare(0, 3, "GLG") == 0)
+		return CommandPriority::Monitoring;
+
+	static const char* const reads[] = { "SCT", "SIH", "SIT", "SIN" };
+	if (std::any_of(std::begin(reads), std::end(reads),
+		[&command](const char* read) { return command.compare(0, 3, read) == 0; }))
+		return CommandPriority::Bulk;
+	return CommandPriority::Interactive;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+struct Daemon::Impl
+{
+	struct Client;
+
+	// Reply shared by all the clients asking, written to each of them
+	struct Transaction
+	{
+		std::string command;
+		const Client* origin = nullptr;                 // Client which sent it first
+		QByteArray reply;
+		bool done = false;
+		std::vector<std::weak_ptr<Client>> clients;     // To write the reply to
+	};
+
+	struct Client
+	{
+		QIODevice* socket;
+		QByteArray input;
+		std::deque<std::shared_ptr<Transaction>> waiting; // In the order of the commands
+	};
+
+	const Scanner& scanner;
+	const Clock::duration statusMaxAge;
+	QLocalServer localServer;
+	QTcpServer tcpServer;
+	std::unordered_map<QIODevice*, std::shared_ptr<Client>> clients;
+	std::unordered_map<std::string, std::shared_ptr<Transaction>> inFlight;
+	QByteArray status;                                  // The last reply to GLG
+	Timestamp statusTime;
+	const Client* programmer = nullptr;                 // Client in programming mode
+	std::function<void()> linkLostHandler;
+	std::function<void(bool)> programmingHandler;
+
+	Gauge& connectedClients = Metrics::GetInstance().AddGauge("kvasir_daemon_clients",
+		"Clients connected to the daemon.");
+	Counter& requests = Metrics::GetInstance().AddCounter("kvasir_daemon_requests_total",
+		"Commands received from the clients.");
+	Counter& coalesced = Metrics::GetInstance().AddCounter("kvasir_daemon_coalesced_total",
+		"Commands answered with the reply to another client's command.");
+	Counter& transactions = Metrics::GetInstance().AddCounter("kvasir_daemon_transactions_total",
+		"Commands sent to the radio on behalf of the clients.");
+
+	Impl(const Scanner& scanner, std::chrono::milliseconds statusMaxAge)
+		: scanner(scanner)
+		, statusMaxAge(statusMaxAge)
+	{}
+
+	~Impl()
+	{
+		// The reply handlers refer to the server
+		localServer.close();
+		tcpServer.close();
+		scanner.Sync();
+
+		// The servers outlive the clients and delete the sockets: the sockets
+		// must not report their disconnection to the map gone by then
+		for (const auto& client : clients)
+			QObject::disconnect(client.first, nullptr, nullptr, nullptr);
+		clients.clear();
+	}
+
+	template<typename Server, typename Socket>
+	void Accept(Server& server, void (Socket::*disconnected)())
+	{
+		while (Socket* socket = server.nextPendingConnection())
+		{
+			auto client = std::make_shared<Client>();
+			client->socket = socket;
+			clients.emplace(socket, client);
+			connectedClients.Set(static_cast<int64_t>(clients.size()));
+			KVASIR_LOG(DEBUG) << "daemon client connected, " << clients.size() << " in total";
+
+			QObject::connect(socket, disconnected, [this, socket] { Drop(socket); });
+			QObject::connect(socket, &QIODevice::readyRead, [this, socket] { Read(socket); });
+		}
+	}
+
+	void Drop(QIODevice* socket)
+	{
+		const auto found = clients.find(socket);
+		if (found != clients.end() && found->second.get() == programmer)
+		{
+			// Let the others use the radio again
+			Logger::GetInstance().Error() << "daemon client left programming mode open, leaving it";
+			SetProgrammer(nullptr);
+			auto transaction = std::make_shared<Transaction>();
+			transaction->command = "EPG\r";
+			Send(transaction);
+		}
+
+		if (clients.erase(socket))
+		{
+			connectedClients.Set(static_cast<int64_t>(clients.size()));
+			KVASIR_LOG(DEBUG) << "daemon client disconnected, " << clients.size() << " left";
+		}
+		socket->deleteLater();
+	}
+
+	void Read(QIODevice* socket)
+	{
+		const auto found = clients.find(socket);
+		if (found == clients.end())
+			return;
+		const std::shared_ptr<Client> client = found->second;
+
+		client->input += socket->readAll();
+		for (int end = client->input.indexOf('\r'); end >= 0; end = client->input.indexOf('\r'))
+		{
+			std::string command(client->input.constData(), static_cast<size_t>(end) + 1);
+			client->input.remove(0, end + 1);
+
+			// Terminals end the lines with "\r\n"
+			command.erase(0, command.find_first_not_of('\n'));
+			if (command.size() > 1)
+				Request(client, std::move(command));
+		}
+
+		if (client->input.size() > MaxCommandSize)
+		{
+			Logger::GetInstance().Error() << "daemon client sent no command in " << MaxCommandSize << " bytes";
+			socket->close();
+		}
+	}
+
+	void Request(const std::shared_ptr<Client>& client, std::string command)
+	{
+		requests.Increment();
+
+		// Programming mode belongs to one client until it leaves it: the
+		// others get the radio's refusal to whatever they send meanwhile,
+		// nothing of theirs goes to the radio in the middle of the session
+		const bool enter = command.compare(0, 3, "PRG") == 0;
+		const bool leave = command.compare(0, 3, "EPG") == 0;
+		std::shared_ptr<Transaction> transaction;
+		if (programmer && programmer != client.get())
+		{
+			transaction = std::make_shared<Transaction>();
+			transaction->reply = QByteArray(command.data(), static_cast<int>(std::min<size_t>(command.size() - 1, 3)));
+			transaction->reply.append(",NG\r");
+			transaction->done = true;
+		}
+		else if (command == "GLG\r" && !status.isEmpty() && Clock::now() - statusTime <= statusMaxAge)
+		{
+			transaction = std::make_shared<Transaction>();
+			transaction->reply = status;
+			transaction->done = true;
+			coalesced.Increment();
+		}
+		else if (IsCoalescable(command) && inFlight.count(command))
+		{
+			transaction = inFlight[command];
+			coalesced.Increment();
+		}
+		else
+		{
+			if (enter)
+				SetProgrammer(client.get());
+			else if (leave)
+				SetProgrammer(nullptr);
+
+			transaction = std::make_shared<Transaction>();
+			transaction->command = command;
+			transaction->origin = client.get();
+			if (IsCoalescable(command))
+				inFlight.emplace(command, transaction);
+			Send(transaction);
+		}
+
+		client->waiting.push_back(transaction);
+		if (transaction->done)
+			Flush(*client);
+		else
+			transaction->clients.push_back(client);
+	}
+
+	void SetProgrammer(const Client* client)
+	{
+		const bool changed = !programmer != !client;
+		programmer = client;
+		if (changed && programmingHandler)
+			programmingHandler(client != nullptr);
+	}
+
+	void Send(const std::shared_ptr<Transaction>& transaction)
+	{
+		transactions.Increment();
+		scanner.Post(transaction->command, [this, transaction](RawReply reply, std::exception_ptr error) {
+			QMetaObject::invokeMethod(&localServer, [this, transaction, reply = std::move(reply), error] {
+				Complete(transaction, reply, error);
+			}, Qt::QueuedConnection);
+		}, PriorityOf(transaction->command));
+	}
+
+	void Complete(const std::shared_ptr<Transaction>& transaction, const RawReply& reply, std::exception_ptr error)
+	{
+		if (error)
+		{
+			// The radio's own answer to a command it can't carry out
+			try
+			{
+				std::rethrow_exception(error);
+			}
+			catch (const std::exception& e)
+			{
+				Logger::GetInstance().Error() << "daemon failed to forward a command: " << e.what();
+			}
+			transaction->reply = QByteArray("ERR\r");
+		}
+		else
+		{
+			transaction->reply = QByteArray(reply.text.data(), static_cast<int>(reply.text.size()));
+			transaction->reply.append("\r", 1);
+			if (transaction->command == "GLG\r")
+			{
+				status = transaction->reply;
+				statusTime = reply.received;
+			}
+		}
+		transaction->done = true;
+		if (transaction->command == "PRG\r" && transaction->reply != QByteArray("PRG,OK\r") &&
+			programmer == transaction->origin)
+			SetProgrammer(nullptr);
+
+		const auto found = inFlight.find(transaction->command);
+		if (found != inFlight.end() && found->second == transaction)
+			inFlight.erase(found);
+
+		for (const auto& subscriber : std::exchange(transaction->clients, {}))
+		{
+			if (const auto client = subscriber.lock())
+				Flush(*client);
+		}
+
+		// Without the monitor nothing else would notice the port is gone
+		if (error && !scanner.IsConnected() && linkLostHandler)
+			linkLostHandler();
+	}
+
+	static void Flush(Client& client)
+	{
+		while (!client.waiting.empty() && client.waiting.front()->done)
+		{
+			client.socket->write(client.waiting.front()->reply);
+			client.waiting.pop_front();
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+Daemon::Daemon(const Scanner& scanner, const std::string& address, std::chrono::milliseconds statusMaxAge)
+	: m_impl(std::make_unique<Impl>(scanner, statusMaxAge))
+{
+	uint16_t port = 0;
+	if (ParseLoopbackPort(address, port))
+	{
+		QObject::connect(&m_impl->tcpServer, &QTcpServer::newConnection, [this] {
+			m_impl->Accept(m_impl->tcpServer, &QTcpSocket::disconnected);
+		});
+		if (!m_impl->tcpServer.listen(QHostAddress(QHostAddress::LocalHost), port))
+		{
+			throw std::runtime_error("failed to serve the scanner at port " + address +
+				": " + m_impl->tcpServer.errorString().toStdString());
+		}
+	}
+	else
+	{
+		// A socket file left by a crashed daemon would fail the listening
+		QLocalServer::removeServer(QString::fromStdString(address));
+		QObject::connect(&m_impl->localServer, &QLocalServer::newConnection, [this] {
+			m_impl->Accept(m_impl->localServer, &QLocalSocket::disconnected);
+		});
+		if (!m_impl->localServer.listen(QString::fromStdString(address)))
+		{
+			throw std::runtime_error("failed to serve the scanner at " + address +
+				": " + m_impl->localServer.errorString().toStdString());
+		}
+	}
+	Logger::GetInstance().Info() << "serving the scanner at " << address;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Daemon::~Daemon() = default;
+
+//////////////////////////////////////////////////////////////////////////
+void Daemon::OnLinkLost()
+{
+	m_impl->SetProgrammer(nullptr);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Daemon::SetLinkLostHandler(std::function<void()> handler)
+{
+	m_impl->linkLostHandler = std::move(handler);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Daemon::SetProgrammingHandler(std::function<void(bool active)> handler)
+{
+	m_impl->programmingHandler = std::move(handler);
+}
+
+} // namespace kvasir
@@ -0,0 +1,74 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: daemon.h
+///
+/// summary: sharing of the radio among local processes
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_DAEMON_H_INCLUDED
+#define KVASIR_DAEMON_H_INCLUDED
+
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace kvasir
+{
+
+class Scanner;
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Serves the scanner to the local clients in the radio's own protocol:
+///   each client writes commands terminated with '\r' and reads replies
+///   in the same order. Identical read-only commands in flight go to the
+///   radio once and their reply is written to every client asking. A
+///   reception status that is fresh enough is reused the same way.
+///   Programming mode is granted to one client at a time, the commands
+///   of the others are refused with NG until it's over, and the polling
+///   of this process is held through the programming handler. Runs in
+///   the event loop of the thread it was created in.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Daemon
+{
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// <param name="scanner"> Connected scanner to share </param>
+	/// <param name="address"> Loopback TCP port or local socket name </param>
+	/// <param name="statusMaxAge"> Age of the reception status still served </param>
+	//////////////////////////////////////////////////////////////////////////
+	Daemon(const Scanner& scanner, const std::string& address, std::chrono::milliseconds statusMaxAge);
+	~Daemon();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Forget the client in programming mode once the link to the radio is
+	///   lost: the radio is out of the session, the others may start theirs
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void OnLinkLost();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Called once a client's command fails with the link to the radio
+	///   lost, whether anything else polls the radio or not
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void SetLinkLostHandler(std::function<void()> handler);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Called as a client's programming session starts and ends: whatever
+	///   else polls the radio in this process has to hold off meanwhile
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void SetProgrammingHandler(std::function<void(bool active)> handler);
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_DAEMON_H_INCLUDED
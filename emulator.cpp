@@ -0,0 +1,629 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: emulator.cpp
+///
+/// summary: Uniden scanner emulator on a pseudo-terminal
+//////////////////////////////////////////////////////////////////////////
+
+#include "logger.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <map>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+namespace
+{
+
+using Fields = std::vector<std::string>;
+
+// Number of the values in SIN, TRN and GLG responses
+constexpr size_t SinFieldCount = 28;
+constexpr size_t TrnFieldCount = 29;
+constexpr size_t GlgFieldCount = 12;
+
+// Positions of the SIN values filled by the emulator
+constexpr size_t SinRevIndex = 11;
+constexpr size_t SinFwdIndex = 12;
+constexpr size_t SinSeqNumber = 15;
+
+volatile std::sig_atomic_t g_stop = 0;
+
+//////////////////////////////////////////////////////////////////////////
+struct EmulatorSettings
+{
+	std::string memoryPath;                 // Memory contents, built-in if empty
+	std::string linkPath;                   // Symbolic link to the terminal
+	unsigned int systems = 8;               // Number of the built-in systems
+	unsigned int baudRate = 115200;         // Speed of the replies, 0 - unlimited
+	std::chrono::microseconds latency{ 2000 };
+	std::chrono::microseconds jitter{ 500 };
+	std::chrono::milliseconds dwell{ 3000 };// Time each GLG status is reported
+	double dropRate = 0;                    // Share of the commands left without reply
+	double corruptRate = 0;                 // Share of the replies with a damaged byte
+	double errorRate = 0;                   // Share of the commands answered with ERR
+	unsigned int seed = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Contents of the radio's memory. The file lists replies of the radio
+///   one per line, the command name first:
+///
+///     MDL,BCD996P2
+///     SIN,CNV,Fire,...         systems in the scan order, the chain
+///                              indexes and sequence numbers are set
+///                              by the emulator
+///     GLG,0154.4300,NFM,...    statuses reported in turn, each one for
+///                              the dwell time
+///     CAR,01544300,NFM,620,40  carrier found by tuning to the frequency
+///                              (100 Hz units): modulation, signal level
+///                              (0-1023) and percentage of the time on air
+///     BLT,AO,IF,10             any other command: its fixed reply
+///
+///   Empty lines and lines starting with '#' are ignored.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+struct Carrier
+{
+	unsigned long frequency;                // 100 Hz units, as in QSH and PWR
+	std::string modulation;
+	unsigned int level;
+	unsigned int duty;                      // Percentage of the time on air
+};
+
+//////////////////////////////////////////////////////////////////////////
+struct Memory
+{
+	std::vector<Fields> systems;
+	std::vector<std::string> statuses;
+	std::vector<Carrier> carriers;
+	std::map<std::string, std::string> replies;
+};
+
+//////////////////////////////////////////////////////////////////////////
+Fields Split(const std::string& text)
+{
+	Fields result;
+	size_t begin = 0;
+	for (;;)
+	{
+		const size_t end = text.find(',', begin);
+		result.push_back(text.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+		if (end == std::string::npos)
+			return result;
+		begin = end + 1;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string Join(const Fields& fields)
+{
+	std::string result;
+	for (size_t i = 0; i < fields.size(); ++i)
+	{
+		if (i)
+			result += ',';
+		result += fields[i];
+	}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string Trim(const std::string& text)
+{
+	const size_t begin = text.find_first_not_of(" \t");
+	if (begin == std::string::npos)
+		return std::string();
+	return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+Memory DefaultMemory(unsigned int systemCount)
+{
+	Memory memory;
+	memory.replies["MDL"] = "MDL,BCD996P2";
+	memory.replies["VER"] = "VER,Version 1.00.00";
+	memory.replies["BLT"] = "BLT,AO,IF,10";
+	memory.replies["BSV"] = "BSV,0,8";
+	memory.replies["KBP"] = "KBP,3,0,0";
+	memory.replies["OMS"] = "OMS,KVASIR,EMULATOR,,";
+	memory.replies["AGV"] = "AGV,,,0,0,0,0,0";
+
+	static const char* const types[] = { "CNV", "MOT", "EDC", "LTR", "P25S" };
+	for (unsigned int i = 0; i < systemCount; ++i)
+	{
+		Fields sin(SinFieldCount);
+		sin[0] = types[i % (sizeof(types) / sizeof(types[0]))];
+		sin[1] = "System " + std::to_string(i + 1);
+		sin[2] = ".";
+		sin[3] = "0";
+		sin[4] = "0";
+		sin[5] = "2";
+		sin[13] = "-1";
+		sin[14] = "-1";
+		sin[16] = ".";
+		sin[22] = "NONE";
+		sin[23] = "0";
+		sin[24] = "0";
+		sin[25] = "400";
+		sin[26] = "0";
+		memory.systems.push_back(std::move(sin));
+	}
+
+	memory.statuses = {
+		std::string(GlgFieldCount - 1, ','),
+		"0154.4300,NFM,0,0,System 1,Fire,Dispatch,1,0,NONE,1,NONE",
+		std::string(GlgFieldCount - 1, ','),
+		"1234,FM,0,0,System 2,Police,Patrol,1,0,2,NONE,293"
+	};
+
+	memory.carriers = {
+		{ 1544300, "NFM", 620, 60 },
+		{ 1545500, "NFM", 410, 25 },
+		{ 1560750, "FM", 780, 90 },
+		{ 4601250, "NFM", 350, 10 }
+	};
+	return memory;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Memory LoadMemory(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open memory file " + path);
+
+	Memory memory;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty() || line.front() == '#')
+			continue;
+
+		const std::string command = line.substr(0, line.find(','));
+		const std::string values = command.size() < line.size() ? line.substr(command.size() + 1) : "";
+		if ("SIN" == command)
+		{
+			Fields sin = Split(values);
+			sin.resize(SinFieldCount);
+			memory.systems.push_back(std::move(sin));
+		}
+		else if ("CAR" == command)
+		{
+			const Fields carrier = Split(values);
+			if (carrier.size() != 4)
+				throw std::runtime_error("CAR must have 4 values: " + line);
+			memory.carriers.push_back(Carrier{ std::stoul(carrier[0]), carrier[1],
+				static_cast<unsigned int>(std::stoul(carrier[2])), static_cast<unsigned int>(std::stoul(carrier[3])) });
+		}
+		else if ("GLG" == command)
+		{
+			if (Split(values).size() != GlgFieldCount)
+				throw std::runtime_error("GLG status must have " + std::to_string(GlgFieldCount) + " values: " + line);
+			memory.statuses.push_back(values);
+		}
+		else
+		{
+			memory.replies[command] = line;
+		}
+	}
+
+	if (memory.statuses.empty())
+		memory.statuses.push_back(std::string(GlgFieldCount - 1, ','));
+	return memory;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Protocol side of the emulated radio
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Radio
+{
+	const Memory m_memory;
+	const std::chrono::milliseconds m_dwell;
+	const std::chrono::steady_clock::time_point m_start;
+	bool m_programming = false;
+	unsigned long m_hold = 0;               // Frequency held by QSH, 0 - scanning
+	std::mt19937 m_noise;
+
+	// Memory indexes of the systems: sparse, as in the real radio
+	static int IndexOf(size_t system)
+	{
+		return static_cast<int>(100 + system * 37);
+	}
+
+	std::string SystemInfo(const std::string& index) const
+	{
+		const int value = std::atoi(index.c_str());
+		for (size_t i = 0; i < m_memory.systems.size(); ++i)
+		{
+			if (IndexOf(i) != value)
+				continue;
+
+			Fields sin = m_memory.systems[i];
+			sin[SinRevIndex] = i ? std::to_string(IndexOf(i - 1)) : "-1";
+			sin[SinFwdIndex] = i + 1 < m_memory.systems.size() ? std::to_string(IndexOf(i + 1)) : "-1";
+			sin[SinSeqNumber] = std::to_string(i + 1);
+			return "SIN," + Join(sin);
+		}
+		return "SIN,NG";
+	}
+
+	// Trunked systems show decimal IDs, the conventional ones have no TRN
+	std::string TrunkInfo(const std::string& index) const
+	{
+		const int value = std::atoi(index.c_str());
+		for (size_t i = 0; i < m_memory.systems.size(); ++i)
+		{
+			if (IndexOf(i) != value)
+				continue;
+			if ("CNV" == m_memory.systems[i][0])
+				break;
+
+			Fields trn(TrnFieldCount, "0");
+			trn[20] = trn[21] = trn[22] = trn[23] = "-1";
+			return "TRN," + Join(trn);
+		}
+		return "TRN,NG";
+	}
+
+	// Carrier at the frequency if it is on air now. Each one transmits a
+	// share of every 2 s cycle, at its own phase
+	const Carrier* OnAir(unsigned long frequency) const
+	{
+		const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - m_start).count();
+		for (const auto& carrier : m_memory.carriers)
+		{
+			if (carrier.frequency == frequency &&
+				(elapsed + carrier.frequency * 7) % 2000 < carrier.duty * 20)
+				return &carrier;
+		}
+		return nullptr;
+	}
+
+	static std::string FormatFrequency(unsigned long frequency, bool mhz)
+	{
+		char buf[32];
+		if (mhz)
+			std::snprintf(buf, sizeof(buf), "%04lu.%04lu", frequency / 10000, frequency % 10000);
+		else
+			std::snprintf(buf, sizeof(buf), "%08lu", frequency);
+		return buf;
+	}
+
+	std::string HoldStatus() const
+	{
+		const Carrier* carrier = OnAir(m_hold);
+		return "GLG," + FormatFrequency(m_hold, true) + ',' + (carrier ? carrier->modulation : "NFM") +
+			",0,0,,,," + (carrier ? "1" : "0") + ",0,NONE,NONE,NONE";
+	}
+
+	std::string Status() const
+	{
+		const auto elapsed = std::chrono::steady_clock::now() - m_start;
+		const size_t step = static_cast<size_t>(elapsed / std::max(m_dwell, std::chrono::milliseconds(1)));
+		return "GLG," + m_memory.statuses[step % m_memory.statuses.size()];
+	}
+
+public:
+	Radio(Memory memory, std::chrono::milliseconds dwell)
+		: m_memory(std::move(memory))
+		, m_dwell(dwell)
+		, m_start(std::chrono::steady_clock::now())
+	{}
+
+	const std::string& Model() const
+	{
+		static const std::string unknown = "MDL,UNKNOWN";
+		const auto found = m_memory.replies.find("MDL");
+		return found != m_memory.replies.end() ? found->second : unknown;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Reply to the command, without the terminating '\r'
+	//////////////////////////////////////////////////////////////////////////
+	std::string Respond(const std::string& command)
+	{
+		const Fields args = Split(command);
+		const std::string name = Trim(args.front());
+
+		if ("PRG" == name)
+		{
+			m_programming = true;
+			m_hold = 0;
+			return "PRG,OK";
+		}
+		if ("EPG" == name)
+		{
+			m_programming = false;
+			return "EPG,OK";
+		}
+		if ("GLG" == name)
+			return m_programming ? "GLG,NG" : m_hold ? HoldStatus() : Status();
+
+		// Quick search hold on the frequency, any key goes back to scanning
+		if ("QSH" == name)
+		{
+			if (m_programming || args.size() < 2 || Trim(args[1]).empty() ||
+				Trim(args[1]).find_first_not_of("0123456789") != std::string::npos)
+				return "QSH,NG";
+			m_hold = std::stoul(Trim(args[1]));
+			return "QSH,OK";
+		}
+		if ("KEY" == name)
+		{
+			m_hold = 0;
+			return "KEY,OK";
+		}
+		if ("PWR" == name)
+		{
+			if (m_programming)
+				return "PWR,NG";
+			const Carrier* carrier = m_hold ? OnAir(m_hold) : nullptr;
+			const unsigned int level = carrier ? carrier->level :
+				std::uniform_int_distribution<unsigned int>(20, 90)(m_noise);
+			return "PWR," + std::to_string(level) + ',' + FormatFrequency(m_hold, false);
+		}
+		if ("MDL" == name || "VER" == name)
+			return m_memory.replies.count(name) ? m_memory.replies.at(name) : "ERR";
+
+		// The rest is available in the programming mode only
+		if (!m_memory.replies.count(name) && "SCT" != name && "SIH" != name && "SIT" != name &&
+			"SIN" != name && "TRN" != name)
+			return "ERR";
+		if (!m_programming)
+			return name + ",NG";
+
+		const size_t count = m_memory.systems.size();
+		if ("SCT" == name)
+			return "SCT," + std::to_string(count);
+		if ("SIH" == name)
+			return "SIH," + std::to_string(count ? IndexOf(0) : -1);
+		if ("SIT" == name)
+			return "SIT," + std::to_string(count ? IndexOf(count - 1) : -1);
+		if ("SIN" == name)
+			return args.size() > 1 ? SystemInfo(Trim(args[1])) : "ERR";
+		if ("TRN" == name)
+			return args.size() > 1 ? TrunkInfo(Trim(args[1])) : "ERR";
+		return m_memory.replies.at(name);
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Master side of the pseudo-terminal, the radio's end of the cable
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Terminal
+{
+	int m_master = -1;
+	int m_slave = -1;                       // Kept open: no hangups between clients
+	std::string m_path;
+	std::string m_link;
+
+public:
+	explicit Terminal(const std::string& link)
+	{
+		m_master = ::posix_openpt(O_RDWR | O_NOCTTY);
+		if (m_master < 0 || ::grantpt(m_master) || ::unlockpt(m_master))
+			throw std::runtime_error(std::string("failed to open pseudo-terminal: ") + std::strerror(errno));
+		m_path = ::ptsname(m_master);
+
+		m_slave = ::open(m_path.c_str(), O_RDWR | O_NOCTTY);
+		if (m_slave < 0)
+			throw std::runtime_error("failed to open " + m_path + ": " + std::strerror(errno));
+
+		termios settings;
+		::tcgetattr(m_slave, &settings);
+		::cfmakeraw(&settings);
+		::tcsetattr(m_slave, TCSANOW, &settings);
+
+		if (!link.empty())
+		{
+			::unlink(link.c_str());
+			if (::symlink(m_path.c_str(), link.c_str()))
+				throw std::runtime_error("failed to link " + link + ": " + std::strerror(errno));
+			m_link = link;
+		}
+	}
+
+	~Terminal()
+	{
+		if (!m_link.empty())
+			::unlink(m_link.c_str());
+		::close(m_slave);
+		::close(m_master);
+	}
+
+	const std::string& Path() const noexcept
+	{
+		return m_link.empty() ? m_path : m_link;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Bytes written by the client, empty on timeout
+	//////////////////////////////////////////////////////////////////////////
+	std::string Read(std::chrono::milliseconds timeout)
+	{
+		pollfd fd{ m_master, POLLIN, 0 };
+		if (::poll(&fd, 1, static_cast<int>(timeout.count())) <= 0)
+			return std::string();
+
+		char buf[512];
+		const ssize_t size = ::read(m_master, buf, sizeof(buf));
+		return size > 0 ? std::string(buf, static_cast<size_t>(size)) : std::string();
+	}
+
+	void Write(const std::string& data)
+	{
+		size_t written = 0;
+		while (written < data.size())
+		{
+			const ssize_t size = ::write(m_master, data.data() + written, data.size() - written);
+			if (size < 0 && errno != EINTR)
+				throw std::runtime_error(std::string("failed to write to pseudo-terminal: ") + std::strerror(errno));
+			written += size > 0 ? static_cast<size_t>(size) : 0;
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Serve the commands until interrupted: each reply is delayed by the
+///   processing latency with jitter and by its transfer time at the baud
+///   rate (10 bits per byte), faults are injected at the given rates
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+void Serve(Terminal& terminal, Radio& radio, const EmulatorSettings& settings)
+{
+	std::mt19937 random(settings.seed);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	std::uniform_int_distribution<long long> jitter(-settings.jitter.count(), settings.jitter.count());
+
+	uint64_t commands = 0;
+	std::string input;
+	while (!g_stop)
+	{
+		input += terminal.Read(std::chrono::milliseconds(100));
+
+		size_t end;
+		while ((end = input.find('\r')) != std::string::npos)
+		{
+			const std::string command = input.substr(0, end);
+			input.erase(0, end + 1);
+			++commands;
+
+			std::string reply = radio.Respond(command);
+			KVASIR_LOG(DEBUG) << command << " -> " << reply;
+
+			if (chance(random) < settings.dropRate)
+			{
+				KVASIR_LOG(DEBUG) << "reply to " << command << " is dropped";
+				continue;
+			}
+			if (chance(random) < settings.errorRate)
+				reply = "ERR";
+			if (chance(random) < settings.corruptRate && !reply.empty())
+				reply[std::uniform_int_distribution<size_t>(0, reply.size() - 1)(random)] ^= 0x20;
+			reply += '\r';
+
+			auto delay = settings.latency + std::chrono::microseconds(jitter(random));
+			if (settings.baudRate)
+				delay += std::chrono::microseconds(reply.size() * 10 * 1000000 / settings.baudRate);
+			if (delay.count() > 0)
+				std::this_thread::sleep_for(delay);
+
+			terminal.Write(reply);
+		}
+	}
+
+	kvasir::Logger::GetInstance().Info() << commands << " commands served";
+}
+
+//////////////////////////////////////////////////////////////////////////
+void PrintUsage()
+{
+	std::cerr <<
+		"usage: kvasir-emulator [options]\n"
+		"  --memory <file>      memory contents (see emulator.cpp), built-in by default\n"
+		"  --systems <n>        number of the built-in systems (8)\n"
+		"  --link <path>        symbolic link to the terminal for the kvasir config\n"
+		"  --baud <rate>        reply transfer speed, 0 - unlimited (115200)\n"
+		"  --latency <us>       command processing time (2000)\n"
+		"  --jitter <us>        max deviation of the processing time (500)\n"
+		"  --dwell <ms>         time each GLG status is reported (3000)\n"
+		"  --drop <rate>        share of the commands left without reply (0)\n"
+		"  --corrupt <rate>     share of the replies with a damaged byte (0)\n"
+		"  --error <rate>       share of the commands answered with ERR (0)\n"
+		"  --seed <n>           seed of the fault injection (0)\n"
+		"  --debug              print every command\n";
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+try
+{
+	EmulatorSettings settings;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string option = argv[i];
+		if ("--debug" == option)
+		{
+			kvasir::Logger::GetInstance().EnableConsoleChannel(kvasir::LOG_DEBUG);
+			continue;
+		}
+		if (i + 1 == argc)
+		{
+			PrintUsage();
+			return 2;
+		}
+
+		const std::string value = argv[++i];
+		if ("--memory" == option)
+			settings.memoryPath = value;
+		else if ("--systems" == option)
+			settings.systems = static_cast<unsigned int>(std::stoul(value));
+		else if ("--link" == option)
+			settings.linkPath = value;
+		else if ("--baud" == option)
+			settings.baudRate = static_cast<unsigned int>(std::stoul(value));
+		else if ("--latency" == option)
+			settings.latency = std::chrono::microseconds(std::stoll(value));
+		else if ("--jitter" == option)
+			settings.jitter = std::chrono::microseconds(std::stoll(value));
+		else if ("--dwell" == option)
+			settings.dwell = std::chrono::milliseconds(std::stoll(value));
+		else if ("--drop" == option)
+			settings.dropRate = std::stod(value);
+		else if ("--corrupt" == option)
+			settings.corruptRate = std::stod(value);
+		else if ("--error" == option)
+			settings.errorRate = std::stod(value);
+		else if ("--seed" == option)
+			settings.seed = static_cast<unsigned int>(std::stoul(value));
+		else
+		{
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	std::signal(SIGINT, [](int) { g_stop = 1; });
+	std::signal(SIGTERM, [](int) { g_stop = 1; });
+
+	Radio radio(settings.memoryPath.empty() ? DefaultMemory(settings.systems) : LoadMemory(settings.memoryPath),
+		settings.dwell);
+	Terminal terminal(settings.linkPath);
+	kvasir::Logger::GetInstance().Info() << "emulating " << radio.Model().substr(4) << " on " << terminal.Path();
+
+	Serve(terminal, radio, settings);
+	return 0;
+}
+catch (const std::exception& e)
+{
+	std::cerr << "failure: " << e.what() << std::endl;
+	return 1;
+}
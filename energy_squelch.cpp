@@ -0,0 +1,124 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: energy_squelch.cpp
+///
+/// summary: voice activity detection on the audio energy
+//////////////////////////////////////////////////////////////////////////
+
+#include "energy_squelch.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define KVASIR_HAVE_SSE2
+# include <emmintrin.h>
+#endif
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+uint64_t SumOfSquares(const int16_t* samples, size_t count) noexcept
+{
+	uint64_t sum = 0;
+	size_t i = 0;
+
+#ifdef KVASIR_HAVE_SSE2
+	// _mm_madd_epi16 sums squares of adjacent samples into 32-bit lanes.
+	// The only value that does not fit signed 32 bits is 2 * (-32768)^2,
+	// it is still correct when treated as unsigned, so lanes are zero
+	// extended before the accumulation.
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+		const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i + 8));
+		const __m128i sqLo = _mm_madd_epi16(lo, lo);
+		const __m128i sqHi = _mm_madd_epi16(hi, hi);
+		acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sqLo, zero));
+		acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sqLo, zero));
+		acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sqHi, zero));
+		acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sqHi, zero));
+	}
+
+	alignas(16) uint64_t lanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+	sum = lanes[0] + lanes[1];
+#endif // KVASIR_HAVE_SSE2
+
+	for (; i < count; ++i)
+	{
+		const int32_t sample = samples[i];
+		sum += static_cast<uint64_t>(sample * sample);
+	}
+
+	return sum;
+}
+
+//////////////////////////////////////////////////////////////////////////
+double MeanSquareFromDbfs(double dbfs) noexcept
+{
+	const double amplitude = 32768.0 * std::pow(10.0, dbfs / 20.0);
+	return amplitude * amplitude;
+}
+
+//////////////////////////////////////////////////////////////////////////
+EnergySquelch::EnergySquelch(unsigned int sampleRate, const Settings& settings)
+	: m_blockSize(std::max<size_t>(static_cast<size_t>(sampleRate) * settings.blockMs / 1000, 1))
+	, m_attackBlocks(std::max(settings.attackBlocks, 1u))
+	, m_releaseBlocks(std::max(settings.releaseMs / std::max(settings.blockMs, 1u), 1u))
+	, m_openLevel(MeanSquareFromDbfs(settings.openDbfs) * m_blockSize)
+	, m_closeLevel(MeanSquareFromDbfs(settings.closeDbfs) * m_blockSize)
+{}
+
+//////////////////////////////////////////////////////////////////////////
+const std::vector<EnergySquelch::Event>& EnergySquelch::Process(const int16_t* samples, size_t count)
+{
+	m_events.clear();
+	while (count)
+	{
+		const size_t portion = std::min(count, m_blockSize - m_blockFill);
+		m_blockEnergy += SumOfSquares(samples, portion);
+		m_blockFill += portion;
+		m_position += portion;
+		samples += portion;
+		count -= portion;
+
+		if (m_blockFill == m_blockSize)
+			CompleteBlock();
+	}
+
+	return m_events;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void EnergySquelch::CompleteBlock()
+{
+	const double energy = static_cast<double>(m_blockEnergy);
+	m_blockEnergy = 0;
+	m_blockFill = 0;
+
+	if (!m_open)
+	{
+		m_loudBlocks = energy >= m_openLevel ? m_loudBlocks + 1 : 0;
+		if (m_loudBlocks >= m_attackBlocks)
+		{
+			// The edge is at the beginning of the first loud block
+			m_open = true;
+			m_quietBlocks = 0;
+			m_events.push_back(Event{ true, m_position - m_loudBlocks * m_blockSize });
+		}
+		return;
+	}
+
+	m_quietBlocks = energy < m_closeLevel ? m_quietBlocks + 1 : 0;
+	if (m_quietBlocks >= m_releaseBlocks)
+	{
+		m_open = false;
+		m_loudBlocks = 0;
+		m_events.push_back(Event{ false, m_position - m_quietBlocks * m_blockSize });
+	}
+}
+
+} // namespace kvasir
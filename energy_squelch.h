@@ -0,0 +1,96 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: energy_squelch.h
+///
+/// summary: voice activity detection on the audio energy
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_ENERGY_SQUELCH_H_INCLUDED
+#define KVASIR_ENERGY_SQUELCH_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Sum of squares of 16-bit samples (vectorized where possible)
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+uint64_t SumOfSquares(const int16_t* samples, size_t count) noexcept;
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Convert the level in dBFS into the mean square of 16-bit samples
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+double MeanSquareFromDbfs(double dbfs) noexcept;
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Detects the start and the end of the transmission from the audio
+///   energy. Samples are analyzed in short blocks: the squelch opens when
+///   a couple of consecutive blocks are above the open level and closes
+///   when the energy stays below the close level for the release time.
+///   Each instance keeps the state of one audio stream.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class EnergySquelch
+{
+public:
+	struct Settings
+	{
+		double openDbfs = -40.0;             // Level to open the squelch at
+		double closeDbfs = -46.0;            // Level to close the squelch at
+		unsigned int blockMs = 5;            // Analysis block length
+		unsigned int attackBlocks = 2;       // Blocks above the open level to open
+		unsigned int releaseMs = 300;        // Time below the close level to close
+	};
+
+	struct Event
+	{
+		bool open;                           // Squelch opened or closed
+		uint64_t sample;                     // Stream position the edge is detected at
+	};
+
+	EnergySquelch(unsigned int sampleRate, const Settings& settings);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Feed the next portion of the stream. Returns the edges detected in it,
+	/// the reference stays valid until the next call.
+	//////////////////////////////////////////////////////////////////////////
+	const std::vector<Event>& Process(const int16_t* samples, size_t count);
+
+	bool IsOpen() const noexcept
+	{
+		return m_open;
+	}
+
+	uint64_t Position() const noexcept
+	{
+		return m_position;
+	}
+
+private:
+	const size_t m_blockSize;
+	const unsigned int m_attackBlocks;
+	const unsigned int m_releaseBlocks;
+	const double m_openLevel;
+	const double m_closeLevel;
+
+	uint64_t m_position = 0;         // samples analyzed so far
+	uint64_t m_blockEnergy = 0;      // energy of the incomplete block
+	size_t m_blockFill = 0;          // samples in the incomplete block
+	unsigned int m_loudBlocks = 0;
+	unsigned int m_quietBlocks = 0;
+	bool m_open = false;
+	std::vector<Event> m_events;
+
+	void CompleteBlock();
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_ENERGY_SQUELCH_H_INCLUDED
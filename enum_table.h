@@ -0,0 +1,122 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: enum_table.h
+///
+/// summary: compile time tables of the names of enumerations
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_ENUM_TABLE_H_INCLUDED
+#define KVASIR_ENUM_TABLE_H_INCLUDED
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+template<typename E>
+struct EnumName
+{
+	E value;
+	std::string_view name;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   FNV-1a from the seed. Its low bits only depend on the low bits of the
+///   characters: the high ones are folded in before the slot is taken
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+constexpr uint32_t HashName(std::string_view name, uint32_t seed) noexcept
+{
+	uint32_t hash = 2166136261u ^ seed;
+	for (const char c : name)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 16777619u;
+	}
+	return hash ^ hash >> 16;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Names of the values of an enumeration, both ways: the name of a
+///   value is an array lookup, the value of a name is one hash and one
+///   comparison. The seed of the hash is searched for at compile time
+///   until no two names share a slot, which makes the hash perfect.
+///   Declare the tables constexpr so that the search never runs later.
+/// </summary>
+///
+/// <param name="E"> Enumeration with values from 0 to Values - 1 </param>
+/// <param name="N"> Number of the named values </param>
+//////////////////////////////////////////////////////////////////////////
+template<typename E, size_t N, size_t Values>
+class EnumTable
+{
+	static constexpr size_t SlotCount()
+	{
+		size_t count = 1;
+		while (count < 2 * N)
+			count <<= 1;
+		return count;
+	}
+
+	static constexpr size_t Slots = SlotCount();
+
+	std::array<EnumName<E>, N> m_names;
+	std::array<std::string_view, Values> m_byValue{};
+	std::array<uint8_t, Slots> m_slots{};       // Index of the name + 1, 0 if free
+	uint32_t m_seed = 0;
+
+	static_assert(N < 256, "the slots hold 8 bit indexes");
+
+	constexpr bool TrySeed()
+	{
+		m_slots = {};
+		for (size_t i = 0; i < N; ++i)
+		{
+			uint8_t& slot = m_slots[HashName(m_names[i].name, m_seed) & (Slots - 1)];
+			if (slot)
+				return false;
+			slot = static_cast<uint8_t>(i + 1);
+		}
+		return true;
+	}
+
+public:
+	constexpr explicit EnumTable(const std::array<EnumName<E>, N>& names)
+		: m_names(names)
+	{
+		for (const EnumName<E>& entry : m_names)
+			m_byValue[static_cast<size_t>(entry.value)] = entry.name;
+		while (!TrySeed())
+			++m_seed;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Value of the name, false if none has it
+	//////////////////////////////////////////////////////////////////////////
+	constexpr bool Find(std::string_view name, E& value) const noexcept
+	{
+		const uint8_t slot = m_slots[HashName(name, m_seed) & (Slots - 1)];
+		if (!slot || m_names[slot - 1].name != name)
+			return false;
+		value = m_names[slot - 1].value;
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Name of the value, empty if it has none
+	//////////////////////////////////////////////////////////////////////////
+	constexpr std::string_view Name(E value) const noexcept
+	{
+		const size_t index = static_cast<size_t>(value);
+		return index < Values ? m_byValue[index] : std::string_view();
+	}
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_ENUM_TABLE_H_INCLUDED
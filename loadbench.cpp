@@ -0,0 +1,478 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: loadbench.cpp
+///
+/// summary: end-to-end benchmark of the memory dump and status polling
+//////////////////////////////////////////////////////////////////////////
+
+#include "qt_serial_transport.h"
+#include "scan_settings.h"
+#include "timebase.h"
+#include "scanner.h"
+#include "channel.h"
+#include "config.h"
+#include "logger.h"
+#include "group.h"
+
+#include <QtCore/QCoreApplication>
+
+#ifdef KVASIR_HAVE_NATIVE_SERIAL
+# include "native_serial_transport.h"
+#endif // KVASIR_HAVE_NATIVE_SERIAL
+
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <spawn.h>
+
+extern char** environ;
+
+namespace
+{
+
+using kvasir::Clock;
+using kvasir::Timestamp;
+
+//////////////////////////////////////////////////////////////////////////
+struct BenchOptions
+{
+	std::string emulatorPath;               // Emulator to start for each run
+	std::string port;                       // Endpoint to use instead of the emulator
+	std::vector<unsigned int> systemCounts{ 10, 100 };
+	std::vector<unsigned int> baudRates{ 115200 };
+	std::chrono::seconds pollDuration{ 10 };
+	std::chrono::microseconds latency{ 2000 };
+	kvasir::SerialBackend backend = kvasir::SerialBackend::Qt;
+	std::string jsonPath;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Times of one opcode: link is the command and reply on the wire plus
+/// the radio's turnaround, host is the reply processing up to the next
+/// command, us
+//////////////////////////////////////////////////////////////////////////
+struct OpcodeTimes
+{
+	std::vector<double> link;
+	std::vector<double> host;
+};
+
+using Breakdown = std::map<std::string, OpcodeTimes>;
+
+//////////////////////////////////////////////////////////////////////////
+struct RunResult
+{
+	unsigned int systems;
+	unsigned int baudRate;
+	kvasir::SerialBackend backend;
+	size_t records = 0;                     // Systems read by the load
+	double loadTime = 0;                    // s
+	size_t polls = 0;
+	double pollTime = 0;                    // s
+	Breakdown opcodes;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Stamps the transactions passing through to the real link: a command
+///   is timed from its write to the '\r' of the reply, the host from that
+///   reply to the next command
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class TimedTransport : public kvasir::SerialTransport
+{
+	const std::unique_ptr<kvasir::SerialTransport> m_link;
+	Breakdown& m_opcodes;
+	std::string m_opcode;
+	Timestamp m_sent;
+	Timestamp m_received;
+	bool m_replied = false;                 // Host time of the reply is pending
+
+public:
+	TimedTransport(std::unique_ptr<kvasir::SerialTransport> link, Breakdown& opcodes)
+		: m_link(std::move(link))
+		, m_opcodes(opcodes)
+	{}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Account the processing of the last reply up to the given time
+	//////////////////////////////////////////////////////////////////////////
+	void Settle(Timestamp now)
+	{
+		if (m_replied)
+			m_opcodes[m_opcode].host.push_back(std::chrono::duration<double, std::micro>(now - m_received).count());
+		m_replied = false;
+	}
+
+	void Write(const char* data, size_t size) override
+	{
+		const Timestamp now = Clock::now();
+		Settle(now);
+		m_opcode.assign(data, std::min<size_t>(size, 3));
+		m_sent = now;
+		m_link->Write(data, size);
+	}
+
+	size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout) override
+	{
+		const size_t size = m_link->Read(buffer, capacity, timeout);
+		if (size && '\r' == buffer[size - 1])
+		{
+			m_received = Clock::now();
+			m_replied = true;
+			m_opcodes[m_opcode].link.push_back(std::chrono::duration<double, std::micro>(m_received - m_sent).count());
+		}
+		return size;
+	}
+
+	bool IsOpen() const noexcept override
+	{
+		return m_link->IsOpen();
+	}
+
+	void Close() override
+	{
+		m_link->Close();
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   kvasir-emulator serving one run, stopped on destruction
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Emulator
+{
+	pid_t m_pid = 0;
+	std::string m_link;
+
+public:
+	Emulator(const BenchOptions& options, unsigned int systems, unsigned int baudRate)
+		: m_link("/tmp/kvasir-loadbench-" + std::to_string(::getpid()) + ".tty")
+	{
+		const std::vector<std::string> args = {
+			options.emulatorPath,
+			"--link", m_link,
+			"--systems", std::to_string(systems),
+			"--baud", std::to_string(baudRate),
+			"--latency", std::to_string(options.latency.count()),
+			"--jitter", std::to_string(options.latency.count() / 4)
+		};
+		std::vector<char*> argv;
+		for (const auto& arg : args)
+			argv.push_back(const_cast<char*>(arg.c_str()));
+		argv.push_back(nullptr);
+
+		::unlink(m_link.c_str());
+		if (const int error = ::posix_spawn(&m_pid, argv.front(), nullptr, nullptr, argv.data(), environ))
+			throw std::runtime_error("failed to start " + options.emulatorPath + ": " + std::strerror(error));
+
+		// The link appears once the terminal is ready
+		for (int attempt = 0; ::access(m_link.c_str(), F_OK); ++attempt)
+		{
+			int status;
+			if (attempt == 100 || ::waitpid(m_pid, &status, WNOHANG) == m_pid)
+			{
+				Stop();
+				throw std::runtime_error("emulator failed to start");
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		}
+	}
+
+	~Emulator()
+	{
+		Stop();
+	}
+
+	const std::string& Port() const noexcept
+	{
+		return m_link;
+	}
+
+	void Stop()
+	{
+		if (!m_pid)
+			return;
+		::kill(m_pid, SIGTERM);
+		::waitpid(m_pid, nullptr, 0);
+		m_pid = 0;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+const char* ToString(kvasir::SerialBackend backend) noexcept
+{
+	return kvasir::SerialBackend::Native == backend ? "native" : "qt";
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::unique_ptr<kvasir::SerialTransport> OpenPort(const kvasir::Device& device, kvasir::SerialBackend backend)
+{
+	if (kvasir::SerialBackend::Native == backend)
+	{
+#ifdef KVASIR_HAVE_NATIVE_SERIAL
+		return std::make_unique<kvasir::NativeSerialTransport>(device);
+#else
+		throw std::runtime_error("native serial port is not supported on this system");
+#endif // KVASIR_HAVE_NATIVE_SERIAL
+	}
+	return std::make_unique<kvasir::QtSerialTransport>(device);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Read the whole memory once, then poll the reception status as fast as
+///   the radio answers for the given time
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+RunResult Measure(const std::string& port, unsigned int systems, unsigned int baudRate,
+	kvasir::SerialBackend backend, std::chrono::seconds pollDuration)
+{
+	RunResult result;
+	result.systems = systems;
+	result.baudRate = baudRate;
+	result.backend = backend;
+
+	kvasir::Device device{ "bench", port, baudRate, 8, 1, false };
+	auto timed = std::make_unique<TimedTransport>(OpenPort(device, backend), result.opcodes);
+	TimedTransport& transport = *timed;
+	kvasir::Scanner scanner;
+	scanner.Connect(std::move(timed));
+
+	Timestamp start = Clock::now();
+	kvasir::ScanSettings settings;
+	settings.Load(scanner);
+	Timestamp end = Clock::now();
+	transport.Settle(end);
+	result.records = settings.Systems().size();
+	result.loadTime = std::chrono::duration<double>(end - start).count();
+
+	start = Clock::now();
+	const Timestamp deadline = start + pollDuration;
+	do
+	{
+		scanner.GetReceptionStatus(settings);
+		++result.polls;
+		end = Clock::now();
+	} while (end < deadline);
+	transport.Settle(end);
+	result.pollTime = std::chrono::duration<double>(end - start).count();
+
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+double Percentile(std::vector<double>& samples, double share)
+{
+	if (samples.empty())
+		return 0;
+	const size_t rank = std::min(samples.size() - 1, static_cast<size_t>(share * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+	return samples[rank];
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// p50, p90, p99 and max of the samples
+//////////////////////////////////////////////////////////////////////////
+std::vector<double> Percentiles(std::vector<double> samples)
+{
+	return {
+		Percentile(samples, 0.5),
+		Percentile(samples, 0.9),
+		Percentile(samples, 0.99),
+		samples.empty() ? 0 : *std::max_element(samples.cbegin(), samples.cend())
+	};
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Print(const RunResult& result)
+{
+	std::cout << std::fixed << std::setprecision(1)
+		<< "systems " << result.systems << ", " << result.baudRate << " baud, "
+		<< ToString(result.backend) << " port\n"
+		<< "  load: " << std::setprecision(3) << result.loadTime << " s, "
+		<< std::setprecision(1) << result.records / result.loadTime << " records/s\n"
+		<< "  poll: " << result.polls << " in " << std::setprecision(3) << result.pollTime << " s, "
+		<< std::setprecision(1) << result.polls / result.pollTime << " Hz\n"
+		<< "  opcode     count      link p50/p90/p99/max, us          host p50/p90/p99/max, us\n";
+
+	for (const auto& [opcode, times] : result.opcodes)
+	{
+		std::cout << "  " << std::left << std::setw(6) << opcode << std::right << std::setw(10) << times.link.size();
+		for (const auto& samples : { times.link, times.host })
+		{
+			std::cout << "   ";
+			for (const double value : Percentiles(samples))
+				std::cout << std::setw(8) << value;
+		}
+		std::cout << '\n';
+	}
+	std::cout << std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Write the results as JSON: {"runs": [{"systems", "baud", "backend", "load_s",
+///   "records_per_s", "poll_hz", "opcodes": {"GLG": {"count", "link_us",
+///   "host_us"}}}]}, the times as [p50, p90, p99, max]
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+void WriteResults(const std::string& path, const std::vector<RunResult>& results)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open " + path);
+
+	const auto list = [&file](const std::vector<double>& values)
+	{
+		file << '[';
+		for (size_t i = 0; i < values.size(); ++i)
+			file << (i ? ", " : "") << values[i];
+		file << ']';
+	};
+
+	file << std::fixed << std::setprecision(2) << "{\n  \"runs\": [";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const RunResult& result = results[i];
+		file << (i ? "," : "") << "\n    {\"systems\": " << result.systems
+			<< ", \"baud\": " << result.baudRate
+			<< ", \"backend\": \"" << ToString(result.backend) << '"'
+			<< ", \"load_s\": " << result.loadTime
+			<< ", \"records_per_s\": " << result.records / result.loadTime
+			<< ", \"poll_hz\": " << result.polls / result.pollTime
+			<< ", \"opcodes\": {";
+
+		bool first = true;
+		for (const auto& [opcode, times] : result.opcodes)
+		{
+			file << (first ? "" : ", ") << '"' << opcode << "\": {\"count\": " << times.link.size() << ", \"link_us\": ";
+			list(Percentiles(times.link));
+			file << ", \"host_us\": ";
+			list(Percentiles(times.host));
+			file << '}';
+			first = false;
+		}
+		file << "}}";
+	}
+	file << "\n  ]\n}\n";
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::vector<unsigned int> ParseList(const std::string& text)
+{
+	std::vector<unsigned int> values;
+	std::istringstream stream(text);
+	std::string value;
+	while (std::getline(stream, value, ','))
+		values.push_back(static_cast<unsigned int>(std::stoul(value)));
+	return values;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void PrintUsage()
+{
+	std::cerr <<
+		"usage: kvasir-loadbench (--emulator <path> | --port <port>) [options]\n"
+		"  --emulator <path>    kvasir-emulator started for each run\n"
+		"  --port <port>        radio to use instead, its memory is not changed\n"
+		"  --systems <n,...>    numbers of the systems emulated (10,100)\n"
+		"  --baud <rate,...>    link speeds (115200)\n"
+		"  --poll <s>           duration of the polling session (10)\n"
+		"  --latency <us>       turnaround of the emulated radio (2000)\n"
+		"  --backend <name>     serial port: qt or native, Linux only (qt)\n"
+		"  --json <file>        file for the results\n";
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+try
+{
+	QCoreApplication app(argc, argv);
+
+	BenchOptions options;
+	for (int i = 1; i < argc; i += 2)
+	{
+		const std::string option = argv[i];
+		if (i + 1 == argc)
+		{
+			PrintUsage();
+			return 2;
+		}
+
+		const std::string value = argv[i + 1];
+		if ("--emulator" == option)
+			options.emulatorPath = value;
+		else if ("--port" == option)
+			options.port = value;
+		else if ("--systems" == option)
+			options.systemCounts = ParseList(value);
+		else if ("--baud" == option)
+			options.baudRates = ParseList(value);
+		else if ("--poll" == option)
+			options.pollDuration = std::chrono::seconds(std::stoul(value));
+		else if ("--latency" == option)
+			options.latency = std::chrono::microseconds(std::stoul(value));
+		else if ("--backend" == option && ("qt" == value || "native" == value))
+			options.backend = "native" == value ? kvasir::SerialBackend::Native : kvasir::SerialBackend::Qt;
+		else if ("--json" == option)
+			options.jsonPath = value;
+		else
+		{
+			PrintUsage();
+			return 2;
+		}
+	}
+
+	if (options.emulatorPath.empty() == options.port.empty())
+	{
+		PrintUsage();
+		return 2;
+	}
+
+	std::vector<RunResult> results;
+	for (const unsigned int baudRate : options.baudRates)
+	{
+		if (!options.port.empty())
+		{
+			// The radio's memory is whatever is programmed
+			results.push_back(Measure(options.port, 0, baudRate, options.backend, options.pollDuration));
+			results.back().systems = static_cast<unsigned int>(results.back().records);
+			Print(results.back());
+			continue;
+		}
+
+		for (const unsigned int systems : options.systemCounts)
+		{
+			Emulator emulator(options, systems, baudRate);
+			results.push_back(Measure(emulator.Port(), systems, baudRate, options.backend, options.pollDuration));
+			Print(results.back());
+		}
+	}
+
+	if (!options.jsonPath.empty())
+		WriteResults(options.jsonPath, results);
+	return 0;
+}
+catch (const std::exception& e)
+{
+	std::cerr << "failure: " << e.what() << std::endl;
+	return 1;
+}
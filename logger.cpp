@@ -5,11 +5,19 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include "logger.h"
+#include "bounded_queue.h"
+#include "metrics.h"
 
+#include <condition_variable>
 #include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <deque>
 #include <iostream>
-#include <iomanip>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <chrono>
 #include <thread>
 #include <regex>
@@ -18,20 +26,502 @@
 
 // Use thread-safe implementation of std::localtime
 #ifdef _WIN32
+# define NOMINMAX
+# include <windows.h>
 # include <process.h>
 # define getpid() _getpid()
 # define safe_localtime(timePoint,brokenTime) localtime_s(brokenTime, timePoint)
 #else
 # include <sys/types.h>
+# include <signal.h>
 # include <unistd.h>
 # define safe_localtime(timepoint,brokenTime) localtime_r(timepoint, brokenTime)
 #endif // _WIN32
 
+#ifdef KVASIR_HAVE_ZLIB
+# include <zlib.h>
+#endif // KVASIR_HAVE_ZLIB
+
 namespace fs = std::filesystem;
 
 namespace kvasir
 {
 
+namespace
+{
+
+// Log file which failed to open or to write is tried again after this
+constexpr std::chrono::seconds ReopenInterval(1);
+
+//////////////////////////////////////////////////////////////////////////
+/// "YYYY-MM-DD HH:MM:SS" of the last second formatted by the thread
+//////////////////////////////////////////////////////////////////////////
+struct SecondCache
+{
+    std::time_t second = -1;
+    char text[19];
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Text of the thread id, the same as std::hex << std::this_thread::get_id()
+//////////////////////////////////////////////////////////////////////////
+struct ThreadTag
+{
+    char text[32];
+    size_t length;
+
+    ThreadTag()
+    {
+        std::ostringstream buf;
+        buf << std::hex << std::this_thread::get_id();
+        const std::string id = buf.str();
+        length = std::min(id.size(), sizeof(text));
+        std::memcpy(text, id.data(), length);
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+inline char* PutDigits(char* out, unsigned int value, int width)
+{
+    for (int i = width - 1; i >= 0; --i)
+    {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return out + width;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Counters of the logged messages
+//////////////////////////////////////////////////////////////////////////
+struct LogMetrics
+{
+    Counter* messages[LOG_NONE];
+    Counter& dropped;
+    Gauge& queueDepth;
+
+    LogMetrics()
+        : dropped(Metrics::GetInstance().AddCounter("kvasir_log_dropped_total",
+            "Log messages dropped on the async queue overflow."))
+        , queueDepth(Metrics::GetInstance().AddGauge("kvasir_log_queue_depth",
+            "Log messages waiting for the async writer."))
+    {
+        static const char* const levels[] = { "debug", "info", "error" };
+        for (int level = LOG_DEBUG; level < LOG_NONE; ++level)
+        {
+            messages[level] = &Metrics::GetInstance().AddCounter("kvasir_log_messages_total",
+                "Log messages written.", std::string("level=\"") + levels[level] + '"');
+        }
+    }
+
+    static LogMetrics& Get()
+    {
+        static LogMetrics metrics;
+        return metrics;
+    }
+};
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+size_t FormatLogPreamble(LogLevel level, std::chrono::system_clock::time_point time, char* buffer)
+{
+    thread_local SecondCache cache;
+    thread_local const ThreadTag thread;
+
+    const auto sinceEpoch = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch());
+    const std::time_t second = static_cast<std::time_t>(sinceEpoch.count() / 1000);
+    const unsigned int milliseconds = static_cast<unsigned int>(sinceEpoch.count() % 1000);
+
+    if (second != cache.second)
+    {
+        std::tm brokenTime;
+        safe_localtime(&second, &brokenTime);
+
+        char* out = cache.text;
+        out = PutDigits(out, brokenTime.tm_year + 1900, 4);
+        *out++ = '-';
+        out = PutDigits(out, brokenTime.tm_mon + 1, 2);
+        *out++ = '-';
+        out = PutDigits(out, brokenTime.tm_mday, 2);
+        *out++ = ' ';
+        out = PutDigits(out, brokenTime.tm_hour, 2);
+        *out++ = ':';
+        out = PutDigits(out, brokenTime.tm_min, 2);
+        *out++ = ':';
+        PutDigits(out, brokenTime.tm_sec, 2);
+        cache.second = second;
+    }
+
+    char* out = buffer;
+    std::memcpy(out, cache.text, sizeof(cache.text));
+    out += sizeof(cache.text);
+    *out++ = '.';
+    out = PutDigits(out, milliseconds, 3);
+    *out++ = ' ';
+    std::memcpy(out, thread.text, thread.length);
+    out += thread.length;
+    *out++ = ' ';
+
+    static const char* const levelTags[] = { "DBG ", "INF ", "ERR ", "" };
+    for (const char* tag = levelTags[level]; *tag; ++tag)
+        *out++ = *tag;
+
+    return static_cast<size_t>(out - buffer);
+}
+
+//////////////////////////////////////////////////////////////////////////
+struct LogRecord
+{
+    LogLevel level = LOG_NONE;
+    std::string text;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Queue of formatted messages and the background thread writing them
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+struct Logger::AsyncChannel
+{
+    Logger& logger;
+    BoundedQueue<LogRecord> queue;
+    const OverflowPolicy overflow;
+    const std::chrono::milliseconds flushInterval;
+    const LogLevel flushLevel;
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<bool> stop{ false };
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::atomic<unsigned int> blocked{ 0 };    // Producers waiting for room in the queue
+    std::mutex roomLock;
+    std::condition_variable room;
+    std::thread writer;
+
+    AsyncChannel(Logger& logger, size_t capacity, OverflowPolicy overflow,
+        std::chrono::milliseconds flushInterval, LogLevel flushLevel)
+        : logger(logger)
+        , queue(capacity)
+        , overflow(overflow)
+        , flushInterval(flushInterval)
+        , flushLevel(flushLevel)
+        , writer([this] { Run(); })
+    {}
+
+    void Push(LogLevel level, std::string text)
+    {
+        LogRecord record{ level, std::move(text) };
+        while (!queue.TryPush(record))
+        {
+            // Nobody makes room in a stopped channel: a late message is lost
+            if (OverflowPolicy::Drop == overflow || stop.load(std::memory_order_acquire))
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                LogMetrics::Get().dropped.Increment();
+                return;
+            }
+
+            // The writer tells once it has taken a record. Counted in before
+            // the last try, so that the room made after it is not missed
+            std::unique_lock<std::mutex> lock(roomLock);
+            blocked.fetch_add(1);
+            wake.notify_one();
+            const bool pushed = queue.TryPush(record);
+            if (!pushed)
+                room.wait_for(lock, flushInterval);
+            blocked.fetch_sub(1);
+            if (pushed)
+                break;
+        }
+
+        LogMetrics::Get().queueDepth.Add(1);
+        if (level >= flushLevel)
+            wake.notify_one();
+    }
+
+    void Run()
+    {
+        // The writer polls the queue, producers wake it up only for the
+        // urgent messages and when the queue is full
+        const auto idleWait = std::min(flushInterval, std::chrono::milliseconds(10));
+        auto lastFlush = std::chrono::steady_clock::now();
+        bool unflushed = false;
+
+        for (;;)
+        {
+            const bool stopping = stop.load(std::memory_order_acquire);
+            bool urgent = false;
+            bool written = false;
+
+            LogRecord record;
+            while (queue.TryPop(record))
+            {
+                if (blocked.load())
+                {
+                    std::lock_guard<std::mutex> lock(roomLock);
+                    room.notify_all();
+                }
+                LogMetrics::Get().queueDepth.Add(-1);
+                {
+                    std::lock_guard<std::mutex> lock(logger.m_outputLock);
+                    logger.WriteRecord(record.level, record.text);
+                }
+                urgent = urgent || record.level >= flushLevel;
+                written = true;
+            }
+
+            if (const uint64_t count = dropped.exchange(0, std::memory_order_relaxed))
+            {
+                std::lock_guard<std::mutex> lock(logger.m_outputLock);
+                logger.WriteRecord(LOG_ERROR, std::to_string(count) + " log messages are dropped on queue overflow");
+                written = true;
+            }
+
+            unflushed = unflushed || written;
+            const auto now = std::chrono::steady_clock::now();
+            if (unflushed && (urgent || stopping || now - lastFlush >= flushInterval))
+            {
+                std::lock_guard<std::mutex> lock(logger.m_outputLock);
+                logger.FlushChannels();
+                lastFlush = now;
+                unflushed = false;
+            }
+
+            if (written)
+                continue;
+            if (stopping)
+                break;
+
+            std::unique_lock<std::mutex> lock(wakeLock);
+            wake.wait_for(lock, idleWait);
+        }
+    }
+
+    void Stop()
+    {
+        stop.store(true, std::memory_order_release);
+        wake.notify_one();
+        {
+            std::lock_guard<std::mutex> lock(roomLock);
+            room.notify_all();
+        }
+        writer.join();
+    }
+};
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// True if the process is alive, a process of another user included
+//////////////////////////////////////////////////////////////////////////
+bool IsProcessRunning(unsigned long pid)
+{
+#ifdef _WIN32
+    const HANDLE process = ::OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+    if (!process)
+        return ::GetLastError() == ERROR_ACCESS_DENIED;
+    const bool running = ::WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    ::CloseHandle(process);
+    return running;
+#else
+    return ::kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif // _WIN32
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Log files of this kvasir process and of the ones which are over,
+///   either plain or compressed. The files of the other processes still
+///   running are theirs to remove: the current one is open there.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+bool IsLogFile(const fs::directory_entry& entry)
+{
+    static const std::regex logFileMask("kvasir-(\\d+)-\\d{4}-\\d{2}-\\d{2}T\\d{6}(-\\d+)?\\.log(\\.gz)?");
+
+    std::error_code err;
+    if (!entry.is_regular_file(err))
+        return false;
+
+    std::smatch match;
+    const std::string name = entry.path().filename().string();
+    if (!std::regex_match(name, match, logFileMask))
+        return false;
+    const unsigned long pid = std::stoul(match[1].str());
+    return pid == static_cast<unsigned long>(getpid()) || !IsProcessRunning(pid);
+}
+
+#ifdef KVASIR_HAVE_ZLIB
+//////////////////////////////////////////////////////////////////////////
+void CompressFile(const fs::path& source, const fs::path& target)
+{
+    std::ifstream input(source, std::ios::binary);
+    if (!input.is_open())
+        throw std::runtime_error("failed to open " + source.string());
+
+    gzFile output = gzopen(target.string().c_str(), "wb6");
+    if (!output)
+        throw std::runtime_error("failed to create " + target.string());
+
+    std::vector<char> chunk(64 * 1024);
+    bool written = true;
+    while (written && input)
+    {
+        input.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        const int size = static_cast<int>(input.gcount());
+        written = size == 0 || gzwrite(output, chunk.data(), static_cast<unsigned int>(size)) == size;
+    }
+
+    if (gzclose(output) != Z_OK || !written)
+    {
+        std::error_code err;
+        fs::remove(target, err);
+        throw std::runtime_error("failed to write " + target.string());
+    }
+}
+#endif // KVASIR_HAVE_ZLIB
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Background thread compressing the rotated log files and removing
+///   those beyond the retention limits
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+struct Logger::Archiver
+{
+    Logger& logger;
+    const fs::path logDir;
+    const LogRotation rotation;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<fs::path> jobs;          // Rotated files, empty if only the retention is due
+    fs::path current;                   // Log file in use, never touched
+    bool stop = false;
+    std::thread worker;
+
+    Archiver(Logger& logger, const std::string& logDir, const LogRotation& rotation)
+        : logger(logger)
+        , logDir(logDir)
+        , rotation(rotation)
+        , worker([this] { Run(); })
+    {}
+
+    ~Archiver()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void Submit(const fs::path& rotated, const fs::path& inUse)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            jobs.push_back(rotated);
+            current = inUse;
+        }
+        wake.notify_one();
+    }
+
+    void Run()
+    {
+        // Pending jobs are finished before the thread exits
+        for (;;)
+        {
+            fs::path rotated;
+            fs::path inUse;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return stop || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                rotated = std::move(jobs.front());
+                jobs.pop_front();
+                inUse = current;
+            }
+
+            try
+            {
+                if (!rotated.empty())
+                    Compress(rotated);
+                ApplyRetention(inUse);
+            }
+            catch (const std::exception& e)
+            {
+                logger.Error() << "failed to archive log files: " << e.what();
+            }
+        }
+    }
+
+    void Compress(const fs::path& path)
+    {
+        if (!rotation.compress)
+            return;
+#ifdef KVASIR_HAVE_ZLIB
+        // The file may be already gone by the retention
+        if (!fs::exists(path))
+            return;
+
+        // The archive keeps the time of the log: the retention goes by it
+        const fs::path archive = path.string() + ".gz";
+        CompressFile(path, archive);
+        fs::last_write_time(archive, fs::last_write_time(path));
+        fs::remove(path);
+#else
+        (void)path;
+#endif // KVASIR_HAVE_ZLIB
+    }
+
+    void ApplyRetention(const fs::path& inUse)
+    {
+        if (!rotation.maxFiles && !rotation.maxTotalSize)
+            return;
+
+        struct LogFile
+        {
+            fs::file_time_type time;
+            uint64_t size;
+            fs::path path;
+        };
+        std::vector<LogFile> files;
+        for (const fs::directory_entry& entry : fs::directory_iterator(logDir))
+        {
+            if (!IsLogFile(entry) || entry.path() == inUse)
+                continue;
+            std::error_code err;
+            const auto time = entry.last_write_time(err);
+            const auto size = entry.file_size(err);
+            if (!err)
+                files.push_back(LogFile{ time, static_cast<uint64_t>(size), entry.path() });
+        }
+
+        // The newest files are kept
+        std::sort(files.begin(), files.end(),
+            [](const LogFile& lhs, const LogFile& rhs) { return lhs.time > rhs.time; });
+
+        uint64_t totalSize = 0;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            totalSize += files[i].size;
+            const bool tooMany = rotation.maxFiles && i >= rotation.maxFiles;
+            const bool tooBig = rotation.maxTotalSize && totalSize > rotation.maxTotalSize;
+            if (!tooMany && !tooBig)
+                continue;
+
+            std::error_code err;
+            fs::remove(files[i].path, err);
+            if (err)
+                logger.Error() << "failed to remove old log file \"" << files[i].path.string() << "\": " << err.message();
+        }
+    }
+};
+
 //////////////////////////////////////////////////////////////////////////
 Logger& Logger::GetInstance()
 {
@@ -43,8 +533,39 @@ Logger& Logger::GetInstance()
 Logger::Logger()
     : m_consoleLevel(LOG_INFO)
     , m_fileLevel(LOG_NONE)
+    , m_fileNumber(0)
+    , m_fileSize(0)
+    , m_async(nullptr)
 {}
 
+//////////////////////////////////////////////////////////////////////////
+Logger::~Logger()
+{
+    DisableAsyncMode();
+    m_archiver.reset();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Logger::EnableAsyncMode(size_t capacity, OverflowPolicy overflow,
+    std::chrono::milliseconds flushInterval, LogLevel flushLevel)
+{
+    // A caller may still hold the previous channel: it's freed at exit only
+    DisableAsyncMode();
+    if (m_asyncChannel)
+        m_retiredChannels.push_back(std::move(m_asyncChannel));
+    m_asyncChannel = std::make_unique<AsyncChannel>(*this, capacity, overflow, flushInterval, flushLevel);
+    m_async.store(m_asyncChannel.get(), std::memory_order_release);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Logger::DisableAsyncMode()
+{
+    // The channel object stays alive: a caller that has just picked it up
+    // may still push into it (such a late message is lost)
+    if (AsyncChannel* channel = m_async.exchange(nullptr, std::memory_order_acq_rel))
+        channel->Stop();
+}
+
 //////////////////////////////////////////////////////////////////////////
 void Logger::EnableConsoleChannel(LogLevel level)
 {
@@ -53,7 +574,7 @@ void Logger::EnableConsoleChannel(LogLevel level)
 
 //////////////////////////////////////////////////////////////////////////
 void Logger::EnableFileChannel(const std::string& logDir, bool cleanOld,
-    LogLevel level)
+    LogLevel level, const LogRotation& rotation)
 {    
     assert(!logDir.empty() && "logDir should not be empty");
 
@@ -62,6 +583,7 @@ void Logger::EnableFileChannel(const std::string& logDir, bool cleanOld,
         if (m_logFile.is_open())
             m_logFile.close();
         m_fileLevel = level;
+        m_archiver.reset();
         return;
     }
 
@@ -80,15 +602,9 @@ void Logger::EnableFileChannel(const std::string& logDir, bool cleanOld,
         if (cleanOld)
         {
             fs::directory_iterator lastDirItem;
-            const std::regex logFileMask("kl_feed_util-\\d+-\\d{4}-\\d{2}-\\d{2}T\\d{6}");
             for (fs::directory_iterator dirItem(logDir); dirItem != lastDirItem; ++dirItem)
             {
-                if (!fs::is_regular_file(dirItem->status()))
-                    continue;
-
-                std::smatch match;
-				const std::string fileName = dirItem->path().filename().string();
-                if (!std::regex_match(fileName, match, logFileMask))
+                if (!IsLogFile(*dirItem))
                     continue;
 
                 std::error_code err;
@@ -99,34 +615,23 @@ void Logger::EnableFileChannel(const std::string& logDir, bool cleanOld,
                         << err.message();
                 }
 
-                Debug() << "stale log file \"" << dirItem->path().string() << "\" is removed";
+                KVASIR_LOG(DEBUG) << "stale log file \"" << dirItem->path().string() << "\" is removed";
             }
         }
 
-        std::string logName;
-        {
-            const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-            const std::time_t timeNow = std::chrono::system_clock::to_time_t(now);
-            std::tm brokenTime;
-            safe_localtime(&timeNow, &brokenTime);
-
-            std::ostringstream buf;
-            // Forced to use std::strftime, because GCC versions prior 5.0 don't support
-            char timebuf[64];
-            std::strftime(&timebuf[0], sizeof(timebuf), "-%Y-%m-%dT%H%M%S", &brokenTime);
-            buf << "kl_feed_util-" << getpid() << timebuf;
-            logName = std::move(buf.str());
-        }
-
-        const fs::path logPath = logDir / fs::path(logName);
-        m_logFile.open(logPath);
-        if (!m_logFile.is_open())
+        m_logDir = logDir;
+        m_rotation = rotation;
+        if (!OpenLogFile())
         {
-            Error() << "failed to open log file \"" << logName << "\" for writing";
+            Error() << "failed to open log file \"" << m_logPath << "\" for writing";
         }
         else
         {
             m_fileLevel = level;
+            m_archiver = std::make_unique<Archiver>(*this, m_logDir, m_rotation);
+
+            // Files left by the previous runs are subject to the retention too
+            m_archiver->Submit(fs::path(), m_logPath);
         }
     }
     catch (const fs::filesystem_error& e)
@@ -135,6 +640,56 @@ void Logger::EnableFileChannel(const std::string& logDir, bool cleanOld,
     }
 }
 
+//////////////////////////////////////////////////////////////////////////
+bool Logger::OpenLogFile()
+{
+    const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    const std::time_t timeNow = std::chrono::system_clock::to_time_t(now);
+    std::tm brokenTime;
+    safe_localtime(&timeNow, &brokenTime);
+
+    // Forced to use std::strftime, because GCC versions prior 5.0 don't support
+    char timebuf[64];
+    std::strftime(&timebuf[0], sizeof(timebuf), "-%Y-%m-%dT%H%M%S", &brokenTime);
+    const std::string baseName = "kvasir-" + std::to_string(getpid()) + timebuf;
+
+    // Files rotated within the same second are numbered
+    m_fileNumber = baseName == m_baseName ? m_fileNumber + 1 : 0;
+    m_baseName = baseName;
+    const auto numbered = [this] {
+        return fs::path(m_logDir) / (m_baseName + (m_fileNumber ? '-' + std::to_string(m_fileNumber) : "") + ".log");
+    };
+    fs::path logPath = numbered();
+    while (fs::exists(logPath) || fs::exists(logPath.string() + ".gz"))
+    {
+        ++m_fileNumber;
+        logPath = numbered();
+    }
+
+    m_logPath = logPath.string();
+    m_logFile.open(logPath);
+    m_fileSize = 0;
+    if (m_rotation.interval.count() > 0)
+    {
+        const auto interval = std::chrono::duration_cast<std::chrono::system_clock::duration>(m_rotation.interval);
+        m_rotateAt = std::chrono::system_clock::time_point((now.time_since_epoch() / interval + 1) * interval);
+    }
+    return m_logFile.is_open();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Logger::RotateLogFile()
+{
+    // Called while writing a record: the failures can't be logged
+    m_logFile.close();
+    const std::string rotatedPath = m_logPath;
+    if (!OpenLogFile())
+        std::cerr << "failed to open log file \"" << m_logPath << "\" for writing" << std::endl;
+
+    if (m_archiver)
+        m_archiver->Submit(rotatedPath, m_logPath);
+}
+
 //////////////////////////////////////////////////////////////////////////
 bool Logger::IsVerbose() const noexcept
 {
@@ -142,65 +697,78 @@ bool Logger::IsVerbose() const noexcept
 }
 
 //////////////////////////////////////////////////////////////////////////
-void Logger::PutMessage(LogLevel level, const std::string& message)
+void Logger::PutMessage(LogLevel level, std::string_view message)
 {
-    static std::mutex outputLock;
-
     // Check if the requested log level is allowed in any of
     // configured channels
     if (level < m_consoleLevel && level < m_fileLevel)
         return;
+    if (level < LOG_NONE)
+        LogMetrics::Get().messages[level]->Increment();
 
-    // Prepare the preamble of the message
-    std::string preamble;
+    char preamble[LogPreambleCapacity];
+    const size_t preambleLength = FormatLogPreamble(level, std::chrono::system_clock::now(), preamble);
+
+    std::string record;
+    record.reserve(preambleLength + message.size());
+    record.append(preamble, preambleLength).append(message);
+
+    if (AsyncChannel* channel = m_async.load(std::memory_order_acquire))
     {
-        std::ostringstream buf;
-        const std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-        const std::time_t timeNow = std::chrono::system_clock::to_time_t(now);
-        std::tm brokenTime;
-        safe_localtime(&timeNow, &brokenTime);
-        std::chrono::system_clock::duration milliseconds = now.time_since_epoch();
-        milliseconds -= std::chrono::duration_cast<std::chrono::seconds>(milliseconds);
-
-        buf << std::setw(4) << std::setfill('0') << brokenTime.tm_year + 1900
-            << '-' << std::setw(2) << std::setfill('0') << brokenTime.tm_mon + 1
-            << '-' << std::setw(2) << std::setfill('0') << brokenTime.tm_mday
-            << ' ' << std::setw(2) << std::setfill('0') << brokenTime.tm_hour
-            << ':' << std::setw(2) << std::setfill('0') << brokenTime.tm_min
-            << ':' << std::setw(2) << std::setfill('0') << brokenTime.tm_sec
-            << '.' << std::setw(3) << std::setfill('0') << milliseconds / std::chrono::milliseconds(1)
-            << ' ' << std::hex << std::this_thread::get_id() << ' ';
-
-        switch (level)
-        {
-        case LOG_DEBUG:
-            buf << "DBG ";
-            break;
-        case LOG_INFO:
-            buf << "INF ";
-            break;
-        case LOG_ERROR:
-            buf << "ERR ";
-            break;
-        case LOG_NONE:
-            break;
-        }
+        channel->Push(level, std::move(record));
+        return;
+    }
 
-        preamble = std::move(buf.str());
+    {
+        // The writer of a channel being stopped may still be draining it
+        std::lock_guard<std::mutex> lock(m_outputLock);
+        WriteRecord(level, record);
+        FlushChannels();
     }
+}
 
+//////////////////////////////////////////////////////////////////////////
+void Logger::WriteRecord(LogLevel level, const std::string& record)
+{
+    if (level >= m_consoleLevel)
+    {
+        std::cout << record << '\n';
+    }
+
+    // The file failed to open or to write: tried again now and then
+    if (level >= m_fileLevel && !m_logFile.good() && !m_logDir.empty() &&
+        std::chrono::steady_clock::now() >= m_reopenAt)
     {
-        std::lock_guard<std::mutex> lock(outputLock);
-        if (level >= m_consoleLevel)
+        m_logFile.close();
+        m_logFile.clear();
+        if (OpenLogFile())
         {
-            std::cout << preamble << message << std::endl;
+            if (m_archiver)
+                m_archiver->Submit(fs::path(), m_logPath);
         }
+        else
+            m_reopenAt = std::chrono::steady_clock::now() + ReopenInterval;
+    }
 
-        if (level >= m_fileLevel && m_logFile.good())
+    if (level >= m_fileLevel && m_logFile.good())
+    {
+        m_logFile << record << '\n';
+        m_fileSize += record.size() + 1;
+
+        if ((m_rotation.maxFileSize && m_fileSize >= m_rotation.maxFileSize) ||
+            (m_rotation.interval.count() > 0 && std::chrono::system_clock::now() >= m_rotateAt))
         {
-            m_logFile << preamble << message << std::endl;
+            RotateLogFile();
         }
     }
 }
 
+//////////////////////////////////////////////////////////////////////////
+void Logger::FlushChannels()
+{
+    std::cout.flush();
+    if (m_logFile.is_open())
+        m_logFile.flush();
+}
+
 } // namespace kvasir
@@ -7,11 +7,44 @@
 #ifndef KVASIR_LOGGER_H_INCLUDED
 #define KVASIR_LOGGER_H_INCLUDED
 
+#include <type_traits>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
 #include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
 #include <string>
+#include <vector>
 #include <sstream>
 #include <fstream>
 
+//////////////////////////////////////////////////////////////////////////
+/// Log statements below this level are compiled out: 0 - debug, 1 - info,
+/// 2 - error (see KVASIR_LOG)
+//////////////////////////////////////////////////////////////////////////
+#ifndef KVASIR_LOG_MIN_LEVEL
+# define KVASIR_LOG_MIN_LEVEL 0
+#endif // KVASIR_LOG_MIN_LEVEL
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Log statement that costs a single comparison when the level is
+///   disabled at run time and nothing when it is below the build time
+///   threshold: the message arguments are not even evaluated then.
+///   Usage: KVASIR_LOG(DEBUG) << "reading system " << index;
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+#define KVASIR_LOG(level) \
+    if (!kvasir::Logger::IsCompiledIn(kvasir::LOG_##level) || \
+        !kvasir::Logger::GetInstance().IsEnabled(kvasir::LOG_##level)) \
+        ; \
+    else \
+        kvasir::Logger::GetInstance().Message(kvasir::LOG_##level)
+
 namespace kvasir
 {
 
@@ -24,6 +57,47 @@ enum LogLevel
     LOG_NONE
 };
 
+//////////////////////////////////////////////////////////////////////////
+enum class OverflowPolicy
+{
+    Drop,       // Discard the message and count it
+    Block       // Wait until the background writer makes room
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Rotation of the log files. Rotated files are compressed and the old
+///   ones are removed on the background thread.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+struct LogRotation
+{
+    uint64_t maxFileSize = 0;               // Rotate when the file grows bigger, bytes (0 - never)
+    std::chrono::minutes interval{ 0 };     // Rotate on multiples of the interval since the epoch (0 - never)
+    size_t maxFiles = 0;                    // Rotated files to keep (0 - all)
+    uint64_t maxTotalSize = 0;              // Total size of the rotated files to keep, bytes (0 - any)
+    bool compress = true;                   // Gzip rotated files (if built with zlib)
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Room enough for any preamble of the log message
+//////////////////////////////////////////////////////////////////////////
+constexpr size_t LogPreambleCapacity = 64;
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Format "YYYY-MM-DD HH:MM:SS.mmm thread LVL " preamble of the log
+///   message. Broken down time and thread id are cached per thread, so
+///   no allocation and no time zone lookup happen within the same second.
+/// </summary>
+///
+/// <param name="level"> Level of the message </param>
+/// <param name="time"> Time of the message </param>
+/// <param name="buffer"> At least LogPreambleCapacity characters </param>
+/// <returns> Length of the preamble, no terminating zero is written </returns>
+//////////////////////////////////////////////////////////////////////////
+size_t FormatLogPreamble(LogLevel level, std::chrono::system_clock::time_point time, char* buffer);
+
 //////////////////////////////////////////////////////////////////////////
 class Logger
 {
@@ -32,29 +106,73 @@ class Logger
     ///   Helper class to collect the whole message via '<<' operator
     ///   and put it into the logging streams. Instances of this class
     ///   could be obtained via Logger::Debug(), Logger::Info() and
-    ///   Logger::Error() methods only.
+    ///   Logger::Error() methods only. Short messages are collected in
+    ///   the inline buffer, nothing is formatted if the level is disabled.
     /// </summary>
     //////////////////////////////////////////////////////////////////////////
     class MessagePrinter
     {
         friend class Logger;
+        static constexpr size_t InlineCapacity = 256;
+
         Logger& m_parent;
         LogLevel m_level;
-        std::unique_ptr<std::ostringstream> m_buf;
+        bool m_enabled;
+        size_t m_size;
+        char m_inline[InlineCapacity];
+        std::string m_overflow;     // The whole message once it outgrows the inline buffer
+
+        void Append(const char* data, size_t size)
+        {
+            if (m_overflow.empty() && m_size + size <= InlineCapacity)
+            {
+                std::memcpy(m_inline + m_size, data, size);
+                m_size += size;
+                return;
+            }
+
+            if (m_overflow.empty())
+                m_overflow.assign(m_inline, m_size);
+            m_overflow.append(data, size);
+        }
+
+        template<class T>
+        static auto ToInteger(T value) noexcept
+        {
+            if constexpr (std::is_enum_v<T>)
+                return static_cast<std::underlying_type_t<T>>(value);
+            else
+                return value;
+        }
+
+        std::string_view Text() const noexcept
+        {
+            return m_overflow.empty() ? std::string_view(m_inline, m_size) : std::string_view(m_overflow);
+        }
 
     protected:
         MessagePrinter(Logger& parent, LogLevel level)
             : m_parent(parent)
-			, m_level(level)
-			, m_buf(new std::ostringstream())
+            , m_level(level)
+            , m_enabled(parent.IsEnabled(level))
+            , m_size(0)
         {}
 
     public:
         //////////////////////////////////////////////////////////////////////////
-        /// Default move constructor is enabled on purpose to allow proper work of
+        /// Move constructor is enabled on purpose to allow proper work of
         /// the Logger's methods Debug(), Info() and Error()
         //////////////////////////////////////////////////////////////////////////
-        MessagePrinter(MessagePrinter&&) = default;
+        MessagePrinter(MessagePrinter&& other)
+            : m_parent(other.m_parent)
+            , m_level(other.m_level)
+            , m_enabled(other.m_enabled)
+            , m_size(other.m_size)
+            , m_overflow(std::move(other.m_overflow))
+        {
+            std::memcpy(m_inline, other.m_inline, m_size);
+            other.m_enabled = false;
+        }
 
         //////////////////////////////////////////////////////////////////////////
         /// Message is put to the logging stream on object destruction (at the
@@ -62,16 +180,56 @@ class Logger
         //////////////////////////////////////////////////////////////////////////
         ~MessagePrinter()
         {
-            m_parent.PutMessage(m_level, m_buf->str());
+            if (m_enabled)
+                m_parent.PutMessage(m_level, Text());
         }
 
         //////////////////////////////////////////////////////////////////////////
-        /// The only useful method here: put something into the stream
+        /// The only useful method here: put something into the stream. Text
+        /// and numbers are formatted in place, other types go through the
+        /// standard stream.
         //////////////////////////////////////////////////////////////////////////
         template<class T>
         MessagePrinter& operator << (const T& data)
         {
-            *m_buf << data;
+            if (!m_enabled)
+                return *this;
+
+            if constexpr (std::is_convertible_v<const T&, std::string_view>)
+            {
+                const std::string_view text(data);
+                Append(text.data(), text.size());
+            }
+            else if constexpr (std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+                std::is_same_v<T, unsigned char>)
+            {
+                const char c = static_cast<char>(data);
+                Append(&c, 1);
+            }
+            else if constexpr (std::is_same_v<T, bool>)
+            {
+                Append(data ? "1" : "0", 1);
+            }
+            else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+            {
+                char buf[24];
+                const auto result = std::to_chars(buf, buf + sizeof(buf), ToInteger(data));
+                Append(buf, static_cast<size_t>(result.ptr - buf));
+            }
+            else if constexpr (std::is_floating_point_v<T>)
+            {
+                // The same as the default stream formatting
+                char buf[32];
+                const int length = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(data));
+                Append(buf, static_cast<size_t>(length));
+            }
+            else
+            {
+                std::ostringstream buf;
+                buf << data;
+                const std::string text = buf.str();
+                Append(text.data(), text.size());
+            }
             return *this;
         }
     };
@@ -114,6 +272,16 @@ public:
         return MessagePrinter(*this, LOG_ERROR);
     }
 
+    //////////////////////////////////////////////////////////////////////////
+    /// <summary>
+    ///   Put the message of the given level into the log
+    /// </summary>
+    //////////////////////////////////////////////////////////////////////////
+    MessagePrinter Message(LogLevel level)
+    {
+        return MessagePrinter(*this, level);
+    }
+
     //////////////////////////////////////////////////////////////////////////
     /// <summary>
     ///   Set console logging level
@@ -131,8 +299,31 @@ public:
     /// <param name="logDir"> The directory for log files. Should not be empty </param>
     /// <param name="cleanOld"> Remove all log files in the log directory if true </param>
     /// <param name="level"> The level of the console logging </param>
+    /// <param name="rotation"> Rotation and retention of the log files </param>
+    //////////////////////////////////////////////////////////////////////////
+    void EnableFileChannel(const std::string& logDir, bool cleanOld, LogLevel level = LOG_DEBUG,
+        const LogRotation& rotation = LogRotation());
+
+    //////////////////////////////////////////////////////////////////////////
+    /// <summary>
+    ///   Switch to asynchronous output: callers only queue formatted messages
+    ///   and the background thread writes them in batches
+    /// </summary>
+    ///
+    /// <param name="capacity"> Max number of the queued messages </param>
+    /// <param name="overflow"> What to do when the queue is full </param>
+    /// <param name="flushInterval"> Max time written messages may stay unflushed </param>
+    /// <param name="flushLevel"> Messages of this level and above are flushed at once </param>
+    //////////////////////////////////////////////////////////////////////////
+    void EnableAsyncMode(size_t capacity, OverflowPolicy overflow,
+        std::chrono::milliseconds flushInterval, LogLevel flushLevel = LOG_ERROR);
+
+    //////////////////////////////////////////////////////////////////////////
+    /// <summary>
+    ///   Write out all the queued messages and get back to synchronous output
+    /// </summary>
     //////////////////////////////////////////////////////////////////////////
-    void EnableFileChannel(const std::string& logDir, bool cleanOld, LogLevel level = LOG_DEBUG);
+    void DisableAsyncMode();
 
     //////////////////////////////////////////////////////////////////////////
     /// <summary>
@@ -141,14 +332,57 @@ public:
     //////////////////////////////////////////////////////////////////////////
     bool IsVerbose() const noexcept;    
 
+    //////////////////////////////////////////////////////////////////////////
+    /// <summary>
+    ///   Returns true if messages of the level get into any of the channels
+    /// </summary>
+    //////////////////////////////////////////////////////////////////////////
+    bool IsEnabled(LogLevel level) const noexcept
+    {
+        return IsCompiledIn(level) && (level >= m_consoleLevel || level >= m_fileLevel);
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    /// <summary>
+    ///   Returns false if the level is below the build time threshold
+    /// </summary>
+    //////////////////////////////////////////////////////////////////////////
+    static constexpr bool IsCompiledIn(LogLevel level) noexcept
+    {
+        return static_cast<int>(level) >= KVASIR_LOG_MIN_LEVEL;
+    }
+
 protected:
-    void PutMessage(LogLevel level, const std::string& message);
+    void PutMessage(LogLevel level, std::string_view message);
 
 private:
+    struct AsyncChannel;
+    struct Archiver;
+
     Logger();
+    ~Logger();
+
+    void WriteRecord(LogLevel level, const std::string& record);
+    void FlushChannels();
+    bool OpenLogFile();
+    void RotateLogFile();
+
     LogLevel m_consoleLevel;
     LogLevel m_fileLevel;
     std::ofstream m_logFile;
+    std::string m_logDir;
+    std::string m_logPath;
+    std::string m_baseName;
+    unsigned int m_fileNumber;
+    LogRotation m_rotation;
+    uint64_t m_fileSize;
+    std::chrono::system_clock::time_point m_rotateAt;
+    std::chrono::steady_clock::time_point m_reopenAt;  // Of the file which failed
+    std::unique_ptr<Archiver> m_archiver;
+    std::unique_ptr<AsyncChannel> m_asyncChannel;
+    std::vector<std::unique_ptr<AsyncChannel>> m_retiredChannels;  // Replaced, may be still in use
+    std::atomic<AsyncChannel*> m_async;
+    std::mutex m_outputLock;            // Of the channels: the writer and the sync path share them
 };
 
 } // namespace kvasir
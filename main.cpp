@@ -5,9 +5,21 @@
 //////////////////////////////////////////////////////////////////////////
 
 #include "config.h"
+#include "group.h"
 #include "logger.h"
+#include "trace.h"
+#include "monitor.h"
+#include "metrics_server.h"
+#include "daemon.h"
 #include "scanner.h"
+#include "recorder.h"
 #include "scan_settings.h"
+#include "serial_replay.h"
+#include "socket_transport.h"
+#include "sweep.h"
+#include "name_index.h"
+#include "port_watcher.h"
+#include "timebase.h"
 
 #include <QtCore/QDir>
 #include <QtCore/QTimer>
@@ -15,21 +27,61 @@
 #include <QtCore/QCoreApplication>
 #include <QtCore/QCommandLineParser>
 
+#include <algorithm>
 #include <iostream>
 #include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <future>
 
 #ifdef _WIN32
 // It's required to initialize COM before working with Qt Multimedia
 # include <objbase.h>
 # include <rpcdce.h>
-#endif _WIN32
+#endif // _WIN32
+
+//////////////////////////////////////////////////////////////////////////
+struct TaskOptions
+{
+	bool monitor = false;                           // Keep polling and recording
+	std::chrono::milliseconds pollInterval{ 100 };
+	std::string capturePath;                        // Record the serial traffic here
+	std::string replayPath;                         // Replay the capture instead of the radio
+	std::string port;                               // Overrides the configured port
+	kvasir::SerialBackend serialBackend = kvasir::SerialBackend::Qt;
+	std::string daemonAddress;                      // Share the radio with other processes
+	std::string connectAddress;                     // Use the radio shared by the daemon
+	kvasir::SweepRange sweepRange;
+	unsigned int sweepPasses = 0;                   // Sweep the band instead of the dump
+	std::string occupancyPath;                      // Occupancy map kept between sweeps
+	std::string findQuery;                          // Names to look for after the dump
+	kvasir::ReplaySpeed replaySpeed = kvasir::ReplaySpeed::Realtime;
+};
 
 class DiscoveryTask : public QObject
 {
 	Q_OBJECT
+
+	const TaskOptions m_options;
+	QString m_dataLocation;
+	std::unique_ptr<kvasir::Config> m_config;
+	kvasir::Device m_device;
+	kvasir::ScanSettingsStore m_scanSettings;       // Read by any thread, replaced by the reloads
+	std::unique_ptr<kvasir::Scanner> m_scanner;
+	std::unique_ptr<kvasir::Monitor> m_monitorLoop;
+	std::unique_ptr<kvasir::Recorder> m_recorder;
+	std::unique_ptr<kvasir::Daemon> m_daemon;
+	std::unique_ptr<kvasir::PortWatcher> m_portWatcher;  // Of the radio's own port only
+	kvasir::Timestamp m_lost;                       // When the link to the radio was lost
+	bool m_watching = false;                        // For the lost radio to come back
+	kvasir::NameIndex m_names;                      // Of m_scanSettings, used by the dump only
+	std::future<void> m_dump;                       // Waited for before the scanner is gone
+
 public:
-	DiscoveryTask(QObject* parent = nullptr)
+	DiscoveryTask(const TaskOptions& options, QObject* parent = nullptr)
 		: QObject(parent)
+		, m_options(options)
 	{}
 
 public slots:
@@ -42,38 +94,73 @@ public slots:
 				throw std::runtime_error("failed to determine path to the data directory");
 
 			kvasir::Logger& log = kvasir::Logger::GetInstance();
-			kvasir::Config config(QDir(dataLocations.first()).filePath("config.db").toStdString());
+			m_dataLocation = dataLocations.first();
+			m_config = std::make_unique<kvasir::Config>(QDir(m_dataLocation).filePath("config.db").toStdString());
 
 			log.Info() << "Configured devices:";
-			for (const auto& device : config.GetDevices())
+			for (const auto& device : m_config->GetDevices())
 			{
 				log.Info() << "\t- " << device.name << " at " << device.port << ' ' << device.baudRate
 					<< ' ' << device.dataBits << (device.parityCheck ? 'E' : 'N') << device.stopBits;
 			}
 
-			kvasir::Scanner scanner;
-			scanner.Connect(config.GetDevices().front());
-			log.Info() << "Scanner model: " << scanner.GetModel();
-			log.Info() << "Firmware version: " << scanner.GetFirmwareVersion();
+			m_device = m_config->GetDevices().front();
+			if (!m_options.port.empty())
+				m_device.port = m_options.port;
+			m_scanner = std::make_unique<kvasir::Scanner>();
+			kvasir::Scanner& scanner = *m_scanner;
+			if (!m_options.capturePath.empty())
+				scanner.StartCapture(m_options.capturePath);
+			if (!m_options.connectAddress.empty())
+			{
+				const std::string address = m_options.connectAddress;
+				scanner.Connect([address] { return std::make_unique<kvasir::SocketTransport>(address); });
+			}
+			else if (m_options.replayPath.empty())
+			{
+				scanner.Connect(m_device, m_options.serialBackend);
+				m_portWatcher = std::make_unique<kvasir::PortWatcher>(m_device.port, std::chrono::seconds(1));
+			}
+			else
+				scanner.Connect(std::make_unique<kvasir::ReplayTransport>(m_options.replayPath, m_options.replaySpeed));
 
-			kvasir::ScanSettings scanSettings;
-			scanSettings.Load(scanner);
-			for (const auto& sys : scanSettings.Systems())
+			// The daemon serves the clients at once, the dump would hold them up
+			if (!m_options.daemonAddress.empty())
 			{
-				std::visit([&log](auto&& arg)
-				{
-					log.Info() << "System #" << arg.SequenceNumber() << ": " << arg.Name();
-				}, sys);
-				
+				m_daemon = std::make_unique<kvasir::Daemon>(scanner, m_options.daemonAddress,
+					m_options.pollInterval / 2);
+				m_daemon->SetLinkLostHandler([this] { OnDisconnected(); });
+				m_daemon->SetProgrammingHandler([this](bool active) { OnProgramming(active); });
+				if (m_options.monitor)
+					StartMonitoring(*m_config, m_device, m_dataLocation);
+				return;
 			}
-			emit finished();
 		}
 		catch (const std::exception& e)
 		{
 			std::cerr << "failure: " << e.what() << std::endl;
 			emit finished();
+			return;
 		}
 
+		// The dump takes seconds: keep the event loop of this thread free
+		m_dump = std::async(std::launch::async, [this]
+		{
+			std::string error;
+			try
+			{
+				if (m_options.sweepPasses)
+					Sweep();
+				else
+					Dump();
+			}
+			catch (const std::exception& e)
+			{
+				error = e.what();
+			}
+			QMetaObject::invokeMethod(this, [this, error] { OnDumped(error); }, Qt::QueuedConnection);
+		});
+
 		/*
 		const auto portList = QSerialPortInfo::availablePorts();
 		log.Info() << "COM ports:";
@@ -81,16 +168,237 @@ public slots:
 		{
 			log.Info() << "\t- " << port.portName().toStdString();
 		}
+		*/
+	}	
+
+private:
+	void Dump()
+	{
+		kvasir::Logger& log = kvasir::Logger::GetInstance();
+		kvasir::Scanner& scanner = *m_scanner;
+		log.Info() << "Scanner model: " << scanner.GetModel();
+		log.Info() << "Firmware version: " << scanner.GetFirmwareVersion();
 
-		QAudioRecorder recorder;
-		log.Info() << "Default audio input: " <<recorder.defaultAudioInput().toStdString();
-		log.Info() << "Audio inputs:";
-		for (const auto& inputs : recorder.audioInputs())
+		m_scanSettings.Reload(scanner);
+		const kvasir::ScanSettingsStore::Snapshot scanSettings = m_scanSettings.Current();
+		for (const auto& sys : scanSettings->Systems())
 		{
-			log.Info() << "\t- " << inputs.toStdString();
+			std::visit([&log](auto&& arg)
+			{
+				log.Info() << "System #" << arg.SequenceNumber() << ": " << arg.Name();
+			}, sys);
+			
 		}
-		*/
-	}	
+
+		m_names.Update(*scanSettings);
+		if (!m_options.findQuery.empty())
+		{
+			log.Info() << "Names matching \"" << m_options.findQuery << "\":";
+			for (const kvasir::NameMatch& match : m_names.Find(m_options.findQuery))
+				log.Info() << "\t- " << match.name;
+		}
+	}
+
+	void Sweep()
+	{
+		kvasir::Logger& log = kvasir::Logger::GetInstance();
+		const std::string path = !m_options.occupancyPath.empty() ? m_options.occupancyPath :
+			QDir(m_dataLocation).filePath("occupancy.csv").toStdString();
+
+		kvasir::OccupancyMap map;
+		map.Load(path);
+		kvasir::Sweeper sweeper(*m_scanner, m_scanSettings, kvasir::SweepSettings());
+		try
+		{
+			for (unsigned int pass = 1; pass <= m_options.sweepPasses; ++pass)
+			{
+				const kvasir::SweepStats stats = sweeper.Run(m_options.sweepRange, map);
+				log.Info() << "Sweep #" << pass << ": " << stats.hits << " of " << stats.steps << " steps on air, "
+					<< stats.samples << " samples in "
+					<< std::chrono::duration_cast<std::chrono::milliseconds>(stats.duration).count() << " ms";
+				map.Save(path);
+			}
+		}
+		catch (...)
+		{
+			// The radio must not stay held on the step the sweep failed at
+			try
+			{
+				sweeper.Resume();
+			}
+			catch (const std::exception& e)
+			{
+				log.Error() << "failed to resume scanning: " << e.what();
+			}
+			throw;
+		}
+		sweeper.Resume();
+
+		log.Info() << "Most active frequencies:";
+		for (const auto& entry : map.Hottest(20))
+		{
+			char line[128];
+			std::snprintf(line, sizeof(line), "%11.4f MHz  %5.1f%% on air, %llu of %llu sweeps, max level %u",
+				static_cast<double>(entry.first) / 1e6, entry.second.Activity() * 100,
+				static_cast<unsigned long long>(entry.second.hits),
+				static_cast<unsigned long long>(entry.second.visits), entry.second.maxLevel);
+			log.Info() << '\t' << line;
+		}
+	}
+
+	void OnDumped(const std::string& error)
+	{
+		try
+		{
+			if (!error.empty())
+				throw std::runtime_error(error);
+
+			if (m_options.monitor && !m_options.sweepPasses)
+			{
+				StartMonitoring(*m_config, m_device, m_dataLocation);
+				return;
+			}
+			emit finished();
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "failure: " << e.what() << std::endl;
+			emit finished();
+		}
+	}
+
+private:
+	void StartMonitoring(const kvasir::Config& config, const kvasir::Device& device,
+		const QString& dataLocation)
+	{
+		// Capture replayed at max speed is polled as fast as it answers
+		const bool fastReplay = !m_options.replayPath.empty() &&
+			kvasir::ReplaySpeed::Maximum == m_options.replaySpeed;
+		m_monitorLoop = std::make_unique<kvasir::Monitor>(*m_scanner, m_scanSettings,
+			fastReplay ? std::chrono::milliseconds::zero() : m_options.pollInterval);
+		m_monitorLoop->SetDisconnectHandler([this] { OnDisconnected(); });
+
+		const auto& recordings = config.GetRecordings();
+		const auto recording = std::find_if(recordings.cbegin(), recordings.cend(),
+			[&device](const kvasir::Recording& r) { return r.device == device.name; });
+		if (recording != recordings.cend())
+		{
+			kvasir::Recording settings = *recording;
+			if (settings.directory.empty())
+				settings.directory = QDir(dataLocation).filePath("recordings").toStdString();
+
+			m_recorder = std::make_unique<kvasir::Recorder>(settings);
+			m_recorder->Start();
+			m_monitorLoop->AddListener([this](const kvasir::ReceptionStatus& status)
+			{
+				m_recorder->OnStatus(status);
+			});
+		}
+
+		m_monitorLoop->Start();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   The radio's port is reopened once it's back (cable bumped, radio
+	///   power cycled) and the polling resumes. The session is the same: the
+	///   device settings, the loaded scan settings, the recorder and the
+	///   listeners of the monitor outlive the link. Nothing waits for the
+	///   radio on this thread meanwhile: the daemon and the timers go on.
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void OnDisconnected()
+	{
+		// Both the monitor and the daemon tell about the same loss
+		if (m_watching)
+			return;
+
+		if (!m_portWatcher)
+		{
+			emit finished();
+			return;
+		}
+
+		kvasir::Logger::GetInstance().Error() << "lost the radio at " << m_device.port << ", waiting for it";
+		m_watching = true;
+		m_lost = kvasir::Clock::now();
+		if (m_monitorLoop)
+			m_monitorLoop->Stop();
+		m_scanner->Disconnect();
+		if (m_daemon)
+			m_daemon->OnLinkLost();
+		WatchPort();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// The radio refuses the polls while a daemon client programs it
+	//////////////////////////////////////////////////////////////////////////
+	void OnProgramming(bool active)
+	{
+		if (!m_monitorLoop || m_watching)
+			return;
+		if (active)
+			m_monitorLoop->Stop();
+		else
+			m_monitorLoop->Start();
+	}
+
+	void WatchPort()
+	{
+		m_portWatcher->Watch([this](const std::string& port) { return Reconnect(port); });
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Open the port found and ask the radio for its model, true if opened
+	//////////////////////////////////////////////////////////////////////////
+	bool Reconnect(const std::string& port)
+	{
+		kvasir::Device device = m_device;
+		device.port = port;
+		try
+		{
+			m_scanner->Connect(device, m_options.serialBackend);
+		}
+		catch (const std::exception& e)
+		{
+			KVASIR_LOG(DEBUG) << "radio is not back yet: " << e.what();
+			m_scanner->Disconnect();
+			return false;
+		}
+
+		m_scanner->Post("MDL\r", [this, device](kvasir::RawReply reply, std::exception_ptr error) {
+			QMetaObject::invokeMethod(this, [this, device, reply = std::move(reply), error] {
+				OnProbed(device, reply, error);
+			}, Qt::QueuedConnection);
+		});
+		return true;
+	}
+
+	void OnProbed(const kvasir::Device& device, const kvasir::RawReply& reply, std::exception_ptr error)
+	{
+		std::string model;
+		try
+		{
+			if (error)
+				std::rethrow_exception(error);
+			model = kvasir::Scanner::ParseReply("MDL\r", reply.text, 1).front();
+		}
+		catch (const std::exception& e)
+		{
+			// The port is there but the radio is still booting, or not there
+			KVASIR_LOG(DEBUG) << "radio is not back yet: " << e.what();
+			m_scanner->Disconnect();
+			WatchPort();
+			return;
+		}
+
+		m_device = device;
+		m_watching = false;
+		kvasir::Logger::GetInstance().Info() << "radio " << model << " is back at " << device.port << " after "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(kvasir::Clock::now() - m_lost).count() << " ms";
+		if (m_monitorLoop)
+			m_monitorLoop->Start();
+	}
 
 signals:
 	void finished();
@@ -111,17 +419,197 @@ int main(int argc, char* argv[])
 	QCommandLineOption debug(QStringList() << "d" << "debug",
 		QCoreApplication::translate("main", "Enables debugging output to the console."));
 
+	QCommandLineOption monitor(QStringList() << "m" << "monitor",
+		QCoreApplication::translate("main", "Keeps polling the scanner and records transmissions."));
+
+	QCommandLineOption pollInterval(QStringList() << "p" << "poll-interval",
+		QCoreApplication::translate("main", "Reception status polling interval, ms."),
+		QCoreApplication::translate("main", "interval"), "100");
+
+	QCommandLineOption logAsync(QStringList() << "log-async",
+		QCoreApplication::translate("main", "Writes the log on a background thread, "
+			"overflowing messages are dropped or wait for the room (drop|block)."),
+		QCoreApplication::translate("main", "policy"));
+
+	QCommandLineOption logDir(QStringList() << "l" << "log-dir",
+		QCoreApplication::translate("main", "Writes the debug log into the directory."),
+		QCoreApplication::translate("main", "directory"));
+
+	QCommandLineOption logRotateSize(QStringList() << "log-rotate-size",
+		QCoreApplication::translate("main", "Starts the next log file when the current one exceeds the size, MiB."),
+		QCoreApplication::translate("main", "size"), "64");
+
+	QCommandLineOption logRotateInterval(QStringList() << "log-rotate-interval",
+		QCoreApplication::translate("main", "Starts the next log file every interval, hours."),
+		QCoreApplication::translate("main", "interval"), "24");
+
+	QCommandLineOption logKeep(QStringList() << "log-keep",
+		QCoreApplication::translate("main", "Number of the rotated log files to keep."),
+		QCoreApplication::translate("main", "count"), "10");
+
+	QCommandLineOption trace(QStringList() << "t" << "trace",
+		QCoreApplication::translate("main", "Writes the binary trace of the serial traffic "
+			"(see kvasir-tracedump)."),
+		QCoreApplication::translate("main", "file"));
+
+	QCommandLineOption capture(QStringList() << "c" << "capture",
+		QCoreApplication::translate("main", "Records the raw serial traffic into the file."),
+		QCoreApplication::translate("main", "file"));
+
+	QCommandLineOption replay(QStringList() << "r" << "replay",
+		QCoreApplication::translate("main", "Replays the captured traffic instead of talking to the radio."),
+		QCoreApplication::translate("main", "file"));
+
+	QCommandLineOption replaySpeed(QStringList() << "replay-speed",
+		QCoreApplication::translate("main", "Speed of the replay (realtime|max)."),
+		QCoreApplication::translate("main", "speed"), "realtime");
+
+	QCommandLineOption port(QStringList() << "port",
+		QCoreApplication::translate("main", "Talks to the radio at the serial port instead of the configured one "
+			"(e.g. the terminal of kvasir-emulator)."),
+		QCoreApplication::translate("main", "port"));
+
+	QCommandLineOption serial(QStringList() << "serial",
+		QCoreApplication::translate("main", "Implementation of the serial port: QSerialPort or, on Linux, "
+			"the tty device in low latency mode (qt|native)."),
+		QCoreApplication::translate("main", "backend"), "qt");
+
+	QCommandLineOption daemon(QStringList() << "daemon",
+		QCoreApplication::translate("main", "Shares the radio with other processes at the loopback TCP port "
+			"or the local socket; polls of the clients within half the polling interval share one status."),
+		QCoreApplication::translate("main", "address"));
+
+	QCommandLineOption connectDaemon(QStringList() << "connect",
+		QCoreApplication::translate("main", "Talks to the radio through the daemon at the address."),
+		QCoreApplication::translate("main", "address"));
+
+	QCommandLineOption sweep(QStringList() << "sweep",
+		QCoreApplication::translate("main", "Sweeps the band instead of reading the memory: "
+			"first and last frequency in MHz, step in kHz (e.g. 150,174,12.5)."),
+		QCoreApplication::translate("main", "band"));
+
+	QCommandLineOption sweepPasses(QStringList() << "sweep-passes",
+		QCoreApplication::translate("main", "Number of the sweeps over the band."),
+		QCoreApplication::translate("main", "count"), "1");
+
+	QCommandLineOption occupancy(QStringList() << "occupancy",
+		QCoreApplication::translate("main", "Occupancy map the sweeps add to, occupancy.csv "
+			"in the data directory by default."),
+		QCoreApplication::translate("main", "file"));
+
+	QCommandLineOption find(QStringList() << "find",
+		QCoreApplication::translate("main", "Lists the programmed names matching the words after reading "
+			"the memory (e.g. \"fire disp\")."),
+		QCoreApplication::translate("main", "words"));
+
+	QCommandLineOption metricsPort(QStringList() << "metrics-port",
+		QCoreApplication::translate("main", "Serves Prometheus metrics at http://127.0.0.1:<port>/metrics."),
+		QCoreApplication::translate("main", "port"));
+
 	QCommandLineParser cmdLine;
 	cmdLine.addHelpOption();
 	cmdLine.addVersionOption();		
 	cmdLine.addOption(debug);
+	cmdLine.addOption(monitor);
+	cmdLine.addOption(pollInterval);
+	cmdLine.addOption(logAsync);
+	cmdLine.addOption(logDir);
+	cmdLine.addOption(logRotateSize);
+	cmdLine.addOption(logRotateInterval);
+	cmdLine.addOption(logKeep);
+	cmdLine.addOption(trace);
+	cmdLine.addOption(capture);
+	cmdLine.addOption(replay);
+	cmdLine.addOption(replaySpeed);
+	cmdLine.addOption(port);
+	cmdLine.addOption(serial);
+	cmdLine.addOption(daemon);
+	cmdLine.addOption(connectDaemon);
+	cmdLine.addOption(sweep);
+	cmdLine.addOption(sweepPasses);
+	cmdLine.addOption(occupancy);
+	cmdLine.addOption(find);
+	cmdLine.addOption(metricsPort);
 	cmdLine.process(app);
 	if (cmdLine.isSet(debug))
 		kvasir::Logger::GetInstance().EnableConsoleChannel(kvasir::LOG_DEBUG);	
 
+	if (cmdLine.isSet(logDir))
+	{
+		kvasir::LogRotation rotation;
+		rotation.maxFileSize = uint64_t(cmdLine.value(logRotateSize).toUInt()) << 20;
+		rotation.interval = std::chrono::hours(cmdLine.value(logRotateInterval).toUInt());
+		rotation.maxFiles = cmdLine.value(logKeep).toUInt();
+		kvasir::Logger::GetInstance().EnableFileChannel(cmdLine.value(logDir).toStdString(),
+			false, kvasir::LOG_DEBUG, rotation);
+	}
+
+	if (cmdLine.isSet(logAsync))
+	{
+		const QString policy = cmdLine.value(logAsync);
+		if (policy != "drop" && policy != "block")
+			cmdLine.showHelp(1);
+		kvasir::Logger::GetInstance().EnableAsyncMode(8192,
+			policy == "block" ? kvasir::OverflowPolicy::Block : kvasir::OverflowPolicy::Drop,
+			std::chrono::milliseconds(200));
+	}
+
+	// A busy port or an unwritable trace file ends the run before it starts
+	std::unique_ptr<kvasir::MetricsServer> metricsServer;
+	try
+	{
+		if (cmdLine.isSet(metricsPort))
+		{
+			bool valid = false;
+			const unsigned int value = cmdLine.value(metricsPort).toUInt(&valid);
+			if (!valid || !value || value > 65535)
+				cmdLine.showHelp(1);
+			metricsServer = std::make_unique<kvasir::MetricsServer>(static_cast<uint16_t>(value));
+		}
+
+		if (cmdLine.isSet(trace))
+			kvasir::Tracer::Open(cmdLine.value(trace).toStdString());
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "failure: " << e.what() << std::endl;
+		kvasir::Logger::GetInstance().DisableAsyncMode();
+		return 1;
+	}
+
 	// Task parented to the application so that it
 	// will be deleted by the application
-	DiscoveryTask* task = new DiscoveryTask(&app);
+	TaskOptions options;
+	options.monitor = cmdLine.isSet(monitor);
+	options.pollInterval = std::chrono::milliseconds(cmdLine.value(pollInterval).toUInt());
+	options.capturePath = cmdLine.value(capture).toStdString();
+	options.replayPath = cmdLine.value(replay).toStdString();
+	options.port = cmdLine.value(port).toStdString();
+	options.daemonAddress = cmdLine.value(daemon).toStdString();
+	options.connectAddress = cmdLine.value(connectDaemon).toStdString();
+	options.occupancyPath = cmdLine.value(occupancy).toStdString();
+	options.findQuery = cmdLine.value(find).toStdString();
+	if (cmdLine.isSet(sweep))
+	{
+		double first = 0, last = 0, step = 0;
+		if (std::sscanf(cmdLine.value(sweep).toStdString().c_str(), "%lf,%lf,%lf", &first, &last, &step) != 3 ||
+			first <= 0 || last < first || step <= 0)
+			cmdLine.showHelp(1);
+		options.sweepRange.start = static_cast<uint64_t>(std::llround(first * 1e6));
+		options.sweepRange.stop = static_cast<uint64_t>(std::llround(last * 1e6));
+		options.sweepRange.step = static_cast<uint64_t>(std::llround(step * 1e3));
+		options.sweepPasses = std::max(cmdLine.value(sweepPasses).toUInt(), 1u);
+	}
+	if (cmdLine.value(serial) == "native")
+		options.serialBackend = kvasir::SerialBackend::Native;
+	else if (cmdLine.value(serial) != "qt")
+		cmdLine.showHelp(1);
+	if (cmdLine.value(replaySpeed) == "max")
+		options.replaySpeed = kvasir::ReplaySpeed::Maximum;
+	else if (cmdLine.value(replaySpeed) != "realtime")
+		cmdLine.showHelp(1);
+
+	DiscoveryTask* task = new DiscoveryTask(options, &app);
 
 	// This will cause the application to exit when
 	// the task signals "finished"
@@ -130,7 +618,12 @@ int main(int argc, char* argv[])
 	// This will run the task from the application event loop
 	QTimer::singleShot(0, task, SLOT(run()));
 
-	return app.exec();
+	const int result = app.exec();
+	kvasir::Tracer::Close();
+
+	// Drain the queued messages before the static objects are destroyed
+	kvasir::Logger::GetInstance().DisableAsyncMode();
+	return result;
 }
 
 #include "main.moc"
\ No newline at end of file
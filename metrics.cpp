@@ -0,0 +1,240 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: metrics.cpp
+///
+/// summary: process metrics in the Prometheus text format
+//////////////////////////////////////////////////////////////////////////
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+
+namespace kvasir
+{
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+enum class MetricType
+{
+	Counter,
+	Gauge,
+	Histogram
+};
+
+//////////////////////////////////////////////////////////////////////////
+const char* TypeName(MetricType type)
+{
+	switch (type)
+	{
+	case MetricType::Counter:
+		return "counter";
+	case MetricType::Gauge:
+		return "gauge";
+	case MetricType::Histogram:
+		return "histogram";
+	}
+	return "untyped";
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string FormatNumber(double value)
+{
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.9g", value);
+	return buf;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string Braced(const std::string& labels)
+{
+	return labels.empty() ? std::string() : '{' + labels + '}';
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+Histogram::Histogram(std::vector<double> bounds)
+	: m_bounds(std::move(bounds))
+	, m_buckets(new std::atomic<uint64_t>[m_bounds.size() + 1])
+{
+	if (!std::is_sorted(m_bounds.cbegin(), m_bounds.cend()))
+		throw std::logic_error("histogram bounds must be ascending");
+	for (size_t i = 0; i <= m_bounds.size(); ++i)
+		m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Histogram::Observe(double value) noexcept
+{
+	const size_t bucket = static_cast<size_t>(
+		std::lower_bound(m_bounds.cbegin(), m_bounds.cend(), value) - m_bounds.cbegin());
+	m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+	double sum = m_sum.load(std::memory_order_relaxed);
+	while (!m_sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed))
+		;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Histogram::Render(std::string& out, const std::string& name, const std::string& labels) const
+{
+	const std::string prefix = labels.empty() ? std::string() : labels + ',';
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i <= m_bounds.size(); ++i)
+	{
+		cumulative += m_buckets[i].load(std::memory_order_relaxed);
+		const std::string bound = i < m_bounds.size() ? FormatNumber(m_bounds[i]) : "+Inf";
+		out += name + "_bucket{" + prefix + "le=\"" + bound + "\"} " + std::to_string(cumulative) + '\n';
+	}
+	out += name + "_sum" + Braced(labels) + ' ' + FormatNumber(m_sum.load(std::memory_order_relaxed)) + '\n';
+	out += name + "_count" + Braced(labels) + ' ' + std::to_string(cumulative) + '\n';
+}
+
+//////////////////////////////////////////////////////////////////////////
+struct Metrics::Impl
+{
+	struct Series
+	{
+		std::string labels;
+		void* metric;
+	};
+
+	struct Family
+	{
+		std::string name;
+		std::string help;
+		MetricType type;
+		std::vector<Series> series;
+	};
+
+	mutable std::mutex lock;
+	std::vector<Family> families;
+	std::deque<Counter> counters;
+	std::deque<Gauge> gauges;
+	std::deque<Histogram> histograms;
+
+	// Registered metric of the name and labels, nullptr if none
+	void* Find(const std::string& name, const std::string& help, MetricType type, const std::string& labels,
+		Family*& family)
+	{
+		const auto found = std::find_if(families.begin(), families.end(),
+			[&name](const Family& f) { return f.name == name; });
+		if (found == families.end())
+		{
+			families.push_back(Family{ name, help, type, {} });
+			family = &families.back();
+			return nullptr;
+		}
+
+		if (found->type != type)
+			throw std::logic_error("metric " + name + " is already registered as " + TypeName(found->type));
+		family = &*found;
+		for (const auto& series : found->series)
+		{
+			if (series.labels == labels)
+				return series.metric;
+		}
+		return nullptr;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+Metrics::Metrics()
+	: m_impl(std::make_unique<Impl>())
+{}
+
+//////////////////////////////////////////////////////////////////////////
+Metrics::~Metrics() = default;
+
+//////////////////////////////////////////////////////////////////////////
+Metrics& Metrics::GetInstance()
+{
+	static Metrics* const instance = new Metrics();
+	return *instance;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Counter& Metrics::AddCounter(const std::string& name, const std::string& help, const std::string& labels)
+{
+	std::lock_guard<std::mutex> lock(m_impl->lock);
+	Impl::Family* family;
+	if (void* metric = m_impl->Find(name, help, MetricType::Counter, labels, family))
+		return *static_cast<Counter*>(metric);
+
+	Counter& counter = m_impl->counters.emplace_back();
+	family->series.push_back(Impl::Series{ labels, &counter });
+	return counter;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Gauge& Metrics::AddGauge(const std::string& name, const std::string& help, const std::string& labels)
+{
+	std::lock_guard<std::mutex> lock(m_impl->lock);
+	Impl::Family* family;
+	if (void* metric = m_impl->Find(name, help, MetricType::Gauge, labels, family))
+		return *static_cast<Gauge*>(metric);
+
+	Gauge& gauge = m_impl->gauges.emplace_back();
+	family->series.push_back(Impl::Series{ labels, &gauge });
+	return gauge;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Histogram& Metrics::AddHistogram(const std::string& name, const std::string& help,
+	const std::vector<double>& bounds, const std::string& labels)
+{
+	std::lock_guard<std::mutex> lock(m_impl->lock);
+	Impl::Family* family;
+	if (void* metric = m_impl->Find(name, help, MetricType::Histogram, labels, family))
+		return *static_cast<Histogram*>(metric);
+
+	Histogram& histogram = m_impl->histograms.emplace_back(bounds);
+	family->series.push_back(Impl::Series{ labels, &histogram });
+	return histogram;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string Metrics::Render() const
+{
+	std::lock_guard<std::mutex> lock(m_impl->lock);
+	std::string out;
+	for (const auto& family : m_impl->families)
+	{
+		out += "# HELP " + family.name + ' ' + family.help + '\n';
+		out += "# TYPE " + family.name + ' ' + TypeName(family.type) + '\n';
+		for (const auto& series : family.series)
+		{
+			switch (family.type)
+			{
+			case MetricType::Counter:
+				out += family.name + Braced(series.labels) + ' ' +
+					std::to_string(static_cast<const Counter*>(series.metric)->Value()) + '\n';
+				break;
+			case MetricType::Gauge:
+				out += family.name + Braced(series.labels) + ' ' +
+					std::to_string(static_cast<const Gauge*>(series.metric)->Value()) + '\n';
+				break;
+			case MetricType::Histogram:
+				static_cast<const Histogram*>(series.metric)->Render(out, family.name, series.labels);
+				break;
+			}
+		}
+	}
+	return out;
+}
+
+//////////////////////////////////////////////////////////////////////////
+const std::vector<double>& LatencyBuckets()
+{
+	static const std::vector<double> bounds = {
+		0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+	};
+	return bounds;
+}
+
+} // namespace kvasir
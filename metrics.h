@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: metrics.h
+///
+/// summary: process metrics in the Prometheus text format
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_METRICS_H_INCLUDED
+#define KVASIR_METRICS_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// Monotonic count of events
+//////////////////////////////////////////////////////////////////////////
+class Counter
+{
+	std::atomic<uint64_t> m_value{ 0 };
+
+public:
+	void Increment(uint64_t count = 1) noexcept
+	{
+		m_value.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	uint64_t Value() const noexcept
+	{
+		return m_value.load(std::memory_order_relaxed);
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Current level of something: queue depth, for instance
+//////////////////////////////////////////////////////////////////////////
+class Gauge
+{
+	std::atomic<int64_t> m_value{ 0 };
+
+public:
+	void Set(int64_t value) noexcept
+	{
+		m_value.store(value, std::memory_order_relaxed);
+	}
+
+	void Add(int64_t delta) noexcept
+	{
+		m_value.fetch_add(delta, std::memory_order_relaxed);
+	}
+
+	int64_t Value() const noexcept
+	{
+		return m_value.load(std::memory_order_relaxed);
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Distribution of the observed values over the fixed buckets. Observing
+///   takes a couple of relaxed atomic operations, readers may see the sum
+///   and the buckets of slightly different moments.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Histogram
+{
+	const std::vector<double> m_bounds;                 // Upper bounds, ascending
+	std::unique_ptr<std::atomic<uint64_t>[]> m_buckets; // The last one is +Inf
+	std::atomic<double> m_sum{ 0 };
+
+public:
+	explicit Histogram(std::vector<double> bounds);
+
+	void Observe(double value) noexcept;
+
+	template<typename Rep, typename Period>
+	void Observe(std::chrono::duration<Rep, Period> duration) noexcept
+	{
+		Observe(std::chrono::duration<double>(duration).count());
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Append the samples of the histogram in the text format
+	//////////////////////////////////////////////////////////////////////////
+	void Render(std::string& out, const std::string& name, const std::string& labels) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Registry of the metrics of the process. The metrics are registered
+///   once, usually into function-local statics, and updated without any
+///   locks afterwards; rendering takes the registry lock only.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Metrics
+{
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+
+	Metrics();
+	~Metrics();
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// The registry is never destroyed: metrics are updated until the very
+	/// end of the process, by the static destructors as well
+	//////////////////////////////////////////////////////////////////////////
+	static Metrics& GetInstance();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Register the metric or get the registered one with the same name
+	///   and labels
+	/// </summary>
+	///
+	/// <param name="name"> Metric name, e.g. kvasir_serial_commands_total </param>
+	/// <param name="help"> Description of the metric family </param>
+	/// <param name="labels"> Label pairs without braces: kind="timeout" </param>
+	//////////////////////////////////////////////////////////////////////////
+	Counter& AddCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+	Gauge& AddGauge(const std::string& name, const std::string& help, const std::string& labels = "");
+	Histogram& AddHistogram(const std::string& name, const std::string& help,
+		const std::vector<double>& bounds, const std::string& labels = "");
+
+	//////////////////////////////////////////////////////////////////////////
+	/// All the metrics in the Prometheus text exposition format
+	//////////////////////////////////////////////////////////////////////////
+	std::string Render() const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Bucket bounds for the latencies from 100 us to 10 s, seconds
+//////////////////////////////////////////////////////////////////////////
+const std::vector<double>& LatencyBuckets();
+
+} // namespace kvasir
+
+#endif // KVASIR_METRICS_H_INCLUDED
@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: metrics_server.cpp
+///
+/// summary: HTTP endpoint serving the metrics to Prometheus
+//////////////////////////////////////////////////////////////////////////
+
+#include "metrics_server.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+#include <stdexcept>
+
+namespace kvasir
+{
+
+namespace
+{
+
+// Requests are tiny: anything longer is not a scrape
+constexpr qint64 MaxRequestSize = 8 * 1024;
+
+//////////////////////////////////////////////////////////////////////////
+std::string MakeResponse(const std::string& status, const std::string& contentType, const std::string& body)
+{
+	return "HTTP/1.1 " + status + "\r\n"
+		"Content-Type: " + contentType + "\r\n"
+		"Content-Length: " + std::to_string(body.size()) + "\r\n"
+		"Connection: close\r\n\r\n" + body;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+struct MetricsServer::Impl
+{
+	QTcpServer server;
+
+	void Accept()
+	{
+		while (QTcpSocket* socket = server.nextPendingConnection())
+		{
+			QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+			QObject::connect(socket, &QTcpSocket::readyRead, [socket] { Serve(socket); });
+		}
+	}
+
+	static void Serve(QTcpSocket* socket)
+	{
+		// Wait for the whole header, the body of GET is empty
+		const QByteArray request = socket->peek(MaxRequestSize);
+		const int headerEnd = request.indexOf("\r\n\r\n");
+		if (headerEnd < 0 && request.size() < MaxRequestSize)
+			return;
+		socket->readAll();
+
+		const QByteArray requestLine = request.left(request.indexOf("\r\n"));
+		std::string response;
+		if (requestLine.startsWith("GET /metrics ") || requestLine.startsWith("GET /metrics?"))
+		{
+			response = MakeResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8",
+				Metrics::GetInstance().Render());
+		}
+		else
+		{
+			KVASIR_LOG(DEBUG) << "metrics request is rejected: " << requestLine.toStdString();
+			response = MakeResponse("404 Not Found", "text/plain", "not found\n");
+		}
+
+		socket->write(response.data(), static_cast<qint64>(response.size()));
+		socket->disconnectFromHost();
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+MetricsServer::MetricsServer(uint16_t port, const std::string& address)
+	: m_impl(std::make_unique<Impl>())
+{
+	QObject::connect(&m_impl->server, &QTcpServer::newConnection, [this] { m_impl->Accept(); });
+	if (!m_impl->server.listen(QHostAddress(QString::fromStdString(address)), port))
+	{
+		throw std::runtime_error("failed to serve metrics at " + address + ':' + std::to_string(port) +
+			": " + m_impl->server.errorString().toStdString());
+	}
+	Logger::GetInstance().Info() << "serving metrics at http://" << address << ':' << port << "/metrics";
+}
+
+//////////////////////////////////////////////////////////////////////////
+MetricsServer::~MetricsServer() = default;
+
+} // namespace kvasir
@@ -0,0 +1,40 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: metrics_server.h
+///
+/// summary: HTTP endpoint serving the metrics to Prometheus
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_METRICS_SERVER_H_INCLUDED
+#define KVASIR_METRICS_SERVER_H_INCLUDED
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Minimal HTTP server answering GET /metrics with the rendered metrics
+///   registry. Runs in the event loop of the thread it was created in;
+///   scraping reads the atomic values and never stops the radio threads.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class MetricsServer
+{
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// <param name="port"> TCP port to listen on </param>
+	/// <param name="address"> Address to bind, the local host by default </param>
+	//////////////////////////////////////////////////////////////////////////
+	explicit MetricsServer(uint16_t port, const std::string& address = "127.0.0.1");
+	~MetricsServer();
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_METRICS_SERVER_H_INCLUDED
@@ -0,0 +1,148 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: monitor.cpp
+///
+/// summary: periodic polling of the scanner's reception status
+//////////////////////////////////////////////////////////////////////////
+
+#include "monitor.h"
+#include "scanner.h"
+#include "scan_settings.h"
+#include "metrics.h"
+#include "logger.h"
+#include "timebase.h"
+
+#include <QtCore/QTimer>
+
+#include <vector>
+
+namespace kvasir
+{
+
+// Polls the radio fails to answer in a row before it's given up as gone:
+// switched off or rebooting behind an adapter which is still plugged in
+constexpr unsigned int MaxFailedPolls = 3;
+
+//////////////////////////////////////////////////////////////////////////
+struct Monitor::Impl
+{
+	const Scanner& scanner;
+	const ScanSettingsStore& scanSettings;
+	QTimer timer;
+	std::vector<Listener> listeners;
+	std::function<void()> disconnectHandler;
+	Timestamp lastPoll;
+
+	Counter& polls = Metrics::GetInstance().AddCounter("kvasir_monitor_polls_total",
+		"Reception status polls.");
+	Counter& pollErrors = Metrics::GetInstance().AddCounter("kvasir_monitor_poll_errors_total",
+		"Failed reception status polls.");
+	Counter& disconnects = Metrics::GetInstance().AddCounter("kvasir_monitor_disconnects_total",
+		"Links to the radio lost while polling.");
+	Histogram& pollGap = Metrics::GetInstance().AddHistogram("kvasir_monitor_poll_gap_seconds",
+		"Time between the starts of consecutive polls.", LatencyBuckets());
+
+	bool polling = false;
+	unsigned int failedPolls = 0;           // Transactions failed in a row
+
+	Impl(const Scanner& scanner, const ScanSettingsStore& scanSettings)
+		: scanner(scanner)
+		, scanSettings(scanSettings)
+	{}
+
+	~Impl()
+	{
+		// The reply handler refers to the timer
+		timer.stop();
+		scanner.Sync();
+	}
+
+	void Poll()
+	{
+		// A slow link must not pile the polls up in the scanner's queue
+		if (polling)
+			return;
+
+		const Timestamp now = Clock::now();
+		if (lastPoll != Timestamp())
+			pollGap.Observe(now - lastPoll);
+		lastPoll = now;
+		polls.Increment();
+
+		// The reply is decoded back on this thread, the I/O thread is free
+		// for the next command meanwhile
+		polling = true;
+		scanner.Post("GLG\r", [this](RawReply reply, std::exception_ptr error) {
+			QMetaObject::invokeMethod(&timer, [this, reply = std::move(reply), error] {
+				polling = false;
+				Complete(reply, error);
+			}, Qt::QueuedConnection);
+		}, CommandPriority::Monitoring);
+	}
+
+	void Complete(const RawReply& reply, std::exception_ptr error)
+	{
+		// A reply the radio refuses still tells it's there
+		failedPolls = error ? failedPolls + 1 : 0;
+		try
+		{
+			if (error)
+				std::rethrow_exception(error);
+
+			const ReceptionStatus status = Scanner::DecodeReceptionStatus(reply, *scanSettings.Current());
+			for (const auto& listener : listeners)
+				listener(status);
+		}
+		catch (const std::exception& e)
+		{
+			Logger::GetInstance().Error() << "failed to poll reception status: " << e.what();
+			pollErrors.Increment();
+			if (!scanner.IsConnected() || failedPolls >= MaxFailedPolls)
+			{
+				failedPolls = 0;
+				disconnects.Increment();
+				timer.stop();
+				if (disconnectHandler)
+					disconnectHandler();
+			}
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+Monitor::Monitor(const Scanner& scanner, const ScanSettingsStore& scanSettings, std::chrono::milliseconds interval)
+	: m_impl(std::make_unique<Impl>(scanner, scanSettings))
+{
+	m_impl->timer.setInterval(static_cast<int>(interval.count()));
+	QObject::connect(&m_impl->timer, &QTimer::timeout, [this] { m_impl->Poll(); });
+}
+
+//////////////////////////////////////////////////////////////////////////
+Monitor::~Monitor() = default;
+
+//////////////////////////////////////////////////////////////////////////
+void Monitor::AddListener(Listener listener)
+{
+	m_impl->listeners.emplace_back(std::move(listener));
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Monitor::SetDisconnectHandler(std::function<void()> handler)
+{
+	m_impl->disconnectHandler = std::move(handler);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Monitor::Start()
+{
+	KVASIR_LOG(DEBUG) << "start polling every " << m_impl->timer.interval() << " ms";
+	m_impl->lastPoll = Timestamp();
+	m_impl->timer.start();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Monitor::Stop()
+{
+	m_impl->timer.stop();
+}
+
+} // namespace kvasir
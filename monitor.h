@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: monitor.h
+///
+/// summary: periodic polling of the scanner's reception status
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_MONITOR_H_INCLUDED
+#define KVASIR_MONITOR_H_INCLUDED
+
+#include "uniden.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace kvasir
+{
+
+class Scanner;
+class ScanSettingsStore;
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Polls the scanner with GLG command from the event loop of the thread
+///   it was started in and passes every decoded status to the listeners
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Monitor
+{
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	using Listener = std::function<void(const ReceptionStatus&)>;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Talk group IDs are decoded in the formats of the systems as the
+	///   settings published last have them
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	Monitor(const Scanner& scanner, const ScanSettingsStore& scanSettings, std::chrono::milliseconds interval);
+	~Monitor();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Listeners are called on the polling thread and must not block
+	//////////////////////////////////////////////////////////////////////////
+	void AddListener(Listener listener);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Called once the link to the scanner is lost or the radio has not
+	///   answered several polls in a row, polling stops then
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void SetDisconnectHandler(std::function<void()> handler);
+
+	void Start();
+	void Stop();
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_MONITOR_H_INCLUDED
@@ -0,0 +1,466 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: name_index.cpp
+///
+/// summary: search of the programmed names as they are typed
+//////////////////////////////////////////////////////////////////////////
+
+#include "name_index.h"
+#include "scan_settings.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <variant>
+
+namespace kvasir
+{
+
+namespace
+{
+
+// Removed names kept in the entries and the postings before any sweeping
+constexpr size_t CompactionMinimum = 1024;
+
+//////////////////////////////////////////////////////////////////////////
+/// Upper case letters and digits, anything else separates the words
+//////////////////////////////////////////////////////////////////////////
+char Fold(char c) noexcept
+{
+	if (c >= 'a' && c <= 'z')
+		return static_cast<char>(c - 'a' + 'A');
+	if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+		return c;
+	return ' ';
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// The folded text, each word preceded by a space
+//////////////////////////////////////////////////////////////////////////
+std::string Folded(std::string_view text)
+{
+	std::string result(text.size() + 1, ' ');
+	std::transform(text.cbegin(), text.cend(), result.begin() + 1, Fold);
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint32_t Key(char a, char b, char c) noexcept
+{
+	return uint32_t(uint8_t(a)) << 16 | uint32_t(uint8_t(b)) << 8 | uint8_t(c);
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Keys of the beginnings of the words: the trigrams from the space
+///   before each word to its end, and the space with the first letter
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+template<typename Visitor>
+void ForEachKey(const std::string& folded, Visitor&& visit)
+{
+	for (size_t i = 0; i + 1 < folded.size(); ++i)
+	{
+		if (folded[i + 1] == ' ')
+			continue;
+		if (folded[i] == ' ')
+			visit(Key(' ', folded[i + 1], '\0'));
+		if (i + 2 < folded.size() && folded[i + 2] != ' ')
+			visit(Key(folded[i], folded[i + 1], folded[i + 2]));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Position of the name's word beginning with the folded word (which
+///   starts with a space), npos if none does
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+size_t FindWord(std::string_view name, std::string_view word) noexcept
+{
+	const size_t length = word.size() - 1;
+	char previous = ' ';
+	for (size_t i = 0; i + length <= name.size(); ++i)
+	{
+		const char current = Fold(name[i]);
+		if (previous == ' ' && current == word[1])
+		{
+			size_t k = 1;
+			while (k < length && Fold(name[i + k]) == word[k + 1])
+				++k;
+			if (k == length)
+				return i;
+		}
+		previous = current;
+	}
+	return std::string_view::npos;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Sorted IDs of the names having a key, as the varint encoded gaps
+///   between them: most gaps take a byte instead of four
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+struct Posting
+{
+	std::vector<uint8_t> gaps;
+	uint32_t last = 0;
+	uint32_t count = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// The ID must be above the last one
+//////////////////////////////////////////////////////////////////////////
+void Append(Posting& posting, uint32_t id)
+{
+	uint32_t gap = posting.count ? id - posting.last : id;
+	while (gap >= 0x80)
+	{
+		posting.gaps.push_back(static_cast<uint8_t>(gap | 0x80));
+		gap >>= 7;
+	}
+	posting.gaps.push_back(static_cast<uint8_t>(gap));
+	posting.last = id;
+	++posting.count;
+}
+
+//////////////////////////////////////////////////////////////////////////
+template<typename Visitor>
+void ForEachId(const Posting& posting, Visitor&& visit)
+{
+	uint32_t id = 0;
+	uint32_t gap = 0;
+	unsigned int shift = 0;
+	for (const uint8_t byte : posting.gaps)
+	{
+		gap |= uint32_t(byte & 0x7F) << shift;
+		shift += 7;
+		if (byte & 0x80)
+			continue;
+		id += gap;
+		visit(id);
+		gap = 0;
+		shift = 0;
+	}
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+struct NameIndex::Impl
+{
+	// The names are kept back to back, removing one leaves a hole until
+	// the next compaction
+	struct Entry
+	{
+		NameRef ref;
+		uint32_t offset;
+		uint16_t length;
+		bool live;
+	};
+
+	std::string names;
+	std::vector<Entry> entries;                                     // By the ID, the IDs only grow
+	std::unordered_map<uint32_t, Posting> postings;
+	std::vector<uint32_t> slots;                                    // Live IDs + 1 by the reference hash, 0 if free
+	size_t live = 0;
+	size_t removed = 0;
+
+	static size_t Hash(const NameRef& ref) noexcept
+	{
+		uint64_t hash = static_cast<uint64_t>(ref.kind);
+		for (const int field : { ref.system, ref.group, ref.channel })
+			hash = (hash ^ static_cast<uint32_t>(field)) * 0x9E3779B97F4A7C15ull;
+		return static_cast<size_t>(hash ^ hash >> 32);
+	}
+
+	// Slot of the reference's ID, or the free one where it would go
+	size_t Probe(const NameRef& ref) const noexcept
+	{
+		const size_t mask = slots.size() - 1;
+		size_t slot = Hash(ref) & mask;
+		while (slots[slot] && !(entries[slots[slot] - 1].ref == ref))
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	bool Lookup(const NameRef& ref, size_t& slot) const noexcept
+	{
+		if (slots.empty())
+			return false;
+		slot = Probe(ref);
+		return slots[slot] != 0;
+	}
+
+	void Place(uint32_t id)
+	{
+		// At most half full, the probes stay short
+		if ((live + 1) * 2 > slots.size())
+		{
+			std::vector<uint32_t> previous(std::max<size_t>(slots.size() * 2, 16));
+			previous.swap(slots);
+			for (const uint32_t value : previous)
+			{
+				if (value)
+					slots[Probe(entries[value - 1].ref)] = value;
+			}
+		}
+		slots[Probe(entries[id].ref)] = id + 1;
+		++live;
+	}
+
+	// Free the slot, moving back the IDs which probed past it
+	void Vacate(size_t slot) noexcept
+	{
+		const size_t mask = slots.size() - 1;
+		slots[slot] = 0;
+		for (size_t next = (slot + 1) & mask; slots[next]; next = (next + 1) & mask)
+		{
+			const size_t home = Hash(entries[slots[next] - 1].ref) & mask;
+			if (((next - home) & mask) >= ((next - slot) & mask))
+			{
+				slots[slot] = slots[next];
+				slots[next] = 0;
+				slot = next;
+			}
+		}
+		--live;
+	}
+
+	std::string_view Name(const Entry& entry) const noexcept
+	{
+		return std::string_view(names).substr(entry.offset, entry.length);
+	}
+
+	uint32_t Insert(const NameRef& ref, std::string_view name)
+	{
+		// Alpha tags are 16 characters, nothing comes near the limit of the length
+		name = name.substr(0, std::numeric_limits<uint16_t>::max());
+		const uint32_t id = static_cast<uint32_t>(entries.size());
+		entries.push_back(Entry{ ref, static_cast<uint32_t>(names.size()), static_cast<uint16_t>(name.size()), true });
+		names.append(name.data(), name.size());
+		ForEachKey(Folded(name), [this, id](uint32_t key) {
+			Posting& posting = postings[key];
+			if (!posting.count || posting.last != id)
+				Append(posting, id);
+		});
+		return id;
+	}
+
+	// The ID stays in the postings until the compaction, the queries skip it
+	void Erase(uint32_t id) noexcept
+	{
+		entries[id].live = false;
+		++removed;
+	}
+
+	// Sweep the removed names out once they are the majority
+	void Compact()
+	{
+		if (removed < CompactionMinimum || removed * 2 <= entries.size())
+			return;
+
+		const std::string previousNames = std::move(names);
+		const std::vector<Entry> previousEntries = std::move(entries);
+		names.clear();
+		entries.clear();
+		postings.clear();
+		slots.clear();
+		live = 0;
+		removed = 0;
+		for (const Entry& entry : previousEntries)
+		{
+			if (entry.live)
+				Place(Insert(entry.ref, std::string_view(previousNames).substr(entry.offset, entry.length)));
+		}
+	}
+
+	// Free the room reserved for the growth after a bulk update
+	void Trim()
+	{
+		names.shrink_to_fit();
+		entries.shrink_to_fit();
+		for (auto& posting : postings)
+			posting.second.gaps.shrink_to_fit();
+	}
+
+	// IDs of the names which may match: every key of the query is in them
+	std::vector<uint32_t> Candidates(const std::string& folded) const
+	{
+		std::vector<const Posting*> lists;
+		bool missing = false;
+		ForEachKey(folded, [this, &lists, &missing](uint32_t key) {
+			const auto found = postings.find(key);
+			if (found == postings.end())
+				missing = true;
+			else
+				lists.push_back(&found->second);
+		});
+		if (missing || lists.empty())
+			return {};
+
+		// From the rarest key, the candidates only get fewer
+		std::sort(lists.begin(), lists.end(),
+			[](const Posting* lhs, const Posting* rhs) { return lhs->count < rhs->count; });
+		lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+		std::vector<uint32_t> result;
+		result.reserve(lists.front()->count);
+		ForEachId(*lists.front(), [&result](uint32_t id) { result.push_back(id); });
+		for (auto list = lists.cbegin() + 1; list != lists.cend() && !result.empty(); ++list)
+		{
+			// Both are sorted: one pass over each
+			size_t kept = 0;
+			size_t next = 0;
+			ForEachId(**list, [&result, &kept, &next](uint32_t id) {
+				while (next < result.size() && result[next] < id)
+					++next;
+				if (next < result.size() && result[next] == id)
+					result[kept++] = result[next++];
+			});
+			result.resize(kept);
+		}
+		return result;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+NameIndex::NameIndex()
+	: m_impl(std::make_unique<Impl>())
+{}
+
+//////////////////////////////////////////////////////////////////////////
+NameIndex::~NameIndex() = default;
+
+//////////////////////////////////////////////////////////////////////////
+void NameIndex::Add(const NameRef& ref, std::string_view name)
+{
+	size_t slot;
+	if (m_impl->Lookup(ref, slot))
+	{
+		const uint32_t previous = m_impl->slots[slot] - 1;
+		if (m_impl->Name(m_impl->entries[previous]) == name)
+			return;
+		m_impl->Erase(previous);
+		m_impl->slots[slot] = m_impl->Insert(ref, name) + 1;
+	}
+	else
+	{
+		m_impl->Place(m_impl->Insert(ref, name));
+	}
+	m_impl->Compact();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void NameIndex::Remove(const NameRef& ref)
+{
+	size_t slot;
+	if (!m_impl->Lookup(ref, slot))
+		return;
+
+	m_impl->Erase(m_impl->slots[slot] - 1);
+	m_impl->Vacate(slot);
+	m_impl->Compact();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void NameIndex::Update(const ScanSettings& settings)
+{
+	// Only the systems are named in the settings so far
+	const auto& systems = settings.Systems();
+	const int count = static_cast<int>(systems.size());
+	for (int i = 0; i < count; ++i)
+	{
+		std::visit([this, i](auto&& system) {
+			Add(NameRef{ NameKind::System, i }, system.Name());
+		}, systems[static_cast<size_t>(i)]);
+	}
+
+	// Whatever belonged to the systems which are gone
+	std::vector<NameRef> gone;
+	for (const Impl::Entry& entry : m_impl->entries)
+	{
+		if (entry.live && entry.ref.system >= count)
+			gone.push_back(entry.ref);
+	}
+	for (const NameRef& ref : gone)
+		Remove(ref);
+	m_impl->Trim();
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::vector<NameMatch> NameIndex::Find(std::string_view query, size_t limit) const
+{
+	const std::string folded = Folded(query);
+	std::vector<std::string> words;
+	for (size_t begin = folded.find_first_not_of(' '); begin != std::string::npos;
+		begin = folded.find_first_not_of(' ', begin))
+	{
+		const size_t end = std::min(folded.find(' ', begin), folded.size());
+		words.push_back(folded.substr(begin - 1, end - begin + 1));
+		begin = end;
+	}
+	if (words.empty() || !limit)
+		return {};
+
+	// The keys only tell the words' letters are there: check the order
+	struct Ranked
+	{
+		bool prefix;
+		size_t length;
+		uint32_t id;
+
+		bool operator<(const Ranked& other) const noexcept
+		{
+			if (prefix != other.prefix)
+				return prefix;
+			return std::tie(length, id) < std::tie(other.length, other.id);
+		}
+	};
+	std::vector<Ranked> ranked;
+	for (const uint32_t id : m_impl->Candidates(folded))
+	{
+		if (!m_impl->entries[id].live)
+			continue;
+
+		const std::string_view name = m_impl->Name(m_impl->entries[id]);
+		if (std::all_of(words.cbegin() + 1, words.cend(),
+			[name](const std::string& word) { return FindWord(name, word) != std::string_view::npos; }))
+		{
+			const size_t first = FindWord(name, words.front());
+			if (first != std::string_view::npos)
+				ranked.push_back(Ranked{ first == 0, name.size(), id });
+		}
+	}
+
+	const size_t size = std::min(limit, ranked.size());
+	std::partial_sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(size), ranked.end());
+	std::vector<NameMatch> result;
+	result.reserve(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		const Impl::Entry& entry = m_impl->entries[ranked[i].id];
+		result.push_back(NameMatch{ entry.ref, std::string(m_impl->Name(entry)) });
+	}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+size_t NameIndex::Size() const noexcept
+{
+	return m_impl->live;
+}
+
+//////////////////////////////////////////////////////////////////////////
+size_t NameIndex::MemoryUsage() const noexcept
+{
+	size_t result = m_impl->names.capacity() + m_impl->entries.capacity() * sizeof(Impl::Entry);
+
+	// The hash nodes hold the key, the posting and the link to the next
+	result += m_impl->postings.bucket_count() * sizeof(void*);
+	for (const auto& posting : m_impl->postings)
+		result += sizeof(posting) + sizeof(void*) + posting.second.gaps.capacity();
+	result += m_impl->slots.capacity() * sizeof(uint32_t);
+	return result;
+}
+
+} // namespace kvasir
@@ -0,0 +1,115 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: name_index.h
+///
+/// summary: search of the programmed names as they are typed
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_NAME_INDEX_H_INCLUDED
+#define KVASIR_NAME_INDEX_H_INCLUDED
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace kvasir
+{
+
+class ScanSettings;
+
+//////////////////////////////////////////////////////////////////////////
+enum class NameKind : uint8_t
+{
+	System,
+	Group,
+	Channel
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Object bearing a name, by its position in the scan settings
+//////////////////////////////////////////////////////////////////////////
+struct NameRef
+{
+	NameKind kind = NameKind::System;
+	int system = -1;
+	int group = -1;                         // -1 for a system
+	int channel = -1;                       // -1 for a system or a group
+
+	bool operator<(const NameRef& other) const noexcept
+	{
+		return std::tie(kind, system, group, channel) <
+			std::tie(other.kind, other.system, other.group, other.channel);
+	}
+
+	bool operator==(const NameRef& other) const noexcept
+	{
+		return !(*this < other) && !(other < *this);
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+struct NameMatch
+{
+	NameRef ref;
+	std::string name;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Trigram index of the alpha tags. Each word of a query matches the
+///   beginning of a word of the name, in any case and order: "fire disp"
+///   finds "CITY FIRE DISPATCH", "tac 3" finds "FIRE TAC 3". The words are
+///   looked up by the trigrams of their beginning (the bigram for a single
+///   letter), so a query reads a few posting lists instead of every name.
+///
+///   Not thread-safe: the index belongs to the thread which searches, and
+///   it follows the published settings with Update().
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class NameIndex
+{
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	NameIndex();
+	~NameIndex();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Index the name of the object, replacing the one it had
+	//////////////////////////////////////////////////////////////////////////
+	void Add(const NameRef& ref, std::string_view name);
+
+	void Remove(const NameRef& ref);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Bring the index in line with the settings: only the names which
+	///   appeared, disappeared or changed since the last update are touched
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void Update(const ScanSettings& settings);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Names matching all the words of the query: the ones starting with
+	///   the query first, then the shortest
+	/// </summary>
+	///
+	/// <param name="limit"> Maximum number of matches returned </param>
+	//////////////////////////////////////////////////////////////////////////
+	std::vector<NameMatch> Find(std::string_view query, size_t limit = 20) const;
+
+	size_t Size() const noexcept;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Bytes allocated for the names and the posting lists, approximately
+	//////////////////////////////////////////////////////////////////////////
+	size_t MemoryUsage() const noexcept;
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_NAME_INDEX_H_INCLUDED
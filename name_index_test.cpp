@@ -0,0 +1,206 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: name_index_test.cpp
+///
+/// summary: search of the name index against the brute force one
+//////////////////////////////////////////////////////////////////////////
+
+#include "name_index.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace
+{
+
+int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////
+void Check(bool condition, const std::string& what)
+{
+	if (condition)
+		return;
+	std::cerr << "FAILED: " << what << std::endl;
+	++failures;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Words of the text in upper case, split on anything but letters and digits
+//////////////////////////////////////////////////////////////////////////
+std::vector<std::string> Words(const std::string& text)
+{
+	std::vector<std::string> result;
+	std::string word;
+	for (const char c : text + ' ')
+	{
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+		{
+			word += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+		}
+		else if (!word.empty())
+		{
+			result.push_back(word);
+			word.clear();
+		}
+	}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool StartsWith(const std::string& word, const std::string& prefix)
+{
+	return word.compare(0, prefix.size(), prefix) == 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Every word of the query begins a word of the name
+//////////////////////////////////////////////////////////////////////////
+bool Matches(const std::string& name, const std::vector<std::string>& query)
+{
+	const std::vector<std::string> words = Words(name);
+	return std::all_of(query.cbegin(), query.cend(), [&words](const std::string& part) {
+		return std::any_of(words.cbegin(), words.cend(),
+			[&part](const std::string& word) { return StartsWith(word, part); });
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string RandomName(std::mt19937& random)
+{
+	static const char* const words[] = { "fire", "Fire", "FIREGROUND", "police", "PD", "ems", "Tac", "TAC2",
+		"dispatch", "Disp", "county", "city", "north", "ops", "1", "12", "123", "a", "ab" };
+	static const char separators[] = { ' ', ' ', '-', '/', '.', '_' };
+
+	std::string name;
+	const int count = std::uniform_int_distribution<int>(1, 4)(random);
+	for (int i = 0; i < count; ++i)
+	{
+		if (i)
+			name += separators[random() % sizeof(separators)];
+		name += words[random() % (sizeof(words) / sizeof(words[0]))];
+	}
+	return name;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string RandomQuery(std::mt19937& random)
+{
+	static const char* const parts[] = { "f", "fi", "FIRE", "fireg", "p", "po", "pd", "e", "ems", "t", "tac",
+		"tac2", "d", "dis", "disp", "c", "co", "ci", "n", "o", "1", "12", "123", "1234", "a", "ab", "x", "" };
+
+	std::string query;
+	const int count = std::uniform_int_distribution<int>(1, 3)(random);
+	for (int i = 0; i < count; ++i)
+	{
+		if (i)
+			query += random() % 2 ? " " : " - ";
+		query += parts[random() % (sizeof(parts) / sizeof(parts[0]))];
+	}
+	return query;
+}
+
+//////////////////////////////////////////////////////////////////////////
+kvasir::NameRef RandomRef(std::mt19937& random)
+{
+	const int system = static_cast<int>(random() % 10);
+	switch (random() % 3)
+	{
+	case 0:
+		return kvasir::NameRef{ kvasir::NameKind::System, system };
+	case 1:
+		return kvasir::NameRef{ kvasir::NameKind::Group, system, static_cast<int>(random() % 10) };
+	default:
+		return kvasir::NameRef{ kvasir::NameKind::Channel, system, static_cast<int>(random() % 10),
+			static_cast<int>(random() % 20) };
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Random additions, renames and removals over a couple thousand
+///   references, enough to go through the growth of the slot table and
+///   the compactions, with the queries checked against a scan of all the
+///   names
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+void TestAgainstBruteForce()
+{
+	std::mt19937 random(7);
+	kvasir::NameIndex index;
+	std::map<kvasir::NameRef, std::string> names;
+	size_t memory = 0;
+	bool compacted = false;
+
+	for (int step = 0; step < 30000; ++step)
+	{
+		const kvasir::NameRef ref = RandomRef(random);
+		if (random() % 3)
+		{
+			const std::string name = RandomName(random);
+			index.Add(ref, name);
+			names[ref] = name;
+		}
+		else
+		{
+			index.Remove(ref);
+			names.erase(ref);
+		}
+		compacted = compacted || index.MemoryUsage() < memory;
+		memory = index.MemoryUsage();
+
+		if (step % 50)
+			continue;
+		Check(index.Size() == names.size(), "size after step " + std::to_string(step));
+
+		const std::string query = RandomQuery(random);
+		const std::vector<std::string> parts = Words(query);
+		std::vector<kvasir::NameRef> expected;
+		for (const auto& entry : names)
+		{
+			if (!parts.empty() && Matches(entry.second, parts))
+				expected.push_back(entry.first);
+		}
+
+		const std::vector<kvasir::NameMatch> found = index.Find(query, names.size() + 1);
+		std::vector<kvasir::NameRef> actual;
+		bool ranked = true;
+		for (size_t i = 0; i < found.size(); ++i)
+		{
+			actual.push_back(found[i].ref);
+			const auto known = names.find(found[i].ref);
+			Check(known != names.end() && known->second == found[i].name, "current name of a match of \"" + query + '"');
+
+			// The names starting with the query first, then the shortest
+			if (i)
+			{
+				const bool previous = StartsWith(Words(found[i - 1].name).front(), parts.front());
+				const bool current = StartsWith(Words(found[i].name).front(), parts.front());
+				ranked = ranked && (previous != current ? previous :
+					found[i - 1].name.size() <= found[i].name.size());
+			}
+		}
+		std::sort(actual.begin(), actual.end());
+		Check(actual == expected, "matches of \"" + query + "\" after step " + std::to_string(step));
+		Check(ranked, "order of the matches of \"" + query + '"');
+
+		const size_t limit = 3;
+		Check(index.Find(query, limit).size() == std::min(limit, expected.size()), "limit of \"" + query + '"');
+	}
+	Check(compacted, "compaction of the removed names");
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+int main()
+{
+	TestAgainstBruteForce();
+
+	if (failures)
+		std::cerr << failures << " checks failed" << std::endl;
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
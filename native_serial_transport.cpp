@@ -0,0 +1,268 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: native_serial_transport.cpp
+///
+/// summary: link to the radio over the tty device, without Qt
+//////////////////////////////////////////////////////////////////////////
+
+#include "native_serial_transport.h"
+#include "config.h"
+#include "logger.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <string>
+
+#include <linux/serial.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace kvasir
+{
+
+namespace
+{
+
+// Write of a command blocked for longer than this means the port is stuck
+constexpr int WriteTimeout = 1000;          // ms
+
+//////////////////////////////////////////////////////////////////////////
+std::runtime_error SystemError(const std::string& what)
+{
+	return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+//////////////////////////////////////////////////////////////////////////
+speed_t ToSpeed(const unsigned int baudRate)
+{
+	switch (baudRate)
+	{
+	case 1200:
+		return B1200;
+	case 2400:
+		return B2400;
+	case 4800:
+		return B4800;
+	case 9600:
+		return B9600;
+	case 19200:
+		return B19200;
+	case 38400:
+		return B38400;
+	case 57600:
+		return B57600;
+	case 115200:
+		return B115200;
+	case 230400:
+		return B230400;
+	case 460800:
+		return B460800;
+	case 921600:
+		return B921600;
+	default:
+		throw std::runtime_error("unsupported baud rate: " + std::to_string(baudRate));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+tcflag_t ToCharacterSize(const unsigned int bits)
+{
+	switch (bits)
+	{
+	case 8:
+		return CS8;
+	case 7:
+		return CS7;
+	case 6:
+		return CS6;
+	case 5:
+		return CS5;
+	default:
+		throw std::logic_error("invalid number of data bits: " + std::to_string(bits));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   The chip of the USB adapter holds the bytes back for its latency
+///   timer unless the port is low latency. Ports of other kinds don't
+///   have the setting (pseudo-terminals, some drivers): they are left as
+///   they are.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+void SetLowLatency(int fd, const std::string& path)
+{
+	serial_struct serial;
+	if (::ioctl(fd, TIOCGSERIAL, &serial) < 0)
+	{
+		KVASIR_LOG(DEBUG) << "no low latency mode for " << path << ": " << std::strerror(errno);
+		return;
+	}
+	if (serial.flags & ASYNC_LOW_LATENCY)
+		return;
+
+	serial.flags |= ASYNC_LOW_LATENCY;
+	if (::ioctl(fd, TIOCSSERIAL, &serial) < 0)
+	{
+		KVASIR_LOG(DEBUG) << "failed to set low latency mode for " << path << ": " << std::strerror(errno);
+	}
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+NativeSerialTransport::NativeSerialTransport(const Device& device)
+{
+	const std::string path = device.port.find('/') == std::string::npos ? "/dev/" + device.port : device.port;
+
+	try
+	{
+		m_fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+		if (m_fd < 0)
+			throw SystemError("failed to open " + path);
+		if (::ioctl(m_fd, TIOCEXCL) < 0)
+			throw SystemError("failed to lock " + path);
+		if (::tcgetattr(m_fd, &m_saved) < 0)
+			throw SystemError("failed to read the settings of " + path);
+
+		// Raw bytes with no flow control. The reads never block, epoll waits
+		// for the first byte: VMIN 1 and VTIME 0 hand every byte over as soon
+		// as it's in, with no inter-byte timer
+		termios settings = m_saved;
+		::cfmakeraw(&settings);
+		settings.c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD | CRTSCTS);
+		settings.c_cflag |= ToCharacterSize(device.dataBits) | CLOCAL | CREAD;
+		if (device.stopBits == 2)
+			settings.c_cflag |= CSTOPB;
+		else if (device.stopBits != 1)
+			throw std::logic_error("invalid number of stop bits: " + std::to_string(device.stopBits));
+		if (device.parityCheck)
+			settings.c_cflag |= PARENB;
+		settings.c_cc[VMIN] = 1;
+		settings.c_cc[VTIME] = 0;
+		const speed_t speed = ToSpeed(device.baudRate);
+		if (::cfsetispeed(&settings, speed) < 0 || ::cfsetospeed(&settings, speed) < 0 ||
+			::tcsetattr(m_fd, TCSANOW, &settings) < 0)
+			throw SystemError("failed to configure " + path);
+		SetLowLatency(m_fd, path);
+
+		// Whatever the radio sent before the port was opened is stale
+		::tcflush(m_fd, TCIOFLUSH);
+
+		m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+		if (m_epoll < 0)
+			throw SystemError("failed to create epoll");
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.fd = m_fd;
+		if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_fd, &event) < 0)
+			throw SystemError("failed to watch " + path);
+	}
+	catch (...)
+	{
+		if (m_epoll >= 0)
+			::close(m_epoll);
+		if (m_fd >= 0)
+			::close(m_fd);
+		throw;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+NativeSerialTransport::~NativeSerialTransport()
+{
+	Close();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void NativeSerialTransport::Write(const char* data, size_t size)
+{
+	if (m_fd < 0)
+		throw std::runtime_error("failed to write to port: port is closed");
+
+	while (size)
+	{
+		const ssize_t written = ::write(m_fd, data, size);
+		if (written > 0)
+		{
+			data += written;
+			size -= static_cast<size_t>(written);
+			continue;
+		}
+		if (written < 0 && EINTR == errno)
+			continue;
+		if (written < 0 && EAGAIN != errno)
+		{
+			const std::runtime_error error = SystemError("failed to write to port");
+			Close();
+			throw error;
+		}
+
+		// The output buffer is full, a command is short: it drains at once
+		// unless the port is stuck
+		pollfd output{ m_fd, POLLOUT, 0 };
+		const int ready = ::poll(&output, 1, WriteTimeout);
+		if (0 == ready)
+			throw std::runtime_error("failed to write to port: timed out");
+		if (ready < 0 && EINTR != errno)
+			throw SystemError("failed to wait for port");
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+size_t NativeSerialTransport::Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout)
+{
+	if (m_fd < 0)
+		throw std::runtime_error("failed to read from port: port is closed");
+
+	// The rest of a reply is often in already: epoll is only needed when not
+	for (;;)
+	{
+		const ssize_t size = ::read(m_fd, buffer, capacity);
+		if (size > 0)
+			return static_cast<size_t>(size);
+		if (size < 0 && EINTR == errno)
+			continue;
+
+		// End of file on a tty is the device gone (unplugged adapter, closed
+		// pseudo-terminal)
+		if (0 == size || EAGAIN != errno)
+		{
+			const std::runtime_error error = 0 == size ?
+				std::runtime_error("failed to read from port: device is gone") :
+				SystemError("failed to read from port");
+			Close();
+			throw error;
+		}
+
+		epoll_event event;
+		const int count = ::epoll_wait(m_epoll, &event, 1, static_cast<int>(timeout.count()));
+		if (0 == count)
+			return 0;
+		if (count < 0 && EINTR != errno)
+			throw SystemError("failed to wait for port");
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool NativeSerialTransport::IsOpen() const noexcept
+{
+	return m_fd >= 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void NativeSerialTransport::Close()
+{
+	if (m_fd < 0)
+		return;
+
+	::tcsetattr(m_fd, TCSANOW, &m_saved);
+	::close(m_epoll);
+	::close(m_fd);
+	m_epoll = m_fd = -1;
+}
+
+} // namespace kvasir
@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: native_serial_transport.h
+///
+/// summary: link to the radio over the tty device, without Qt
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_NATIVE_SERIAL_TRANSPORT_H_INCLUDED
+#define KVASIR_NATIVE_SERIAL_TRANSPORT_H_INCLUDED
+
+#include "serial_transport.h"
+
+#include <termios.h>
+
+namespace kvasir
+{
+
+// Forward declaration of device settings
+struct Device;
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Link over the tty device of the serial port, Linux only. The port is
+///   raw and the reads wait in epoll, so a reply is handed over as soon as
+///   the driver has it: no event loop nor buffer of QSerialPort in between.
+///   The USB adapters which support it are switched to low latency, which
+///   drops the 16 ms latency timer of the FTDI chips to 1 ms.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class NativeSerialTransport : public SerialTransport
+{
+	int m_fd = -1;
+	int m_epoll = -1;
+	termios m_saved;                        // Settings of the port to restore on close
+
+public:
+	explicit NativeSerialTransport(const Device& device);
+	~NativeSerialTransport();
+
+	NativeSerialTransport(const NativeSerialTransport&) = delete;
+	NativeSerialTransport& operator=(const NativeSerialTransport&) = delete;
+
+	void Write(const char* data, size_t size) override;
+	size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout) override;
+	bool IsOpen() const noexcept override;
+	void Close() override;
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_NATIVE_SERIAL_TRANSPORT_H_INCLUDED
@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: port_watcher.cpp
+///
+/// summary: detection of the radio's serial port coming back
+//////////////////////////////////////////////////////////////////////////
+
+#include "port_watcher.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <QtCore/QTimer>
+#include <QtSerialPort/QSerialPortInfo>
+
+namespace kvasir
+{
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// The port is configured either by its name or by its device path
+//////////////////////////////////////////////////////////////////////////
+bool IsPort(const QSerialPortInfo& info, const std::string& port)
+{
+	return info.portName().toStdString() == port || info.systemLocation().toStdString() == port;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+struct PortWatcher::Impl
+{
+	const std::string port;
+	std::string serialNumber;
+	QTimer timer;
+	Handler handler;
+
+	Counter& attempts = Metrics::GetInstance().AddCounter("kvasir_port_reopen_attempts_total",
+		"Attempts to reopen the lost serial port.");
+	Counter& reopens = Metrics::GetInstance().AddCounter("kvasir_port_reopens_total",
+		"Lost serial ports reopened.");
+
+	explicit Impl(const std::string& port)
+		: port(port)
+	{}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Name the port has now, empty while the device is gone
+	//////////////////////////////////////////////////////////////////////////
+	std::string Find() const
+	{
+		if (serialNumber.empty())
+			return port;
+
+		// The name is given in the same form as the configured one
+		const bool path = port.find('/') != std::string::npos;
+		for (const QSerialPortInfo& info : QSerialPortInfo::availablePorts())
+		{
+			if (info.serialNumber().toStdString() == serialNumber)
+				return (path ? info.systemLocation() : info.portName()).toStdString();
+		}
+		return std::string();
+	}
+
+	void Look()
+	{
+		const std::string found = Find();
+		if (found.empty())
+			return;
+
+		attempts.Increment();
+		if (!handler(found))
+			return;
+
+		reopens.Increment();
+		timer.stop();
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+PortWatcher::PortWatcher(const std::string& port, std::chrono::milliseconds interval)
+	: m_impl(std::make_unique<Impl>(port))
+{
+	for (const QSerialPortInfo& info : QSerialPortInfo::availablePorts())
+	{
+		if (IsPort(info, port))
+		{
+			m_impl->serialNumber = info.serialNumber().toStdString();
+			break;
+		}
+	}
+	KVASIR_LOG(DEBUG) << "port " << port << " is recognized by " <<
+		(m_impl->serialNumber.empty() ? "its name" : "serial number " + m_impl->serialNumber);
+
+	m_impl->timer.setInterval(static_cast<int>(interval.count()));
+	QObject::connect(&m_impl->timer, &QTimer::timeout, [this] { m_impl->Look(); });
+}
+
+//////////////////////////////////////////////////////////////////////////
+PortWatcher::~PortWatcher() = default;
+
+//////////////////////////////////////////////////////////////////////////
+const std::string& PortWatcher::SerialNumber() const noexcept
+{
+	return m_impl->serialNumber;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void PortWatcher::Watch(Handler handler)
+{
+	m_impl->handler = std::move(handler);
+	m_impl->timer.start();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void PortWatcher::Stop()
+{
+	m_impl->timer.stop();
+}
+
+} // namespace kvasir
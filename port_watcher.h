@@ -0,0 +1,65 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: port_watcher.h
+///
+/// summary: detection of the radio's serial port coming back
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_PORT_WATCHER_H_INCLUDED
+#define KVASIR_PORT_WATCHER_H_INCLUDED
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Finds the radio's port again once the device is back: a USB adapter
+///   is recognized by its serial number, whatever name the system gives
+///   it on the next plug. A port without a serial number (built-in port,
+///   pseudo-terminal) is simply tried again under its name. Looks for the
+///   port from the event loop of the thread it was started in.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class PortWatcher
+{
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// Called with the current name of the port, true once it's reopened:
+	/// the looking stops then, Watch() again to resume it
+	//////////////////////////////////////////////////////////////////////////
+	using Handler = std::function<bool(const std::string& port)>;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Remember the serial number of the port, while the device is here
+	/// </summary>
+	///
+	/// <param name="port"> Name of the port as configured </param>
+	/// <param name="interval"> Time between the looks for the port </param>
+	//////////////////////////////////////////////////////////////////////////
+	PortWatcher(const std::string& port, std::chrono::milliseconds interval);
+	~PortWatcher();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Serial number the port is recognized by, empty if it has none
+	//////////////////////////////////////////////////////////////////////////
+	const std::string& SerialNumber() const noexcept;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Look for the port until the handler manages to reopen it
+	//////////////////////////////////////////////////////////////////////////
+	void Watch(Handler handler);
+
+	void Stop();
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_PORT_WATCHER_H_INCLUDED
@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: qt_serial_transport.cpp
+///
+/// summary: link to the radio over the serial port of the computer
+//////////////////////////////////////////////////////////////////////////
+
+#include "qt_serial_transport.h"
+#include "config.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace kvasir
+{
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+QSerialPort::DataBits ToDataBits(const unsigned int bits)
+{
+	switch (bits)
+	{
+	case 8:
+		return QSerialPort::Data8;
+	case 7:
+		return QSerialPort::Data7;
+	case 6:
+		return QSerialPort::Data6;
+	case 5:
+		return QSerialPort::Data5;
+	default:
+		throw std::logic_error("invalid number of data bits: " + std::to_string(bits));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+QSerialPort::StopBits ToStopBits(const unsigned int bits)
+{
+	switch (bits)
+	{
+	case 1:
+		return QSerialPort::OneStop;
+	case 2:
+		return QSerialPort::TwoStop;
+	case 3:
+		return QSerialPort::OneAndHalfStop;
+	default:
+		throw std::logic_error("invalid number of stop bits: " + std::to_string(bits));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+QSerialPort::Parity ToParity(const bool parity)
+{
+	return parity ? QSerialPort::EvenParity : QSerialPort::NoParity;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+QtSerialTransport::QtSerialTransport(const Device& device)
+{
+	m_port.setPortName(QString::fromStdString(device.port));
+	m_port.setBaudRate(device.baudRate);
+	m_port.setDataBits(ToDataBits(device.dataBits));
+	m_port.setStopBits(ToStopBits(device.stopBits));
+	m_port.setParity(ToParity(device.parityCheck));
+	m_port.setFlowControl(QSerialPort::NoFlowControl);
+	if (!m_port.open(QIODevice::ReadWrite))
+	{
+		throw std::runtime_error(m_port.errorString().toStdString());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+QtSerialTransport::~QtSerialTransport()
+{
+	if (m_port.isOpen())
+	{
+		m_port.close();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void QtSerialTransport::Write(const char* data, size_t size)
+{
+	if (m_port.write(data, static_cast<qint64>(size)) != static_cast<qint64>(size))
+		Fail("failed to write to port");
+}
+
+//////////////////////////////////////////////////////////////////////////
+size_t QtSerialTransport::Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout)
+{
+	if (!m_port.bytesAvailable() && !m_port.waitForReadyRead(static_cast<int>(timeout.count())))
+	{
+		// An unplugged device fails the wait rather than times it out
+		if (QSerialPort::ResourceError == m_port.error())
+			Fail("failed to read from port");
+		return 0;
+	}
+
+	const qint64 size = m_port.read(buffer, static_cast<qint64>(capacity));
+	if (size < 0)
+		Fail("failed to read from port");
+	return static_cast<size_t>(size);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void QtSerialTransport::Fail(const std::string& what)
+{
+	const std::string error = what + ": " + m_port.errorString().toStdString();
+
+	// The port stays open after the device is gone, only the error tells
+	if (QSerialPort::ResourceError == m_port.error())
+		m_port.close();
+	throw std::runtime_error(error);
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool QtSerialTransport::IsOpen() const noexcept
+{
+	return m_port.isOpen();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void QtSerialTransport::Close()
+{
+	m_port.close();
+}
+
+} // namespace kvasir
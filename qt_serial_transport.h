@@ -0,0 +1,46 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: qt_serial_transport.h
+///
+/// summary: link to the radio over the serial port of the computer
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_QT_SERIAL_TRANSPORT_H_INCLUDED
+#define KVASIR_QT_SERIAL_TRANSPORT_H_INCLUDED
+
+#include "serial_transport.h"
+
+#include <QtSerialPort/QSerialPort>
+
+#include <string>
+
+namespace kvasir
+{
+
+// Forward declaration of device settings
+struct Device;
+
+//////////////////////////////////////////////////////////////////////////
+/// Link over the serial port of the computer
+//////////////////////////////////////////////////////////////////////////
+class QtSerialTransport : public SerialTransport
+{
+	QSerialPort m_port;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Throw the error of the port, closing it if the device is gone
+	//////////////////////////////////////////////////////////////////////////
+	[[noreturn]] void Fail(const std::string& what);
+
+public:
+	explicit QtSerialTransport(const Device& device);
+	~QtSerialTransport();
+
+	void Write(const char* data, size_t size) override;
+	size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout) override;
+	bool IsOpen() const noexcept override;
+	void Close() override;
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_QT_SERIAL_TRANSPORT_H_INCLUDED
@@ -0,0 +1,96 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: rcu_pointer.h
+///
+/// summary: lock-free publication of immutable snapshots
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_RCU_POINTER_H_INCLUDED
+#define KVASIR_RCU_POINTER_H_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Read-copy-update cell holding the current version of an immutable
+///   object. Readers never lock nor wait for a writer: Load() copies the
+///   shared_ptr of the version published last, and that version lives on
+///   until the last reader drops it, whatever has been published since.
+///   Writers build the next version aside and Store() it; they only wait
+///   for the readers which are in the middle of Load(), a few instructions
+///   at most.
+///
+///   The shared_ptr itself is only read between the two reader counts of
+///   the epoch, so that it is never freed under a reader's copy.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+template<typename T>
+class RcuPointer
+{
+	using Version = std::shared_ptr<const T>;
+
+	std::atomic<Version*> m_current;
+	mutable std::atomic<unsigned int> m_epoch{ 0 };
+	mutable std::atomic<unsigned int> m_readers[2] = {};  // In Load() by the epoch parity
+	std::mutex m_writer;
+
+public:
+	explicit RcuPointer(Version initial = nullptr)
+		: m_current(new Version(std::move(initial)))
+	{}
+
+	~RcuPointer()
+	{
+		delete m_current.load();
+	}
+
+	RcuPointer(const RcuPointer&) = delete;
+	RcuPointer& operator=(const RcuPointer&) = delete;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Version published last, valid for as long as the caller keeps it
+	//////////////////////////////////////////////////////////////////////////
+	Version Load() const noexcept
+	{
+		for (;;)
+		{
+			const unsigned int epoch = m_epoch.load();
+			std::atomic<unsigned int>& readers = m_readers[epoch & 1];
+			readers.fetch_add(1);
+
+			// A writer which has moved on since does not wait for this count
+			if (m_epoch.load() == epoch)
+			{
+				Version result = *m_current.load();
+				readers.fetch_sub(1);
+				return result;
+			}
+			readers.fetch_sub(1);
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Publish the next version, the readers see it from their next Load()
+	//////////////////////////////////////////////////////////////////////////
+	void Store(Version next)
+	{
+		std::lock_guard<std::mutex> lock(m_writer);
+		Version* previous = m_current.exchange(new Version(std::move(next)));
+
+		// Readers arriving from now on count in the other parity and read the
+		// new version: the previous one is freed once this parity drains
+		const unsigned int epoch = m_epoch.fetch_add(1);
+		while (m_readers[epoch & 1].load())
+			std::this_thread::yield();
+		delete previous;
+	}
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_RCU_POINTER_H_INCLUDED
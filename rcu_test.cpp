@@ -0,0 +1,131 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: rcu_test.cpp
+///
+/// summary: stress test of the publication and reclamation of RcuPointer
+//////////////////////////////////////////////////////////////////////////
+
+#include "rcu_pointer.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+namespace
+{
+
+int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////
+void Check(bool condition, const std::string& what)
+{
+	if (condition)
+		return;
+	std::cerr << "FAILED: " << what << std::endl;
+	++failures;
+}
+
+std::atomic<int> live{ 0 };
+
+// Version whose every field holds its number, a torn or freed one shows
+struct Snapshot
+{
+	explicit Snapshot(uint64_t number)
+		: version(number)
+		, values(8, number)
+	{
+		++live;
+	}
+
+	~Snapshot()
+	{
+		version = UINT64_MAX;
+		--live;
+	}
+
+	Snapshot(const Snapshot&) = delete;
+	Snapshot& operator=(const Snapshot&) = delete;
+
+	bool Consistent() const noexcept
+	{
+		for (const uint64_t value : values)
+		{
+			if (value != version)
+				return false;
+		}
+		return true;
+	}
+
+	uint64_t version;
+	std::vector<uint64_t> values;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   One writer publishing a run of versions while the readers load them,
+///   each reader keeping the version before the last one alive for a
+///   while. The readers must only ever see whole versions, in order, and
+///   every version must be freed at the end
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+void TestPublications()
+{
+	const int readerCount = 6;
+	const uint64_t publications = 200000;
+
+	{
+		kvasir::RcuPointer<Snapshot> current(std::make_shared<const Snapshot>(0));
+		std::atomic<bool> done{ false };
+		std::atomic<int> torn{ 0 };
+		std::atomic<int> backwards{ 0 };
+
+		std::vector<std::thread> readers;
+		for (int i = 0; i < readerCount; ++i)
+		{
+			readers.emplace_back([&]() {
+				std::shared_ptr<const Snapshot> kept;
+				uint64_t last = 0;
+				while (!done.load())
+				{
+					const std::shared_ptr<const Snapshot> snapshot = current.Load();
+					if (!snapshot->Consistent())
+						++torn;
+					if (snapshot->version < last)
+						++backwards;
+					last = snapshot->version;
+					if (kept && !kept->Consistent())
+						++torn;
+					if (last % 64 == 0)
+						kept = snapshot;
+				}
+			});
+		}
+
+		for (uint64_t version = 1; version <= publications; ++version)
+			current.Store(std::make_shared<const Snapshot>(version));
+		done = true;
+		for (std::thread& reader : readers)
+			reader.join();
+
+		Check(torn == 0, "whole versions only");
+		Check(backwards == 0, "versions in the order of the publications");
+		Check(current.Load()->version == publications, "last version published");
+		Check(live == 1, "older versions freed once no reader holds them");
+	}
+	Check(live == 0, "last version freed with the pointer");
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+int main()
+{
+	TestPublications();
+
+	if (failures)
+		std::cerr << failures << " checks failed" << std::endl;
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,688 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: recorder.cpp
+///
+/// summary: squelch-triggered recording of the scanner's audio output
+//////////////////////////////////////////////////////////////////////////
+
+#include "recorder.h"
+#include "energy_squelch.h"
+#include "ring_buffer.h"
+#include "segmenter.h"
+#include "timebase.h"
+#include "wave_file.h"
+#include "metrics.h"
+#include "config.h"
+#include "logger.h"
+
+#include <QtMultimedia/QAudioDeviceInfo>
+#include <QtMultimedia/QAudioInput>
+#include <QtCore/QIODevice>
+
+#include <condition_variable>
+#include <filesystem>
+#include <algorithm>
+#include <optional>
+#include <cassert>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <ctime>
+
+// Use thread-safe implementation of std::localtime
+#ifdef _WIN32
+# define safe_localtime(timePoint,brokenTime) localtime_s(brokenTime, timePoint)
+#else
+# define safe_localtime(timepoint,brokenTime) localtime_r(timepoint, brokenTime)
+#endif // _WIN32
+
+namespace fs = std::filesystem;
+
+namespace kvasir
+{
+
+namespace
+{
+
+// Audio is labeled once statuses for it have arrived, but it waits for
+// them no longer than this: it covers the poll interval and the serial
+// round trip in normal operation and bounds the buffered audio otherwise
+constexpr auto JoinWindow = std::chrono::milliseconds(500);
+
+//////////////////////////////////////////////////////////////////////////
+/// Position in the audio stream and its arrival time
+//////////////////////////////////////////////////////////////////////////
+struct BlockStamp
+{
+	uint64_t sampleEnd;
+	Timestamp arrival;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Sink for QAudioInput working in push mode: the audio callback only
+///   copies samples into the lock-free ring buffer, stamps them with the
+///   arrival time and never waits
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class CaptureDevice : public QIODevice
+{
+	RingBuffer<int16_t>& m_ring;
+	RingBuffer<BlockStamp>& m_stamps;
+	std::atomic<uint64_t>& m_dropped;
+	Counter& m_droppedMetric;
+	uint64_t m_written = 0;
+	char m_oddByte = 0;
+	bool m_hasOddByte = false;
+
+protected:
+	qint64 readData(char*, qint64) override
+	{
+		return -1;
+	}
+
+	qint64 writeData(const char* data, qint64 size) override
+	{
+		const Timestamp arrival = Clock::now();
+		const uint64_t written = m_written;
+		int16_t samples[512];
+		const char* cur = data;
+		const char* const end = data + size;
+
+		// A sample may be split between two consecutive writes
+		if (m_hasOddByte && cur != end)
+		{
+			const char bytes[2] = { m_oddByte, *cur++ };
+			std::memcpy(&samples[0], bytes, sizeof(bytes));
+			Push(samples, 1);
+			m_hasOddByte = false;
+		}
+
+		while (end - cur >= 2)
+		{
+			const size_t count = std::min<size_t>((end - cur) / 2, std::size(samples));
+			std::memcpy(samples, cur, count * sizeof(int16_t));
+			Push(samples, count);
+			cur += count * sizeof(int16_t);
+		}
+
+		if (cur != end)
+		{
+			m_oddByte = *cur;
+			m_hasOddByte = true;
+		}
+
+		if (m_written != written)
+		{
+			const BlockStamp stamp{ m_written, arrival };
+			m_stamps.Write(&stamp, 1);
+		}
+		return size;
+	}
+
+	void Push(const int16_t* samples, size_t count) noexcept
+	{
+		const size_t written = m_ring.Write(samples, count);
+		m_written += written;
+		if (written != count)
+		{
+			m_dropped.fetch_add(count - written, std::memory_order_relaxed);
+			m_droppedMetric.Increment(count - written);
+		}
+	}
+
+public:
+	CaptureDevice(RingBuffer<int16_t>& ring, RingBuffer<BlockStamp>& stamps, std::atomic<uint64_t>& dropped)
+		: m_ring(ring)
+		, m_stamps(stamps)
+		, m_dropped(dropped)
+		, m_droppedMetric(Metrics::GetInstance().AddCounter("kvasir_recorder_dropped_samples_total",
+			"Audio samples dropped on the ring buffer overflow."))
+	{}
+};
+
+//////////////////////////////////////////////////////////////////////////
+struct Clip
+{
+	bool confirmed;          // GLG status is attached to the clip
+	ReceptionStatus status;
+	std::chrono::system_clock::time_point started;
+	std::vector<int16_t> samples;
+	std::vector<StatusMark> marks;
+};
+
+//////////////////////////////////////////////////////////////////////////
+std::string MakeClipName(std::chrono::system_clock::time_point started, const ReceptionStatus& status)
+{
+	const std::time_t startTime = std::chrono::system_clock::to_time_t(started);
+	std::tm brokenTime;
+	safe_localtime(&startTime, &brokenTime);
+
+	char timebuf[32];
+	std::strftime(&timebuf[0], sizeof(timebuf), "%Y%m%d-%H%M%S", &brokenTime);
+
+	// Segments of a clip are often less than a second apart
+	const auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+		started.time_since_epoch()).count() % 1000;
+	char millibuf[8];
+	std::snprintf(&millibuf[0], sizeof(millibuf), ".%03d", static_cast<int>(millis < 0 ? millis + 1000 : millis));
+
+	std::string name = std::string(timebuf) + millibuf + '-' + ToString(status.freq);
+	if (!status.channel.empty())
+		name += '-' + status.channel;
+
+	// Channel names are free text: keep them file system friendly
+	std::replace_if(name.begin(), name.end(), [](unsigned char c)
+	{
+		return !std::isalnum(c) && c != '-' && c != '.';
+	}, '_');
+
+	return name + ".wav";
+}
+
+//////////////////////////////////////////////////////////////////////////
+WaveCodec ToWaveCodec(const std::string& codec)
+{
+	if ("pcm" == codec)
+		return WaveCodec::Pcm;
+	else if ("adpcm" == codec || codec.empty())
+		return WaveCodec::ImaAdpcm;
+
+	throw std::runtime_error("unknown audio codec: " + codec);
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+struct Recorder::Impl
+{
+	const Recording settings;
+	const WaveCodec codec;
+	SegmenterSettings segmenter;
+	const size_t preRollSamples;
+	const size_t hangSamples;
+	fs::path directory;
+
+	// Audio callback -> processing thread
+	RingBuffer<int16_t> ring;
+	RingBuffer<BlockStamp> stamps;
+	std::atomic<uint64_t> dropped{ 0 };
+	CaptureDevice device;
+	std::unique_ptr<QAudioInput> input;
+
+	// Monitoring loop -> processing thread
+	std::mutex statusLock;
+	std::vector<ReceptionStatus> statuses;
+
+	// Processing thread state
+	std::thread processor;
+	std::atomic<bool> running{ false };
+	AudioClock clock;
+	StatusTimeline timeline;
+	std::deque<ReceptionStatus> pending;    // statuses not applied yet
+	uint64_t position = 0;                  // samples consumed so far
+	std::vector<int16_t> history;
+	size_t historyPos = 0;
+	size_t historyFill = 0;
+	std::optional<Clip> clip;
+	std::optional<EnergySquelch> detector;
+	bool squelchOpen = false;    // as reported by GLG
+	bool audioOpen = false;      // as detected from the audio energy
+	size_t hangLeft = 0;
+
+	// Processing thread -> writer thread
+	std::thread writer;
+	std::mutex clipsLock;
+	std::condition_variable clipsReady;
+	std::deque<Clip> clips;
+	bool stopWriter = false;
+
+	// Storage metrics
+	Gauge& clipQueueDepth = Metrics::GetInstance().AddGauge("kvasir_recorder_clip_queue_depth",
+		"Finished clips waiting for the writer.");
+	Counter& filesWritten = Metrics::GetInstance().AddCounter("kvasir_recorder_files_written_total",
+		"Audio files written.");
+	Counter& bytesWritten = Metrics::GetInstance().AddCounter("kvasir_recorder_written_bytes_total",
+		"Size of the audio files written.");
+	Counter& writeErrors = Metrics::GetInstance().AddCounter("kvasir_recorder_write_errors_total",
+		"Audio files failed to write.");
+	Histogram& writeTime = Metrics::GetInstance().AddHistogram("kvasir_recorder_write_seconds",
+		"Time to encode and write an audio file.", LatencyBuckets());
+
+	explicit Impl(const Recording& settings)
+		: settings(settings)
+		, codec(ToWaveCodec(settings.codec))
+		, preRollSamples(static_cast<size_t>(settings.sampleRate) * settings.preRollMs / 1000)
+		, hangSamples(static_cast<size_t>(settings.sampleRate) * settings.hangTimeMs / 1000)
+		, ring(settings.sampleRate * 2) // up to 2 seconds of processing stall
+		, stamps(1024)
+		, device(ring, stamps, dropped)
+		, clock(settings.sampleRate)
+		, history(std::max<size_t>(preRollSamples, 1))
+	{
+		if (settings.squelchDb < 0)
+		{
+			EnergySquelch::Settings squelch;
+			squelch.openDbfs = settings.squelchDb;
+			squelch.closeDbfs = settings.squelchDb - 6.0;
+			detector.emplace(settings.sampleRate, squelch);
+			segmenter.speechDbfs = squelch.closeDbfs;
+		}
+		segmenter.paddingMs = static_cast<unsigned int>(std::max(settings.paddingMs, 0));
+	}
+
+	void Process();
+	void ProcessUpTo(const std::vector<int16_t>& staged, uint64_t limit);
+	void ApplyStatus(const ReceptionStatus& status);
+	void ApplyAudioEdge(const EnergySquelch::Event& edge);
+	void Consume(const int16_t* samples, size_t count);
+	void StartClip(const ReceptionStatus& status, bool withPreRoll, bool confirmed);
+	void FinishClip();
+	void Write();
+	void WriteSegment(const Clip& clip, const Segment& segment);
+};
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::Process()
+{
+	// Audio waiting for its statuses: bounded by the join window
+	const size_t stagedLimit = static_cast<size_t>(settings.sampleRate) * 2 * JoinWindow.count() / 1000;
+	std::vector<int16_t> staged;
+	staged.reserve(stagedLimit);
+	std::vector<ReceptionStatus> arrived;
+
+	for (;;)
+	{
+		const bool stopping = !running.load(std::memory_order_acquire);
+		{
+			std::lock_guard<std::mutex> lock(statusLock);
+			arrived.swap(statuses);
+		}
+		for (const auto& status : arrived)
+		{
+			timeline.Push(status);
+			pending.push_back(status);
+		}
+		arrived.clear();
+
+		BlockStamp stamp;
+		while (stamps.Read(&stamp, 1))
+			clock.Observe(stamp.sampleEnd, stamp.arrival);
+
+		const size_t stagedBefore = staged.size();
+		staged.resize(stagedLimit);
+		staged.resize(stagedBefore + ring.Read(&staged[stagedBefore], stagedLimit - stagedBefore));
+
+		// Audio older than the latest status is labeled for good, and
+		// nothing waits longer than the join window
+		uint64_t limit = position + staged.size();
+		if (!stopping && staged.size() < stagedLimit)
+		{
+			const Timestamp watermark = std::max(timeline.Watermark(), Clock::now() - JoinWindow);
+			limit = clock.Synchronized() ? std::min(limit, clock.SampleAt(watermark)) : position;
+		}
+
+		if (limit > position)
+		{
+			const size_t count = static_cast<size_t>(limit - position);
+			ProcessUpTo(staged, limit);
+			staged.erase(staged.begin(), staged.begin() + count);
+			continue;
+		}
+
+		if (stopping)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	if (clip)
+		FinishClip();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::ProcessUpTo(const std::vector<int16_t>& staged, uint64_t limit)
+{
+	// Staged audio starts at the current position. Statuses are applied
+	// exactly at the samples they were taken at; those which are late
+	// (older than the audio already consumed) are applied right away.
+	const int16_t* const base = staged.data();
+	const uint64_t start = position;
+	while (position < limit)
+	{
+		uint64_t end = limit;
+		if (!pending.empty())
+		{
+			const uint64_t statusSample = clock.SampleAt(pending.front().time);
+			if (statusSample <= position)
+			{
+				ApplyStatus(pending.front());
+				pending.pop_front();
+				continue;
+			}
+			end = std::min(end, statusSample);
+		}
+
+		Consume(base + (position - start), static_cast<size_t>(end - position));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::ApplyStatus(const ReceptionStatus& status)
+{
+	if (!status.squelch)
+	{
+		if (squelchOpen && !audioOpen)
+			hangLeft = hangSamples;
+		squelchOpen = false;
+
+		// Mark the closing within the clip, keeping the channel of it
+		if (clip && clip->marks.back().status.squelch)
+		{
+			ReceptionStatus closed = clip->status;
+			closed.squelch = false;
+			clip->marks.push_back(StatusMark{ clip->samples.size(), closed });
+		}
+		return;
+	}
+
+	if (clip && !clip->confirmed)
+	{
+		// The clip was started on the audio edge, the first GLG status
+		// after it tells what is actually received
+		clip->status = status;
+		clip->confirmed = true;
+		for (auto& mark : clip->marks)
+			mark.status = status;
+		KVASIR_LOG(DEBUG) << "transmission on " << ToString(status.freq) << ' ' << status.channel
+			<< " confirmed " << clip->samples.size() * 1000 / settings.sampleRate << " ms after the audio edge";
+	}
+	else if (clip && !SameTransmission(clip->status, status))
+	{
+		// Another channel became active within the hang time: the buffered
+		// audio belongs to the previous transmission already
+		FinishClip();
+		StartClip(status, false, true);
+	}
+	else if (!clip)
+	{
+		StartClip(status, true, true);
+	}
+	else if (!clip->marks.back().status.squelch)
+	{
+		// Squelch reopened within the hang time
+		clip->marks.push_back(StatusMark{ clip->samples.size(), status });
+	}
+
+	squelchOpen = true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::ApplyAudioEdge(const EnergySquelch::Event& edge)
+{
+	audioOpen = edge.open;
+	if (edge.open)
+	{
+		// Start recording right away, metadata comes with the next GLG poll
+		// unless the status at this moment is known already
+		const ReceptionStatus* known = timeline.Lookup(clock.TimeOf(edge.sample));
+		if (!clip && known && known->squelch)
+			StartClip(*known, true, true);
+		else if (!clip)
+			StartClip(ReceptionStatus{}, true, false);
+	}
+	else if (!squelchOpen)
+	{
+		hangLeft = hangSamples;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::Consume(const int16_t* samples, size_t count)
+{
+	if (detector)
+	{
+		for (const auto& edge : detector->Process(samples, count))
+			ApplyAudioEdge(edge);
+	}
+
+	if (clip)
+		clip->samples.insert(clip->samples.end(), samples, samples + count);
+
+	// Keep the pre-roll history up to date
+	for (size_t i = 0; i < count; ++i)
+	{
+		history[historyPos] = samples[i];
+		historyPos = (historyPos + 1) % history.size();
+	}
+	historyFill = std::min(historyFill + count, preRollSamples);
+	position += count;
+
+	if (clip && !squelchOpen && !audioOpen)
+	{
+		if (hangLeft <= count)
+			FinishClip();
+		else
+			hangLeft -= count;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::StartClip(const ReceptionStatus& status, bool withPreRoll, bool confirmed)
+{
+	clip.emplace();
+	clip->confirmed = confirmed;
+	clip->status = status;
+	clip->status.squelch = true;
+	clip->marks.push_back(StatusMark{ 0, clip->status });
+
+	// Wall clock time of the current position in the stream
+	const auto lag = std::chrono::duration_cast<std::chrono::system_clock::duration>(
+		Clock::now() - clock.TimeOf(position));
+	clip->started = std::chrono::system_clock::now() - lag;
+	clip->samples.reserve(settings.sampleRate * 10);
+
+	if (withPreRoll && historyFill)
+	{
+		const size_t oldest = (historyPos + history.size() - historyFill) % history.size();
+		for (size_t i = 0; i < historyFill; ++i)
+			clip->samples.push_back(history[(oldest + i) % history.size()]);
+		clip->started -= std::chrono::milliseconds(historyFill * 1000 / settings.sampleRate);
+	}
+
+	if (confirmed)
+	{
+		KVASIR_LOG(DEBUG) << "transmission started on " << ToString(status.freq) << ' ' << status.channel;
+	}
+	else
+	{
+		KVASIR_LOG(DEBUG) << "transmission started on the audio edge";
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::FinishClip()
+{
+	if (!clip->confirmed)
+	{
+		// Squelch has never opened on the scanner: noise, not a transmission
+		KVASIR_LOG(DEBUG) << "audio activity without GLG confirmation is discarded";
+		clip.reset();
+		hangLeft = 0;
+		return;
+	}
+
+	KVASIR_LOG(DEBUG) << "transmission finished on " << ToString(clip->status.freq)
+		<< ", " << clip->samples.size() << " samples recorded";
+	{
+		std::lock_guard<std::mutex> lock(clipsLock);
+		clips.emplace_back(std::move(*clip));
+	}
+	clipQueueDepth.Add(1);
+	clipsReady.notify_one();
+	clip.reset();
+	hangLeft = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::Write()
+{
+	for (;;)
+	{
+		Clip next;
+		{
+			std::unique_lock<std::mutex> lock(clipsLock);
+			clipsReady.wait(lock, [this] { return stopWriter || !clips.empty(); });
+			if (clips.empty())
+				return;
+			next = std::move(clips.front());
+			clips.pop_front();
+		}
+		clipQueueDepth.Add(-1);
+
+		std::vector<Segment> segments;
+		if (settings.paddingMs < 0)
+			segments.push_back(Segment{ 0, next.samples.size(), next.status });
+		else
+			segments = SegmentRecording(next.samples, settings.sampleRate, next.marks, segmenter);
+
+		KVASIR_LOG(DEBUG) << "clip of " << next.samples.size() << " samples is split into "
+			<< segments.size() << " segments";
+
+		for (const auto& segment : segments)
+			WriteSegment(next, segment);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Impl::WriteSegment(const Clip& clip, const Segment& segment)
+{
+	const auto offset = std::chrono::milliseconds(segment.begin * 1000 / settings.sampleRate);
+	const fs::path path = directory / MakeClipName(clip.started + offset, segment.status);
+	try
+	{
+		const WaveInfo info = {
+			{ "INAM", segment.status.channel },
+			{ "IPRD", segment.status.site },
+			{ "ISBJ", ToString(segment.status.freq) },
+			{ "IKEY", segment.status.group }
+		};
+		const std::vector<int16_t> samples(clip.samples.begin() + segment.begin,
+			clip.samples.begin() + segment.end);
+		const Timestamp started = Clock::now();
+		WriteWaveFile(path.string(), samples, settings.sampleRate, info, codec);
+		writeTime.Observe(Clock::now() - started);
+		filesWritten.Increment();
+
+		std::error_code err;
+		const auto size = fs::file_size(path, err);
+		if (!err)
+			bytesWritten.Increment(size);
+		KVASIR_LOG(DEBUG) << "clip " << path.string() << " is written";
+	}
+	catch (const std::exception& e)
+	{
+		writeErrors.Increment();
+		Logger::GetInstance().Error() << "failed to write clip: " << e.what();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+Recorder::Recorder(const Recording& settings)
+	: m_impl(std::make_unique<Impl>(settings))
+{
+	m_impl->directory = settings.directory;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Recorder::~Recorder()
+{
+	Stop();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Start()
+{
+	assert(!m_impl->running && "recorder already started");
+	Logger& log = Logger::GetInstance();
+
+	QAudioFormat format;
+	format.setSampleRate(static_cast<int>(m_impl->settings.sampleRate));
+	format.setChannelCount(1);
+	format.setSampleSize(16);
+	format.setSampleType(QAudioFormat::SignedInt);
+	format.setByteOrder(QAudioFormat::LittleEndian);
+	format.setCodec("audio/pcm");
+
+	QAudioDeviceInfo deviceInfo = QAudioDeviceInfo::defaultInputDevice();
+	if (!m_impl->settings.audioInput.empty())
+	{
+		const QString name = QString::fromStdString(m_impl->settings.audioInput);
+		const auto inputs = QAudioDeviceInfo::availableDevices(QAudio::AudioInput);
+		const auto found = std::find_if(inputs.cbegin(), inputs.cend(),
+			[&name](const QAudioDeviceInfo& info) { return info.deviceName() == name; });
+		if (found == inputs.cend())
+			throw std::runtime_error("audio input " + m_impl->settings.audioInput + " is not found");
+		deviceInfo = *found;
+	}
+
+	if (!deviceInfo.isFormatSupported(format))
+	{
+		throw std::runtime_error("audio input " + deviceInfo.deviceName().toStdString() +
+			" does not support 16-bit mono at " + std::to_string(m_impl->settings.sampleRate) + " Hz");
+	}
+
+	fs::create_directories(m_impl->directory);
+
+	m_impl->running = true;
+	m_impl->writer = std::thread([this] { m_impl->Write(); });
+	m_impl->processor = std::thread([this] { m_impl->Process(); });
+
+	m_impl->device.open(QIODevice::WriteOnly);
+	m_impl->input = std::make_unique<QAudioInput>(deviceInfo, format);
+	m_impl->input->start(&m_impl->device);
+
+	log.Info() << "recording " << deviceInfo.deviceName().toStdString() << " into " << m_impl->directory.string();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::Stop()
+{
+	if (!m_impl->running)
+		return;
+
+	if (m_impl->input)
+	{
+		m_impl->input->stop();
+		m_impl->input.reset();
+	}
+	m_impl->device.close();
+
+	// Processor drains the ring buffer and flushes the last clip
+	m_impl->running = false;
+	m_impl->processor.join();
+	{
+		std::lock_guard<std::mutex> lock(m_impl->clipsLock);
+		m_impl->stopWriter = true;
+	}
+	m_impl->clipsReady.notify_one();
+	m_impl->writer.join();
+
+	if (const uint64_t dropped = m_impl->dropped.load())
+		Logger::GetInstance().Error() << dropped << " audio samples were dropped on overflow";
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Recorder::OnStatus(const ReceptionStatus& status)
+{
+	if (!m_impl->running.load(std::memory_order_relaxed))
+		return;
+
+	std::lock_guard<std::mutex> lock(m_impl->statusLock);
+	m_impl->statuses.push_back(status);
+}
+
+} // namespace kvasir
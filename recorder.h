@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: recorder.h
+///
+/// summary: squelch-triggered recording of the scanner's audio output
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_RECORDER_H_INCLUDED
+#define KVASIR_RECORDER_H_INCLUDED
+
+#include "uniden.h"
+
+#include <memory>
+
+namespace kvasir
+{
+
+// Forward declaration of recording settings
+struct Recording;
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Captures the audio input continuously and cuts it into clips, one per
+///   transmission. A clip starts when the squelch opens (prefixed with the
+///   pre-roll audio) and ends when the squelch stays closed for the hang
+///   time. The squelch is taken from GLG polls and, if configured, from the
+///   audio energy: then the clip starts on the audio edge and gets the
+///   channel metadata from the next GLG status. Clips are written into
+///   WAVE files by a background thread.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Recorder
+{
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	explicit Recorder(const Recording& settings);
+	~Recorder();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Open the audio input and start recording. Should be called from
+	/// the thread with a running event loop.
+	//////////////////////////////////////////////////////////////////////////
+	void Start();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Stop capturing, flush the current clip and wait for pending writes
+	//////////////////////////////////////////////////////////////////////////
+	void Stop();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Feed the reception status from the monitoring loop. Never blocks
+	/// on audio processing or disk I/O.
+	//////////////////////////////////////////////////////////////////////////
+	void OnStatus(const ReceptionStatus& status);
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_RECORDER_H_INCLUDED
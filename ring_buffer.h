@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: ring_buffer.h
+///
+/// summary: lock-free single producer / single consumer ring buffer
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_RING_BUFFER_H_INCLUDED
+#define KVASIR_RING_BUFFER_H_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Bounded ring buffer for trivially copyable items. Exactly one thread
+///   may call Write() and exactly one (other) thread may call Read().
+///   Neither of them ever blocks: the writer drops what does not fit and
+///   the reader gets only what is available.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+template<typename T>
+class RingBuffer
+{
+	std::vector<T> m_data;
+	const size_t m_mask;
+	alignas(64) std::atomic<size_t> m_head; // next position to write
+	alignas(64) std::atomic<size_t> m_tail; // next position to read
+
+	static size_t RoundUp(size_t value)
+	{
+		size_t result = 1;
+		while (result < value)
+			result <<= 1;
+		return result;
+	}
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// Capacity is rounded up to the next power of two
+	//////////////////////////////////////////////////////////////////////////
+	explicit RingBuffer(size_t capacity)
+		: m_data(RoundUp(capacity))
+		, m_mask(m_data.size() - 1)
+		, m_head(0)
+		, m_tail(0)
+	{}
+
+	RingBuffer(const RingBuffer&) = delete;
+	RingBuffer& operator=(const RingBuffer&) = delete;
+
+	size_t Capacity() const noexcept
+	{
+		return m_data.size();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Number of items ready to be read (exact for the consumer thread)
+	//////////////////////////////////////////////////////////////////////////
+	size_t Available() const noexcept
+	{
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Producer side: returns the number of items actually written
+	//////////////////////////////////////////////////////////////////////////
+	size_t Write(const T* items, size_t count) noexcept
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		const size_t tail = m_tail.load(std::memory_order_acquire);
+		count = std::min(count, m_data.size() - (head - tail));
+
+		const size_t start = head & m_mask;
+		const size_t first = std::min(count, m_data.size() - start);
+		std::copy(items, items + first, m_data.begin() + start);
+		std::copy(items + first, items + count, m_data.begin());
+
+		m_head.store(head + count, std::memory_order_release);
+		return count;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Consumer side: returns the number of items actually read
+	//////////////////////////////////////////////////////////////////////////
+	size_t Read(T* items, size_t count) noexcept
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		const size_t head = m_head.load(std::memory_order_acquire);
+		count = std::min(count, head - tail);
+
+		const size_t start = tail & m_mask;
+		const size_t first = std::min(count, m_data.size() - start);
+		std::copy(m_data.begin() + start, m_data.begin() + start + first, items);
+		std::copy(m_data.begin(), m_data.begin() + (count - first), items + first);
+
+		m_tail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_RING_BUFFER_H_INCLUDED
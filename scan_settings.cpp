@@ -11,16 +11,39 @@
 #include "group.h"
 
 #include <cassert>
+#include <optional>
 #include <typeinfo>
 
 namespace kvasir
 {
 
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// Format the trunked system is set to show its talk group IDs in
+//////////////////////////////////////////////////////////////////////////
+IdFormat ReadIdFormat(const Scanner& scanner, int index, std::optional<SystemType> type)
+{
+	const bool edacs = SystemType::EDACS == type || SystemType::EDACS_SCAT == type;
+	const bool motorola = SystemType::Motorola == type || SystemType::P25Standard == type ||
+		SystemType::P25OneFrequency == type;
+	if (!edacs && !motorola)
+		return IdFormat::Decimal;
+
+	const auto trn = scanner.IssueCommand("TRN," + std::to_string(index) + "\r", 29, CommandPriority::Bulk);
+	if (edacs)
+		return "1" == trn[Offset(TRN::Afs)] ? IdFormat::Afs : IdFormat::Decimal;
+	return "1" == trn[Offset(TRN::MotorolaId)] ? IdFormat::Hex : IdFormat::Decimal;
+}
+
+} // namespace
+
 //////////////////////////////////////////////////////////////////////////
 void ScanSettings::GetSystems(const Scanner& scanner)
 {
 	std::vector<UniversalSystem> newSystems;
-	auto response = scanner.IssueCommand("SCT\r", 1);
+	auto response = scanner.IssueCommand("SCT\r", 1, CommandPriority::Bulk);
 	int systemCount = std::stoi(response.front());	
 
 	if (!systemCount)
@@ -31,32 +54,40 @@ void ScanSettings::GetSystems(const Scanner& scanner)
 	
 	// Reserve space, get head and tail indexes
 	newSystems.reserve(systemCount);
-	const std::string headIndex = scanner.IssueCommand("SIH\r", 1).front();
-	const std::string tailIndex = scanner.IssueCommand("SIT\r", 1).front();
+	const std::string headIndex = scanner.IssueCommand("SIH\r", 1, CommandPriority::Bulk).front();
+	const std::string tailIndex = scanner.IssueCommand("SIT\r", 1, CommandPriority::Bulk).front();
 
-	Logger& log = Logger::GetInstance();
-	log.Debug() << "start reading " << systemCount
+	KVASIR_LOG(DEBUG) << "start reading " << systemCount
 		<< " from offset #" << headIndex;
 		
-	std::string index = headIndex;	
+	// The next system is read while the current one is being built. The
+	// commands of the others go to the radio between the records
+	std::string index = headIndex;
+	std::future<RawReply> pending = scanner.Submit("SIN, " + index + "\r", CommandPriority::Bulk);
 	while (systemCount--)
 	{
-		log.Debug() << "reading system " << index;
-		response = scanner.IssueCommand("SIN, " + index + "\r", 28);
-				
-		const int idx = std::stoi(index);		
+		KVASIR_LOG(DEBUG) << "reading system " << index;
+		response = Scanner::ParseReply("SIN", pending.get().text, 28);
+
+		const int idx = std::stoi(index);
+		// Move to the next system in chain
+		index = response[12];
+		if (systemCount)
+			pending = scanner.Submit("SIN, " + index + "\r", CommandPriority::Bulk);
+
 		// Create the system
-		if ("CNV" == response[Offset(SIN::Type)])
+		// Types the table doesn't know are trunked like most of them
+		const std::optional<SystemType> type = SystemTypeFromString(response[Offset(SIN::Type)]);
+		if (SystemType::Conventional == type)
 		{
 			newSystems.emplace_back(ConventionalSystem(idx, response));
 		}
 		else
 		{
-			newSystems.emplace_back(TrunkSystem(idx, response));
-		}		
-
-		// Move to the next system in chain
-		index = response[12];
+			TrunkSystem system(idx, response);
+			system.m_idFormat = ReadIdFormat(scanner, idx, type);
+			newSystems.emplace_back(std::move(system));
+		}
 	}
 
 	std::swap(m_systems, newSystems);
@@ -77,5 +108,37 @@ catch (const std::exception& e)
 	throw e;
 }
 
+//////////////////////////////////////////////////////////////////////////
+IdFormat ScanSettings::TalkGroupFormat(std::string_view system) const noexcept
+{
+	for (const auto& universal : m_systems)
+	{
+		const auto format = std::visit([system](const auto& sys) {
+			return sys.Name() == system ? std::optional<IdFormat>(sys.TalkGroupFormat()) : std::nullopt;
+		}, universal);
+		if (format)
+			return *format;
+	}
+	return IdFormat::Decimal;
+}
+
+//////////////////////////////////////////////////////////////////////////
+ScanSettingsStore::ScanSettingsStore()
+	: m_current(std::make_shared<const ScanSettings>())
+{}
+
+//////////////////////////////////////////////////////////////////////////
+void ScanSettingsStore::Publish(ScanSettings settings)
+{
+	m_current.Store(std::make_shared<const ScanSettings>(std::move(settings)));
+}
+
+//////////////////////////////////////////////////////////////////////////
+void ScanSettingsStore::Reload(const Scanner& scanner)
+{
+	ScanSettings settings;
+	settings.Load(scanner);
+	Publish(std::move(settings));
+}
 
 } // namespace kvasir
\ No newline at end of file
@@ -9,7 +9,9 @@
 
 #include "uniden.h"
 #include "system.h"
+#include "rcu_pointer.h"
 
+#include <string_view>
 #include <memory>
 #include <vector>
 #include <variant>
@@ -216,6 +218,14 @@ public:
 		return m_systems;
 	}	
 
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Format the talk group IDs of the named system are shown in, decimal
+	///   for the systems not loaded
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	IdFormat TalkGroupFormat(std::string_view system) const noexcept;
+
 	UniversalSystem& CreateSystem(const std::string& name, const SystemType type);
 	void DeleteSystem(const std::string& name);
 
@@ -225,6 +235,43 @@ private:
 	void GetSystems(const Scanner&);
 };
 
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   The scan settings shared by the threads: each reader gets the whole
+///   model as it was published, without locking, while a reload builds the
+///   next one aside. A snapshot is never changed once published and stays
+///   valid for as long as the reader keeps it.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class ScanSettingsStore
+{
+public:
+	using Snapshot = std::shared_ptr<const ScanSettings>;
+
+	ScanSettingsStore();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Settings published last, empty until the first reload
+	//////////////////////////////////////////////////////////////////////////
+	Snapshot Current() const noexcept
+	{
+		return m_current.Load();
+	}
+
+	void Publish(ScanSettings settings);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Read the settings from the radio and publish them; the current
+	///   snapshot is kept if the reading fails
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void Reload(const Scanner& scanner);
+
+private:
+	RcuPointer<ScanSettings> m_current;
+};
+
 } 
 
 #endif  // KVASIR_SCAN_SETTINGS_H_INCLUDED
\ No newline at end of file
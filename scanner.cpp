@@ -4,29 +4,281 @@
 /// summary: Scanner device controller.h
 //////////////////////////////////////////////////////////////////////////
 
-#include <QtSerialPort/QSerialPort>
+#include <condition_variable>
 #include <string_view>
+#include <algorithm>
 #include <cassert>
+#include <atomic>
+#include <thread>
+#include <deque>
+#include <mutex>
 #include <regex>
 
 #include "scanner.h"
+#include "scan_settings.h"
+#include "timebase.h"
 #include "config.h"
 #include "logger.h"
+#include "trace.h"
+#include "metrics.h"
+#include "serial_capture.h"
+#include "serial_transport.h"
+#include "qt_serial_transport.h"
+
+#ifdef KVASIR_HAVE_NATIVE_SERIAL
+# include "native_serial_transport.h"
+#endif // KVASIR_HAVE_NATIVE_SERIAL
 
 namespace kvasir
 {
 
+// The radio answers within milliseconds, much longer silence means it's gone
+constexpr std::chrono::milliseconds ResponseTimeout(3000);
+
+// Commands of a lower class overtaken so many times in a row go next
+constexpr unsigned int MaxOvertakes = 8;
+
+constexpr size_t PriorityCount = 3;
+
+//////////////////////////////////////////////////////////////////////////
+/// Counters of the serial traffic, shared by all the scanners
+//////////////////////////////////////////////////////////////////////////
+struct SerialMetrics
+{
+	Counter& commands;
+	Counter& timeouts;
+	Counter& invalidReplies;
+	Counter& bytesSent;
+	Counter& bytesReceived;
+	Histogram& roundTrip;
+
+	static SerialMetrics& Get()
+	{
+		static SerialMetrics metrics{
+			Metrics::GetInstance().AddCounter("kvasir_serial_commands_total", "Commands sent to the radio."),
+			Metrics::GetInstance().AddCounter("kvasir_serial_errors_total", "Failed commands.", "kind=\"timeout\""),
+			Metrics::GetInstance().AddCounter("kvasir_serial_errors_total", "Failed commands.", "kind=\"invalid_reply\""),
+			Metrics::GetInstance().AddCounter("kvasir_serial_sent_bytes_total", "Bytes sent to the radio."),
+			Metrics::GetInstance().AddCounter("kvasir_serial_received_bytes_total", "Bytes received from the radio."),
+			Metrics::GetInstance().AddHistogram("kvasir_serial_round_trip_seconds",
+				"Time from the command to the end of the reply.", LatencyBuckets())
+		};
+		return metrics;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   The link and the capture are touched by the I/O thread only: it's
+///   where the serial port is opened, read and closed. Other threads queue
+///   tasks to it and read the atomics.
+/// </summary>
 //////////////////////////////////////////////////////////////////////////
 struct Scanner::Impl
 {
-	QSerialPort port;
+	std::unique_ptr<SerialTransport> transport;
+	std::unique_ptr<SerialCapture> capture;
+	SerialMetrics& metrics = SerialMetrics::Get();
+	Clock::duration smoothedRoundTrip{};
+
+	std::atomic<bool> connected{ false };
+	std::atomic<Clock::rep> roundTripTime{ 0 };
+
+	// Queued tasks of each priority class, touched under the lock
+	std::deque<std::packaged_task<void()>> tasks[PriorityCount];
+	unsigned int overtaken[PriorityCount] = {};
+	bool programming = false;               // The radio has confirmed PRG
+	unsigned int draining = 0;              // Sync() calls waiting for the queues
+	std::mutex lock;
+	std::condition_variable ready;
+	bool stop = false;
+	std::mutex session;                     // Held in programming mode
+	std::atomic<std::thread::id> sessionOwner{ std::thread::id() };
+	std::thread worker;
+
+	Impl()
+		: worker([this] { Work(); })
+	{}
 
 	~Impl()
 	{
-		if (port.isOpen())
+		Queue([this] {
+			if (transport && transport->IsOpen())
+			{
+				transport->Close();
+			}
+			transport.reset();
+			capture.reset();
+			SetProgramming(false);
+		}).wait();
+
 		{
-			port.close();
+			std::lock_guard<std::mutex> guard(lock);
+			stop = true;
 		}
+		ready.notify_one();
+		worker.join();
+	}
+
+	std::future<void> Queue(std::function<void()> job,
+		CommandPriority priority = CommandPriority::Interactive)
+	{
+		std::packaged_task<void()> task(std::move(job));
+		std::future<void> result = task.get_future();
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			tasks[static_cast<size_t>(priority)].emplace_back(std::move(task));
+		}
+		ready.notify_one();
+		return result;
+	}
+
+	bool Runnable(size_t priority) const
+	{
+		return !tasks[priority].empty() &&
+			!(programming && !draining && priority == static_cast<size_t>(CommandPriority::Monitoring));
+	}
+
+	// Class to take the next task from, PriorityCount if none is runnable
+	size_t Pick()
+	{
+		size_t chosen = PriorityCount;
+		for (size_t priority = 0; priority < PriorityCount; ++priority)
+		{
+			if (!Runnable(priority))
+				continue;
+			if (chosen == PriorityCount || overtaken[priority] >= MaxOvertakes)
+			{
+				chosen = priority;
+				if (overtaken[priority] >= MaxOvertakes)
+					break;
+			}
+		}
+		if (chosen == PriorityCount)
+			return chosen;
+
+		for (size_t priority = 0; priority < PriorityCount; ++priority)
+		{
+			if (priority == chosen)
+				overtaken[priority] = 0;
+			else if (priority > chosen && Runnable(priority))
+				++overtaken[priority];
+		}
+		return chosen;
+	}
+
+	void Work()
+	{
+		for (;;)
+		{
+			std::packaged_task<void()> task;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				size_t priority = PriorityCount;
+				ready.wait(guard, [this, &priority] {
+					priority = Pick();
+					return stop || priority != PriorityCount;
+				});
+				if (priority == PriorityCount)
+					return;
+				task = std::move(tasks[priority].front());
+				tasks[priority].pop_front();
+			}
+			task();
+		}
+	}
+
+	void SetProgramming(bool value)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		programming = value;
+	}
+
+	void Attach(std::unique_ptr<SerialTransport> link)
+	{
+		assert(!transport && "scanner already connected");
+		transport = std::move(link);
+		connected = transport->IsOpen();
+		SetProgramming(false);
+	}
+
+	void UpdateRoundTrip(Clock::duration roundTrip)
+	{
+		metrics.roundTrip.Observe(roundTrip);
+		if (smoothedRoundTrip == Clock::duration::zero())
+			smoothedRoundTrip = roundTrip;
+		else
+			smoothedRoundTrip += (roundTrip - smoothedRoundTrip) / 8;
+		roundTripTime.store(smoothedRoundTrip.count(), std::memory_order_relaxed);
+	}
+
+	void Send(const std::string& command)
+	{
+		if (capture)
+			capture->Record(CaptureDirection::ToRadio, command.data(), command.size());
+		transport->Write(command.data(), command.size());
+		metrics.commands.Increment();
+		metrics.bytesSent.Increment(command.size());
+	}
+
+	size_t Receive(char* buffer, size_t capacity)
+	{
+		const size_t size = transport->Read(buffer, capacity, ResponseTimeout);
+		if (capture && size)
+			capture->Record(CaptureDirection::FromRadio, buffer, size);
+		metrics.bytesReceived.Increment(size);
+		return size;
+	}
+
+	// Send the command and read the whole reply, on the I/O thread
+	RawReply Transact(const std::string& command)
+	{
+		// All commands are 3 letters sequences
+		const std::string_view cmdName(command.data(), 3);
+
+		if (!transport || !transport->IsOpen())
+			throw std::runtime_error("scanner is not connected");
+
+		// Whatever the radio answers, the programming session is over
+		if (cmdName == "EPG")
+			SetProgramming(false);
+
+		const Timestamp sent = Clock::now();
+		KVASIR_TRACE("command {}", command);
+		try
+		{
+			Send(command);
+		}
+		catch (const std::exception&)
+		{
+			connected = transport->IsOpen();
+			throw;
+		}
+
+		// Wait for the end of data (all responses are finished with '\r')
+		std::string buf;
+		do
+		{
+			char chunk[256];
+			const size_t size = Receive(chunk, sizeof(chunk));
+			if (!size)
+			{
+				metrics.timeouts.Increment();
+				connected = transport->IsOpen();
+				throw std::runtime_error("no response to " + std::string(cmdName));
+			}
+			buf.append(chunk, size);
+		} while (buf.back() != '\r');
+		const Timestamp received = Clock::now();
+		UpdateRoundTrip(received - sent);
+		KVASIR_TRACE("reply {} in {} us", std::string_view(buf.data(), buf.size()),
+			std::chrono::duration_cast<std::chrono::microseconds>(received - sent).count());
+
+		buf.pop_back();
+		KVASIR_LOG(DEBUG) << "scanner response: " << buf;
+		if (cmdName == "PRG" && buf == "PRG,OK")
+			SetProgramming(true);
+		return RawReply{ std::move(buf), received, received - sent, smoothedRoundTrip };
 	}
 };
 
@@ -55,7 +307,7 @@ std::vector<std::string> SplitString(const std::string& str)
 	}
 
 	// Correction for std::sregex_token_iterator behavior
-	if (',' == str.back())
+	if (!str.empty() && ',' == str.back())
 	{
 		result.emplace_back(std::string{});
 	}
@@ -64,112 +316,169 @@ std::vector<std::string> SplitString(const std::string& str)
 }
 
 //////////////////////////////////////////////////////////////////////////
-QSerialPort::DataBits ToDataBits(const unsigned int bits)
+void Scanner::Connect(const Device& device, SerialBackend backend)
+try
 {
-	switch (bits)
-	{
-	case 8:
-		return QSerialPort::Data8;
-	case 7:
-		return QSerialPort::Data7;
-	case 6:
-		return QSerialPort::Data6;
-	case 5:
-		return QSerialPort::Data5;
-	default:
-		throw std::logic_error("invalid number of data bits: " + std::to_string(bits));
-	}
+	// The port belongs to the thread it's opened in
+	Connect([&device, backend]() -> std::unique_ptr<SerialTransport> {
+		if (SerialBackend::Native == backend)
+		{
+#ifdef KVASIR_HAVE_NATIVE_SERIAL
+			return std::make_unique<NativeSerialTransport>(device);
+#else
+			throw std::runtime_error("native serial port is not supported on this system");
+#endif // KVASIR_HAVE_NATIVE_SERIAL
+		}
+		return std::make_unique<QtSerialTransport>(device);
+	});
+	KVASIR_LOG(DEBUG) << "connected to port " << device.port;
+}
+catch (const std::exception& e)
+{
+	throw std::runtime_error("failed to connect to port " + device.port + ": " + std::string(e.what()));
 }
 
 //////////////////////////////////////////////////////////////////////////
-QSerialPort::StopBits ToStopBits(const unsigned int bits)
+void Scanner::Connect(std::unique_ptr<SerialTransport> transport)
 {
-	switch (bits)
-	{
-	case 1:
-		return QSerialPort::OneStop;
-	case 2:
-		return QSerialPort::TwoStop;
-	case 3:
-		return QSerialPort::OneAndHalfStop;
-	default:
-		throw std::logic_error("invalid number of stop bits: " + std::to_string(bits));
-	}
+	m_impl->Queue([this, &transport] {
+		m_impl->Attach(std::move(transport));
+	}).get();
 }
 
 //////////////////////////////////////////////////////////////////////////
-QSerialPort::Parity ToParity(const bool parity)
+void Scanner::Connect(TransportFactory open)
 {
-	return parity ? QSerialPort::EvenParity : QSerialPort::NoParity;
+	m_impl->Queue([this, &open] {
+		m_impl->Attach(open());
+	}).get();
 }
 
 //////////////////////////////////////////////////////////////////////////
-void Scanner::Connect(const Device& device)
-try
+void Scanner::Disconnect()
 {
-	assert(!m_impl->port.isOpen() && "serial port already open");
-	auto& port = m_impl->port;
-
-	port.setPortName(QString::fromStdString(device.port));
-	port.setBaudRate(device.baudRate);
-	port.setDataBits(ToDataBits(device.dataBits));
-	port.setStopBits(ToStopBits(device.stopBits));
-	port.setParity(ToParity(device.parityCheck));
-	port.setFlowControl(QSerialPort::NoFlowControl);
-	if (!port.open(QIODevice::ReadWrite))
-	{
-		throw std::runtime_error(port.errorString().toStdString());
-	}
-
-	Logger::GetInstance().Debug() << "connected to port " << device.port;
+	// The link may be lost already: the dead port is let go all the same,
+	// so that the next Connect() opens it anew
+	m_impl->Queue([this] {
+		m_impl->connected = false;
+		if (m_impl->transport && m_impl->transport->IsOpen())
+			m_impl->transport->Close();
+		m_impl->transport.reset();
+		m_impl->SetProgramming(false);
+	}).get();
 }
-catch (const std::exception& e)
+
+//////////////////////////////////////////////////////////////////////////
+bool Scanner::IsConnected() const noexcept
 {
-	throw std::runtime_error("failed to connect to port " + device.port + ": " + std::string(e.what()));
+	return m_impl->connected;
 }
 
 //////////////////////////////////////////////////////////////////////////
-void Scanner::Disconnect()
+void Scanner::StartCapture(const std::string& path)
 {
-	assert(m_impl->port.isOpen() && "serial port is not open");
+	m_impl->Queue([this, &path] {
+		m_impl->capture = std::make_unique<SerialCapture>(path);
+	}).get();
 }
 
 //////////////////////////////////////////////////////////////////////////
-Scanner::Response Scanner::IssueCommand(const std::string& command, size_t responseSize) const
+void Scanner::StopCapture()
 {
-	// All commands are 3 letters sequences
-	const std::string_view cmdName(command.data(), 3);
+	m_impl->Queue([this] {
+		m_impl->capture.reset();
+	}).get();
+}
 
-	m_impl->port.write(command.c_str());		
+//////////////////////////////////////////////////////////////////////////
+void Scanner::Post(std::string command, ReplyHandler handler, CommandPriority priority) const
+{
+	Impl* const impl = m_impl.get();
+	impl->Queue([impl, command = std::move(command), handler = std::move(handler)] {
+		RawReply reply{};
+		std::exception_ptr error;
+		try
+		{
+			reply = impl->Transact(command);
+		}
+		catch (const std::exception&)
+		{
+			error = std::current_exception();
+		}
+		handler(std::move(reply), error);
+	}, priority);
+}
 
-	// Wait for the end of data (all responses are finished with '\r')
-	QByteArray buf;
-	do
-	{
-		m_impl->port.waitForReadyRead();		
-		buf += m_impl->port.readAll();
-	} while (buf.back() != '\r');
+//////////////////////////////////////////////////////////////////////////
+std::future<RawReply> Scanner::Submit(std::string command, CommandPriority priority) const
+{
+	auto promise = std::make_shared<std::promise<RawReply>>();
+	std::future<RawReply> result = promise->get_future();
+	Post(std::move(command), [promise](RawReply reply, std::exception_ptr error) {
+		if (error)
+			promise->set_exception(error);
+		else
+			promise->set_value(std::move(reply));
+	}, priority);
+	return result;
+}
 
-	if (Logger::GetInstance().IsVerbose())
+//////////////////////////////////////////////////////////////////////////
+void Scanner::Sync() const
+{
+	// Queues of each class are served in order. The monitoring commands held
+	// in programming mode go out meanwhile too, the radio refuses them then
 	{
-		Logger::GetInstance().Debug() << "scanner response: "
-			<< std::string(buf.cbegin(), std::prev(buf.cend(), 1));
+		std::lock_guard<std::mutex> guard(m_impl->lock);
+		++m_impl->draining;
 	}
-	
+	std::vector<std::future<void>> barriers;
+	for (size_t priority = 0; priority < PriorityCount; ++priority)
+		barriers.push_back(m_impl->Queue([] {}, static_cast<CommandPriority>(priority)));
+	for (auto& barrier : barriers)
+		barrier.wait();
+
+	std::lock_guard<std::mutex> guard(m_impl->lock);
+	--m_impl->draining;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Scanner::Response Scanner::IssueCommand(const std::string& command, size_t responseSize,
+	CommandPriority priority) const
+{
+	return ParseReply(command, Submit(command, priority).get().text, responseSize);
+}
+
+//////////////////////////////////////////////////////////////////////////
+Scanner::Response Scanner::ParseReply(const std::string& command, const std::string& reply, size_t responseSize)
+{
+	const std::string_view cmdName(command.data(), 3);
+
 	// Check response format: it should be suffixed with the command's name
-	if (buf.size() < 4 || std::string_view(buf.data(), 3) != cmdName)
+	if (reply.size() < 3 || std::string_view(reply.data(), 3) != cmdName)
+	{
+		SerialMetrics::Get().invalidReplies.Increment();
 		throw std::runtime_error("invalid " + std::string(cmdName) + " response: wrong prefix");
+	}
 
 	// Build the list of response values
-	const std::string response(std::next(buf.cbegin(), 4), std::prev(buf.cend()));
-	const Response result = SplitString(response);
+	const Response result = SplitString(reply.size() > 4 ? reply.substr(4) : std::string());
 	if (responseSize != result.size())
+	{
+		SerialMetrics::Get().invalidReplies.Increment();
 		throw std::runtime_error("invalid " + std::string(cmdName) +
 			" response length: " + std::to_string(result.size()));
+	}
 
 	return result;
 }
 
+//////////////////////////////////////////////////////////////////////////
+std::chrono::steady_clock::duration Scanner::RoundTripTime() const noexcept
+{
+	return Clock::duration(m_impl->roundTripTime.load(std::memory_order_relaxed));
+}
+
 //////////////////////////////////////////////////////////////////////////
 bool Scanner::InProgrammingMode() const noexcept
 {
@@ -179,27 +488,35 @@ bool Scanner::InProgrammingMode() const noexcept
 //////////////////////////////////////////////////////////////////////////
 void Scanner::EnterProgrammingMode() const
 {
-	assert(m_inProgrammingMode == false);
-	Logger::GetInstance().Debug() << "Entering programming mode";
+	assert(m_impl->sessionOwner != std::this_thread::get_id() && "programming mode is entered twice");
+	std::unique_lock<std::mutex> session(m_impl->session);
+	KVASIR_LOG(DEBUG) << "Entering programming mode";
 
 	const auto result = IssueCommand("PRG\r", 1);
 	if ("OK" != result.front())
 		throw std::runtime_error("failed to enter programming mode: " + result.front());
 	
+	session.release();
+	m_impl->sessionOwner = std::this_thread::get_id();
 	const_cast<bool&>(m_inProgrammingMode) = true;
 }
 
 //////////////////////////////////////////////////////////////////////////
 void Scanner::ExitProgrammingMode() const
 {
-	assert(m_inProgrammingMode == true);
-	Logger::GetInstance().Debug() << "Leaving programming mode";
+	// Nothing to leave if the session has failed to start or is over
+	if (m_impl->sessionOwner != std::this_thread::get_id())
+		return;
+
+	// Other sessions wait until the radio has left programming mode
+	std::unique_lock<std::mutex> session(m_impl->session, std::adopt_lock);
+	m_impl->sessionOwner = std::thread::id();
+	const_cast<bool&>(m_inProgrammingMode) = false;
+	KVASIR_LOG(DEBUG) << "Leaving programming mode";
 
 	const auto result = IssueCommand("EPG\r", 1);
 	if ("OK" != result.front())
 		throw std::runtime_error("failed to exit programming mode: " + result.front());
-
-	const_cast<bool&>(m_inProgrammingMode) = false;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -215,29 +532,20 @@ std::string Scanner::GetFirmwareVersion() const
 }
 
 //////////////////////////////////////////////////////////////////////////
-Modulation ModFromString(const std::string& mod)
+ReceptionStatus Scanner::GetReceptionStatus(const ScanSettings& settings) const
 {
-	if ("AM" == mod)
-		return Modulation::AM;
-	else if ("FM" == mod)
-		return Modulation::FM;
-	else if ("NFM" == mod)
-		return Modulation::NFM;
-	else if ("WFM" == mod)
-		return Modulation::WFM;
-	else if ("FMB" == mod)
-		return Modulation::FMB;
-
-	Logger::GetInstance().Debug() << "unknown modulation: " << mod;
-	return Modulation::None;
+	return DecodeReceptionStatus(Submit("GLG\r", CommandPriority::Monitoring).get(), settings);
 }
 
 //////////////////////////////////////////////////////////////////////////
-ReceptionStatus Scanner::GetReceptionStatus() const
+ReceptionStatus Scanner::DecodeReceptionStatus(const RawReply& reply, const ScanSettings& settings)
 {
-	const auto result = IssueCommand("GLG\r", 12);		
+	const auto result = ParseReply("GLG", reply.text, 12);
 
+	// The radio has taken the status somewhere within the round trip: the
+	// smoothed estimate keeps a slow wakeup of the reader from skewing it
 	ReceptionStatus status{};
+	status.time = reply.received - std::min(reply.roundTrip, reply.smoothedRoundTrip) / 2;
 	if (result.front().empty())
 		return status;
 
@@ -245,10 +553,11 @@ ReceptionStatus Scanner::GetReceptionStatus() const
 	const auto& channelTag = result[10];
 	const auto& p25nac = result[11];
 
-	status.freq = result.front();	
+	// A talk group ID is shown in the format of its system
+	status.freq = ParseFreqOrTgid(result.front(), settings.TalkGroupFormat(result[4]));
 	status.mod = ModFromString(result[1]);
 	status.att = static_cast<bool>(std::stoi(result[2]));
-	status.code = static_cast<CtcssDcsCode>(std::stoi(result[3]));
+	status.code = CtcssDcsFromNumber(static_cast<unsigned int>(std::stoi(result[3])));
 	status.site = result[4];
 	status.group = result[5];
 	status.channel = result[6];
@@ -7,8 +7,13 @@
 #ifndef KVASIR_SCANNER_H_INCLUDED
 #define KVASIR_SCANNER_H_INCLUDED
 
+#include <functional>
+#include <exception>
+#include <chrono>
+#include <future>
 #include <memory>
 #include <vector>
+#include "timebase.h"
 #include "uniden.h"
 
 namespace kvasir
@@ -16,7 +21,52 @@ namespace kvasir
 
 // Forward declaration of device settings
 struct Device;
+class SerialTransport;
+class ScanSettings;
 
+//////////////////////////////////////////////////////////////////////////
+/// Reply of the radio as read from the link
+//////////////////////////////////////////////////////////////////////////
+struct RawReply
+{
+	std::string text;                       // Without the terminating '\r'
+	Timestamp received;
+	Clock::duration roundTrip;              // Of this transaction
+	Clock::duration smoothedRoundTrip;      // Over the recent transactions
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Scheduling class of a command: the queued commands of a higher class
+///   go to the radio first, one at a time, so the commands of a lower
+///   class yield to them between the transactions.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+enum class CommandPriority
+{
+	Interactive,                            // The operator is waiting
+	Monitoring,                             // Reception status polls
+	Bulk                                    // Memory dumps, record by record
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Implementation of the serial port
+//////////////////////////////////////////////////////////////////////////
+enum class SerialBackend
+{
+	Qt,                                     // QSerialPort, on any system
+	Native                                  // The tty device in epoll, Linux only
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Controller of the radio. The link is owned by the scanner's I/O
+///   thread: commands from any thread are queued to it and run one at a
+///   time, the replies are parsed on the calling threads. Monitoring
+///   commands wait while the radio is in programming mode, where they
+///   would be refused.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
 class Scanner
 {
 	struct Impl;
@@ -25,23 +75,115 @@ class Scanner
 
 public:
 	using Response = std::vector<std::string>;
+	using ReplyHandler = std::function<void(RawReply reply, std::exception_ptr error)>;
+	using TransportFactory = std::function<std::unique_ptr<SerialTransport>()>;
 
 	Scanner();
 	~Scanner();
 
-	void Connect(const Device& device);
+	//////////////////////////////////////////////////////////////////////////
+	/// Open the serial port of the device
+	//////////////////////////////////////////////////////////////////////////
+	void Connect(const Device& device, SerialBackend backend = SerialBackend::Qt);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Talk to the radio over the given link (capture replay, for instance)
+	//////////////////////////////////////////////////////////////////////////
+	void Connect(std::unique_ptr<SerialTransport> transport);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Open the link on the I/O thread, for the links bound to their thread
+	//////////////////////////////////////////////////////////////////////////
+	void Connect(TransportFactory open);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Close the link, also the one already lost, if any
+	//////////////////////////////////////////////////////////////////////////
 	void Disconnect();
+	bool IsConnected() const noexcept;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Record all the traffic in both directions into the capture file
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void StartCapture(const std::string& path);
+	void StopCapture();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Queue the command to the I/O thread. The handler is called on that
+	///   thread with the reply or the error and must be quick: hand the
+	///   reply over to another thread for the processing.
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void Post(std::string command, ReplyHandler handler,
+		CommandPriority priority = CommandPriority::Interactive) const;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Queue the command to the I/O thread, the reply comes via the future
+	//////////////////////////////////////////////////////////////////////////
+	std::future<RawReply> Submit(std::string command,
+		CommandPriority priority = CommandPriority::Interactive) const;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Wait until all the commands queued so far are done, including the
+	///   monitoring ones held in programming mode
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	void Sync() const;
 
-	Response IssueCommand(const std::string& command, size_t responseSize) const;
+	//////////////////////////////////////////////////////////////////////////
+	/// Run the command and wait for the reply
+	//////////////////////////////////////////////////////////////////////////
+	Response IssueCommand(const std::string& command, size_t responseSize,
+		CommandPriority priority = CommandPriority::Interactive) const;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Check the reply to the command and split it into values
+	/// </summary>
+	///
+	/// <param name="command"> Command the reply is to </param>
+	/// <param name="reply"> Reply text </param>
+	/// <param name="responseSize"> Expected number of values </param>
+	//////////////////////////////////////////////////////////////////////////
+	static Response ParseReply(const std::string& command, const std::string& reply, size_t responseSize);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Decode the reply to GLG
+	/// </summary>
+	///
+	/// <param name="reply"> Reply of the radio </param>
+	/// <param name="settings"> Scan settings the ID format of the reported system is taken from </param>
+	//////////////////////////////////////////////////////////////////////////
+	static ReceptionStatus DecodeReceptionStatus(const RawReply& reply, const ScanSettings& settings);
+
+	std::chrono::steady_clock::duration RoundTripTime() const noexcept;
 	bool InProgrammingMode() const noexcept;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Programming mode is a session of the calling thread: sessions of
+	///   the other threads wait until it's over. Leaving ends the session
+	///   even if the radio doesn't confirm it.
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
 	void EnterProgrammingMode() const;
 	void ExitProgrammingMode() const;
 
 	std::string GetModel() const;
 	std::string GetFirmwareVersion() const;
-	ReceptionStatus GetReceptionStatus() const;	
+	ReceptionStatus GetReceptionStatus(const ScanSettings& settings) const;
 };
 
+//////////////////////////////////////////////////////////////////////////
+/// Values of the comma separated response
+//////////////////////////////////////////////////////////////////////////
+std::vector<std::string> SplitString(const std::string& str);
+
 } // namespace kvasir
 
 #endif // KVASIR_SCANNER_H_INCLUDED
\ No newline at end of file
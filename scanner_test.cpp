@@ -0,0 +1,225 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: scanner_test.cpp
+///
+/// summary: scheduling of the scanner's command queues
+//////////////////////////////////////////////////////////////////////////
+
+#include "scanner.h"
+#include "scan_settings.h"
+#include "group.h"
+#include "serial_transport.h"
+
+#include <stdexcept>
+#include <iostream>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace
+{
+
+int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////
+void Check(bool condition, const std::string& what)
+{
+	if (condition)
+		return;
+	std::cerr << "FAILED: " << what << std::endl;
+	++failures;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Radio answering PRG and EPG with OK and refusing the rest with NG
+//////////////////////////////////////////////////////////////////////////
+class FakeRadio : public kvasir::SerialTransport
+{
+	std::string m_reply;
+	bool m_open = true;
+
+public:
+	void Write(const char* data, size_t size) override
+	{
+		const std::string command(data, size < 3 ? size : 3);
+		m_reply = command + ("PRG" == command || "EPG" == command ? ",OK\r" : ",NG\r");
+	}
+
+	size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds) override
+	{
+		const size_t size = m_reply.copy(buffer, capacity);
+		m_reply.erase(0, size);
+		return size;
+	}
+
+	bool IsOpen() const noexcept override
+	{
+		return m_open;
+	}
+
+	void Close() override
+	{
+		m_open = false;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Radio answering from the given replies, keyed by the command
+//////////////////////////////////////////////////////////////////////////
+class MemoryRadio : public kvasir::SerialTransport
+{
+	std::map<std::string, std::string> m_replies;
+	std::string m_reply;
+
+public:
+	void Add(const std::string& command, const std::string& reply)
+	{
+		m_replies[command + '\r'] = reply + '\r';
+	}
+
+	void Write(const char* data, size_t size) override
+	{
+		const auto found = m_replies.find(std::string(data, size));
+		m_reply = found != m_replies.end() ? found->second : std::string(data, size < 3 ? size : 3) + ",NG\r";
+	}
+
+	size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds) override
+	{
+		const size_t size = m_reply.copy(buffer, capacity);
+		m_reply.erase(0, size);
+		return size;
+	}
+
+	bool IsOpen() const noexcept override
+	{
+		return true;
+	}
+
+	void Close() override
+	{}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Reply with the comma separated values
+//////////////////////////////////////////////////////////////////////////
+std::string Reply(const std::string& command, const std::vector<std::string>& values)
+{
+	std::string reply = command;
+	for (const auto& value : values)
+		reply += ',' + value;
+	return reply;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   A talk group ID is decoded in the format its system is set to: the
+///   same digits are a hex ID on a Motorola system showing hex IDs
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+void TestTalkGroupFormat()
+{
+	auto radio = std::make_unique<MemoryRadio>();
+	radio->Add("PRG", "PRG,OK");
+	radio->Add("EPG", "EPG,OK");
+	radio->Add("SCT", "SCT,2");
+	radio->Add("SIH", "SIH,1");
+	radio->Add("SIT", "SIT,2");
+
+	std::vector<std::string> sin(28);
+	sin[0] = "MOT";
+	sin[1] = "County";
+	sin[11] = "-1";
+	sin[12] = "2";
+	sin[15] = "1";
+	radio->Add("SIN, 1", Reply("SIN", sin));
+	sin[0] = "P25S";
+	sin[1] = "State";
+	sin[11] = "1";
+	sin[12] = "-1";
+	sin[15] = "2";
+	radio->Add("SIN, 2", Reply("SIN", sin));
+
+	std::vector<std::string> trn(29, "0");
+	trn[kvasir::Offset(kvasir::TRN::MotorolaId)] = "1";
+	radio->Add("TRN,1", Reply("TRN", trn));
+	trn[kvasir::Offset(kvasir::TRN::MotorolaId)] = "0";
+	radio->Add("TRN,2", Reply("TRN", trn));
+
+	kvasir::Scanner scanner;
+	scanner.Connect(std::move(radio));
+	kvasir::ScanSettings settings;
+	settings.Load(scanner);
+	Check(settings.Systems().size() == 2, "systems are loaded");
+	Check(settings.TalkGroupFormat("County") == kvasir::IdFormat::Hex, "hex IDs of the Motorola system");
+	Check(settings.TalkGroupFormat("State") == kvasir::IdFormat::Decimal, "decimal IDs of the P25 system");
+
+	kvasir::RawReply reply;
+	reply.text = "GLG,1234,FM,0,0,County,Police,Patrol,1,0,NONE,NONE,NONE";
+	Check(kvasir::Scanner::DecodeReceptionStatus(reply, settings).freq.value == 0x1234, "hex ID is decoded as hex");
+	reply.text = "GLG,1234,FM,0,0,State,Police,Patrol,1,0,NONE,NONE,NONE";
+	Check(kvasir::Scanner::DecodeReceptionStatus(reply, settings).freq.value == 1234, "decimal ID is decoded as decimal");
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Reply cut short on the link is refused, not read past its end
+//////////////////////////////////////////////////////////////////////////
+void TestShortReply()
+{
+	for (const std::string reply : { "GLG", "GLG,", "GL" })
+	{
+		bool refused = false;
+		try
+		{
+			kvasir::Scanner::ParseReply("GLG", reply, 12);
+		}
+		catch (const std::runtime_error&)
+		{
+			refused = true;
+		}
+		Check(refused, "short reply \"" + reply + "\" is refused");
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   The monitoring commands are held in programming mode: Sync() has to
+///   let them through rather than wait for the end of the session
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+void TestSyncInProgrammingMode()
+{
+	kvasir::Scanner scanner;
+	scanner.Connect(std::make_unique<FakeRadio>());
+	scanner.EnterProgrammingMode();
+
+	std::promise<std::string> polled;
+	scanner.Post("GLG\r", [&polled](kvasir::RawReply reply, std::exception_ptr) {
+		polled.set_value(reply.text);
+	}, kvasir::CommandPriority::Monitoring);
+
+	auto synced = std::async(std::launch::async, [&scanner] { scanner.Sync(); });
+	if (synced.wait_for(std::chrono::seconds(5)) != std::future_status::ready)
+	{
+		// The scanner can't be destroyed with the I/O thread stuck
+		std::cerr << "FAILED: Sync() hangs in programming mode" << std::endl;
+		std::_Exit(EXIT_FAILURE);
+	}
+	Check(polled.get_future().get() == "GLG,NG", "held poll is sent by Sync()");
+	Check(scanner.InProgrammingMode(), "programming mode outlives Sync()");
+	scanner.ExitProgrammingMode();
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+int main()
+{
+	TestShortReply();
+	TestSyncInProgrammingMode();
+	TestTalkGroupFormat();
+
+	if (failures)
+		std::cerr << failures << " checks failed" << std::endl;
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
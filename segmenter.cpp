@@ -0,0 +1,105 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: segmenter.cpp
+///
+/// summary: silence trimming and splitting of recordings into transmissions
+//////////////////////////////////////////////////////////////////////////
+
+#include "segmenter.h"
+#include "energy_squelch.h"
+
+#include <algorithm>
+
+namespace kvasir
+{
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+void AddSegment(std::vector<Segment>& segments, Segment segment)
+{
+	if (!segments.empty())
+	{
+		Segment& prev = segments.back();
+		if (prev.end >= segment.begin && SameTransmission(prev.status, segment.status))
+		{
+			prev.end = std::max(prev.end, segment.end);
+			return;
+		}
+	}
+
+	segments.emplace_back(std::move(segment));
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+std::vector<Segment> SegmentRecording(const std::vector<int16_t>& samples, unsigned int sampleRate,
+	const std::vector<StatusMark>& marks, const SegmenterSettings& settings)
+{
+	std::vector<Segment> result;
+	if (samples.empty() || marks.empty())
+		return result;
+
+	const size_t blockSize = std::max<size_t>(static_cast<size_t>(sampleRate) * settings.blockMs / 1000, 1);
+	const size_t padding = static_cast<size_t>(sampleRate) * settings.paddingMs / 1000;
+	const size_t minSpeech = static_cast<size_t>(sampleRate) * settings.minSpeechMs / 1000;
+	const double level = MeanSquareFromDbfs(settings.speechDbfs);
+
+	// Energy envelope: one speech flag per block
+	const size_t blockCount = (samples.size() + blockSize - 1) / blockSize;
+	std::vector<uint8_t> speech(blockCount);
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		const size_t begin = block * blockSize;
+		const size_t length = std::min(blockSize, samples.size() - begin);
+		speech[block] = SumOfSquares(&samples[begin], length) >= level * length;
+	}
+
+	for (size_t mark = 0; mark < marks.size(); ++mark)
+	{
+		const size_t first = std::min(marks[mark].sample, samples.size());
+		const size_t last = mark + 1 < marks.size()
+			? std::min(marks[mark + 1].sample, samples.size())
+			: samples.size();
+		if (first >= last)
+			continue;
+
+		// Speech runs separated by less than two paddings are one segment
+		bool inRun = false;
+		size_t runBegin = 0;
+		size_t runEnd = 0;
+		const auto flush = [&]()
+		{
+			if (inRun && runEnd - runBegin >= minSpeech)
+			{
+				const size_t begin = runBegin - std::min(runBegin - first, padding);
+				const size_t end = std::min(runEnd + padding, last);
+				AddSegment(result, Segment{ begin, end, marks[mark].status });
+			}
+			inRun = false;
+		};
+
+		for (size_t block = first / blockSize; block * blockSize < last; ++block)
+		{
+			if (!speech[block])
+				continue;
+
+			const size_t begin = std::max(block * blockSize, first);
+			const size_t end = std::min((block + 1) * blockSize, last);
+			if (inRun && begin - runEnd > 2 * padding)
+				flush();
+			if (!inRun)
+			{
+				inRun = true;
+				runBegin = begin;
+			}
+			runEnd = end;
+		}
+		flush();
+	}
+
+	return result;
+}
+
+} // namespace kvasir
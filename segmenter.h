@@ -0,0 +1,63 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: segmenter.h
+///
+/// summary: silence trimming and splitting of recordings into transmissions
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_SEGMENTER_H_INCLUDED
+#define KVASIR_SEGMENTER_H_INCLUDED
+
+#include "uniden.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+struct SegmenterSettings
+{
+	double speechDbfs = -45.0;               // Energy level of the speech
+	unsigned int blockMs = 10;               // Resolution of the energy envelope
+	unsigned int paddingMs = 250;            // Audio kept around the speech
+	unsigned int minSpeechMs = 30;           // Shorter bursts are treated as clicks
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Reception status that is in effect from the given sample on
+//////////////////////////////////////////////////////////////////////////
+struct StatusMark
+{
+	size_t sample;
+	ReceptionStatus status;
+};
+
+//////////////////////////////////////////////////////////////////////////
+struct Segment
+{
+	size_t begin;                            // First sample of the segment
+	size_t end;                              // Past the last sample of the segment
+	ReceptionStatus status;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Split the recording into speech segments. Dead air farther than the
+///   padding from the speech is dropped. Segments never cross status
+///   marks: each one belongs to a single transmission and carries its
+///   status; neighbours of the same transmission are joined back.
+/// </summary>
+///
+/// <param name="samples"> Recorded audio </param>
+/// <param name="sampleRate"> Sample rate of the audio, Hz </param>
+/// <param name="marks"> Status transitions, sorted, the first one at 0 </param>
+/// <param name="settings"> Segmentation settings </param>
+//////////////////////////////////////////////////////////////////////////
+std::vector<Segment> SegmentRecording(const std::vector<int16_t>& samples, unsigned int sampleRate,
+	const std::vector<StatusMark>& marks, const SegmenterSettings& settings);
+
+} // namespace kvasir
+
+#endif // KVASIR_SEGMENTER_H_INCLUDED
@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: serial_capture.cpp
+///
+/// summary: recording of the raw serial traffic into the capture files
+//////////////////////////////////////////////////////////////////////////
+
+#include "serial_capture.h"
+#include "ring_buffer.h"
+#include "logger.h"
+
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <iterator>
+#include <fstream>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <mutex>
+
+namespace kvasir
+{
+
+namespace
+{
+
+// Direction, time, length
+constexpr size_t RecordHeaderSize = 1 + sizeof(uint64_t) + sizeof(uint32_t);
+
+// Period of moving the captured bytes into the file
+constexpr std::chrono::milliseconds FlushInterval(100);
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+struct SerialCapture::Impl
+{
+	std::ofstream file;
+	RingBuffer<char> buffer;
+	const std::chrono::steady_clock::time_point start;
+	uint32_t lost = 0;                      // Not yet reported, producer side
+
+	std::thread writer;
+	std::mutex wakeLock;
+	std::condition_variable wake;
+	bool stop = false;
+
+	Impl(const std::string& path, size_t bufferSize)
+		: file(path, std::ios::binary | std::ios::trunc)
+		, buffer(bufferSize)
+		, start(std::chrono::steady_clock::now())
+	{
+		if (!file.is_open())
+			throw std::runtime_error("failed to open capture file \"" + path + "\" for writing");
+
+		const uint64_t wallTime = static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count());
+		file.write(capture_format::Magic, sizeof(capture_format::Magic));
+		file.write(reinterpret_cast<const char*>(&wallTime), sizeof(wallTime));
+
+		writer = std::thread([this] { Run(); });
+	}
+
+	~Impl()
+	{
+		{
+			std::lock_guard<std::mutex> lock(wakeLock);
+			stop = true;
+		}
+		wake.notify_one();
+		writer.join();
+		Drain();
+	}
+
+	bool Put(CaptureDirection direction, uint64_t time, uint32_t length, const char* data, size_t size)
+	{
+		if (buffer.Capacity() - buffer.Available() < RecordHeaderSize + size)
+			return false;
+
+		char header[RecordHeaderSize];
+		header[0] = static_cast<char>(direction);
+		std::memcpy(header + 1, &time, sizeof(time));
+		std::memcpy(header + 1 + sizeof(time), &length, sizeof(length));
+		buffer.Write(header, sizeof(header));
+		if (size)
+			buffer.Write(data, size);
+		return true;
+	}
+
+	void Drain()
+	{
+		char chunk[16 * 1024];
+		while (const size_t size = buffer.Read(chunk, sizeof(chunk)))
+			file.write(chunk, static_cast<std::streamsize>(size));
+		file.flush();
+	}
+
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(wakeLock);
+		while (!stop)
+		{
+			wake.wait_for(lock, FlushInterval, [this] { return stop; });
+			lock.unlock();
+			Drain();
+			lock.lock();
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+SerialCapture::SerialCapture(const std::string& path, size_t bufferSize)
+	: m_impl(std::make_unique<Impl>(path, bufferSize))
+{
+	KVASIR_LOG(DEBUG) << "capturing serial traffic into " << path;
+}
+
+//////////////////////////////////////////////////////////////////////////
+SerialCapture::~SerialCapture() = default;
+
+//////////////////////////////////////////////////////////////////////////
+void SerialCapture::Record(CaptureDirection direction, const char* data, size_t size) noexcept
+{
+	const uint64_t time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - m_impl->start).count());
+
+	// Records are kept whole: the lost bytes are reported before the next
+	// record which fits
+	if (m_impl->lost)
+	{
+		if (!m_impl->Put(CaptureDirection::Lost, time, m_impl->lost, nullptr, 0))
+		{
+			m_impl->lost += static_cast<uint32_t>(size);
+			return;
+		}
+		m_impl->lost = 0;
+	}
+
+	if (!m_impl->Put(direction, time, static_cast<uint32_t>(size), data, size))
+		m_impl->lost += static_cast<uint32_t>(size);
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::vector<CaptureRecord> LoadCapture(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open capture file \"" + path + "\"");
+	const std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	const size_t headerSize = sizeof(capture_format::Magic) + sizeof(uint64_t);
+	if (data.size() < headerSize ||
+		!std::equal(std::begin(capture_format::Magic), std::end(capture_format::Magic), data.cbegin()))
+	{
+		throw std::runtime_error("\"" + path + "\" is not a serial capture file");
+	}
+
+	std::vector<CaptureRecord> records;
+	size_t pos = headerSize;
+	while (data.size() - pos >= RecordHeaderSize)
+	{
+		CaptureRecord record{};
+		record.direction = static_cast<CaptureDirection>(data[pos]);
+		uint32_t length;
+		std::memcpy(&record.time, &data[pos + 1], sizeof(record.time));
+		std::memcpy(&length, &data[pos + 1 + sizeof(record.time)], sizeof(length));
+		pos += RecordHeaderSize;
+
+		if (CaptureDirection::Lost == record.direction)
+		{
+			record.lost = length;
+		}
+		else
+		{
+			if (data.size() - pos < length)
+				break;
+			record.data.assign(&data[pos], length);
+			pos += length;
+		}
+		records.push_back(std::move(record));
+	}
+
+	return records;
+}
+
+} // namespace kvasir
@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: serial_capture.h
+///
+/// summary: recording of the raw serial traffic into the capture files
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_SERIAL_CAPTURE_H_INCLUDED
+#define KVASIR_SERIAL_CAPTURE_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Layout of the capture file. All the numbers are in the host byte
+///   order.
+///
+///   Header:  "KVCAP001", u64 system clock ns at the start of the capture
+///   Records: u8 direction, u64 us since the start, u32 length, bytes
+///            (no bytes for the lost data: length is the number of them)
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+namespace capture_format
+{
+
+constexpr char Magic[8] = { 'K', 'V', 'C', 'A', 'P', '0', '0', '1' };
+
+} // namespace capture_format
+
+//////////////////////////////////////////////////////////////////////////
+enum class CaptureDirection : uint8_t
+{
+	ToRadio = 0,
+	FromRadio = 1,
+	Lost = 2                                // The capture buffer overflowed
+};
+
+//////////////////////////////////////////////////////////////////////////
+struct CaptureRecord
+{
+	CaptureDirection direction;
+	uint64_t time;                          // Since the start of the capture, us
+	std::string data;                       // Empty for the lost data
+	uint32_t lost;                          // Number of the lost bytes
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Records the traffic of the single serial link. The calling thread
+///   only copies bytes into the ring buffer, the background thread puts
+///   them into the file. What does not fit into the buffer is counted and
+///   marked as lost in the capture.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class SerialCapture
+{
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// <param name="path"> Path to the capture file, overwritten if exists </param>
+	/// <param name="bufferSize"> Size of the ring buffer, bytes </param>
+	//////////////////////////////////////////////////////////////////////////
+	explicit SerialCapture(const std::string& path, size_t bufferSize = 1 << 20);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Writes out the buffered traffic and closes the file
+	//////////////////////////////////////////////////////////////////////////
+	~SerialCapture();
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Called by one thread only: the one talking to the radio
+	//////////////////////////////////////////////////////////////////////////
+	void Record(CaptureDirection direction, const char* data, size_t size) noexcept;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Read the whole capture file. A truncated record at the end (the
+///   process died while capturing) is ignored.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+std::vector<CaptureRecord> LoadCapture(const std::string& path);
+
+} // namespace kvasir
+
+#endif // KVASIR_SERIAL_CAPTURE_H_INCLUDED
@@ -0,0 +1,126 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: serial_replay.cpp
+///
+/// summary: replay of the captured serial traffic in place of the radio
+//////////////////////////////////////////////////////////////////////////
+
+#include "serial_replay.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+ReplayTransport::ReplayTransport(const std::string& capturePath, ReplaySpeed speed)
+	: m_records(LoadCapture(capturePath))
+	, m_speed(speed)
+{
+	Logger::GetInstance().Info() << "replaying " << m_records.size() << " records of " << capturePath
+		<< (ReplaySpeed::Realtime == speed ? " in real time" : " at max speed");
+}
+
+//////////////////////////////////////////////////////////////////////////
+void ReplayTransport::Write(const char* data, size_t size)
+{
+	if (!m_open)
+		throw std::runtime_error("replay is over");
+
+	const std::string_view command(data, size);
+	const auto found = std::find_if(m_records.cbegin() + m_next, m_records.cend(),
+		[command](const CaptureRecord& record)
+		{
+			return CaptureDirection::ToRadio == record.direction && record.data == command;
+		});
+
+	if (found == m_records.cend())
+	{
+		// Nothing more the capture can answer
+		Close();
+		throw std::runtime_error("command " + std::string(command.substr(0, 3)) + " is not in the rest of the capture");
+	}
+
+	const size_t index = static_cast<size_t>(found - m_records.cbegin());
+	const size_t skipped = static_cast<size_t>(std::count_if(m_records.cbegin() + m_next, found,
+		[](const CaptureRecord& record) { return CaptureDirection::ToRadio == record.direction; }));
+	if (skipped)
+	{
+		m_skipped += skipped;
+		KVASIR_LOG(DEBUG) << skipped << " captured commands are skipped, " << m_skipped << " in total";
+	}
+
+	m_next = index + 1;
+	m_offset = 0;
+	m_commandTime = found->time;
+	m_written = std::chrono::steady_clock::now();
+}
+
+//////////////////////////////////////////////////////////////////////////
+size_t ReplayTransport::Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout)
+{
+	if (!m_open)
+		throw std::runtime_error("replay is over");
+
+	// Lost pieces of the capture can't be played
+	while (m_next < m_records.size() && CaptureDirection::Lost == m_records[m_next].direction)
+	{
+		KVASIR_LOG(DEBUG) << m_records[m_next].lost << " bytes are lost in the capture";
+		++m_next;
+	}
+
+	if (m_next == m_records.size())
+	{
+		Close();
+		throw std::runtime_error("end of the capture");
+	}
+
+	const CaptureRecord& record = m_records[m_next];
+	const bool reply = CaptureDirection::FromRadio == record.direction;
+	if (ReplaySpeed::Realtime == m_speed)
+	{
+		// The radio's bytes come with the captured delay after the command,
+		// no reply in the capture means the radio kept silent
+		const auto due = m_written + std::chrono::microseconds(record.time - m_commandTime);
+		const auto deadline = std::chrono::steady_clock::now() + timeout;
+		if (!reply || due > deadline)
+		{
+			std::this_thread::sleep_until(deadline);
+			return 0;
+		}
+		std::this_thread::sleep_until(due);
+	}
+	else if (!reply)
+	{
+		return 0;
+	}
+
+	const size_t size = std::min(capacity, record.data.size() - m_offset);
+	std::memcpy(buffer, record.data.data() + m_offset, size);
+	m_offset += size;
+	if (m_offset == record.data.size())
+	{
+		++m_next;
+		m_offset = 0;
+	}
+	return size;
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool ReplayTransport::IsOpen() const noexcept
+{
+	return m_open;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void ReplayTransport::Close()
+{
+	if (m_open)
+		Logger::GetInstance().Info() << "replay is over, " << m_skipped << " captured commands were skipped";
+	m_open = false;
+}
+
+} // namespace kvasir
@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: serial_replay.h
+///
+/// summary: replay of the captured serial traffic in place of the radio
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_SERIAL_REPLAY_H_INCLUDED
+#define KVASIR_SERIAL_REPLAY_H_INCLUDED
+
+#include "serial_transport.h"
+#include "serial_capture.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+enum class ReplaySpeed
+{
+	Realtime,                               // Replies come with the captured delays
+	Maximum                                 // Replies come at once
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Plays the radio's part of the capture back. Each command written is
+///   looked up among the captured ones from the current position on and
+///   the radio's bytes which followed it become available for reading.
+///   The link closes when the capture is over.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class ReplayTransport : public SerialTransport
+{
+	std::vector<CaptureRecord> m_records;
+	const ReplaySpeed m_speed;
+	size_t m_next = 0;                      // Next record to match or play
+	size_t m_offset = 0;                    // Bytes of the next record already read
+	uint64_t m_commandTime = 0;             // Captured time of the last matched command, us
+	std::chrono::steady_clock::time_point m_written;
+	size_t m_skipped = 0;                   // Captured commands never issued
+	bool m_open = true;
+
+public:
+	ReplayTransport(const std::string& capturePath, ReplaySpeed speed);
+
+	void Write(const char* data, size_t size) override;
+	size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout) override;
+	bool IsOpen() const noexcept override;
+	void Close() override;
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_SERIAL_REPLAY_H_INCLUDED
@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: serial_transport.h
+///
+/// summary: byte stream link between the scanner controller and the radio
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_SERIAL_TRANSPORT_H_INCLUDED
+#define KVASIR_SERIAL_TRANSPORT_H_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Blocking byte stream to the radio: the serial port itself or a
+///   stand-in for it (capture replay). Used by one thread at a time.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class SerialTransport
+{
+public:
+	virtual ~SerialTransport() = default;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Send all the bytes, throws std::runtime_error on failure
+	//////////////////////////////////////////////////////////////////////////
+	virtual void Write(const char* data, size_t size) = 0;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Wait for the incoming bytes and take what has arrived
+	/// </summary>
+	///
+	/// <param name="buffer"> Buffer for the bytes </param>
+	/// <param name="capacity"> Size of the buffer </param>
+	/// <param name="timeout"> Max time to wait for the first byte </param>
+	/// <returns> Number of bytes read, 0 on timeout </returns>
+	//////////////////////////////////////////////////////////////////////////
+	virtual size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout) = 0;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// False once the link is lost
+	//////////////////////////////////////////////////////////////////////////
+	virtual bool IsOpen() const noexcept = 0;
+
+	virtual void Close() = 0;
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_SERIAL_TRANSPORT_H_INCLUDED
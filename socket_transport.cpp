@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: socket_transport.cpp
+///
+/// summary: link to the radio shared by the kvasir daemon
+//////////////////////////////////////////////////////////////////////////
+
+#include "socket_transport.h"
+
+#include <QtNetwork/QHostAddress>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace kvasir
+{
+
+namespace
+{
+
+// The daemon is local: it accepts at once or not at all
+constexpr int ConnectTimeout = 3000;
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+bool ParseLoopbackPort(const std::string& address, uint16_t& port)
+{
+	if (address.empty() || address.size() > 5 ||
+		!std::all_of(address.cbegin(), address.cend(), [](char c) { return c >= '0' && c <= '9'; }))
+		return false;
+
+	const unsigned long value = std::stoul(address);
+	if (!value || value > 65535)
+		return false;
+	port = static_cast<uint16_t>(value);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+SocketTransport::SocketTransport(const std::string& address)
+{
+	uint16_t port = 0;
+	bool connected = false;
+	if (ParseLoopbackPort(address, port))
+	{
+		m_tcp = std::make_unique<QTcpSocket>();
+		m_tcp->connectToHost(QHostAddress(QHostAddress::LocalHost), port);
+		connected = m_tcp->waitForConnected(ConnectTimeout);
+		m_socket = m_tcp.get();
+	}
+	else
+	{
+		m_local = std::make_unique<QLocalSocket>();
+		m_local->connectToServer(QString::fromStdString(address));
+		connected = m_local->waitForConnected(ConnectTimeout);
+		m_socket = m_local.get();
+	}
+
+	if (!connected)
+	{
+		throw std::runtime_error("failed to connect to daemon at " + address + ": " +
+			m_socket->errorString().toStdString());
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+SocketTransport::~SocketTransport()
+{
+	if (IsOpen())
+	{
+		Close();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void SocketTransport::Write(const char* data, size_t size)
+{
+	// There is no event loop on the scanner's thread to send the bytes
+	if (m_socket->write(data, static_cast<qint64>(size)) != static_cast<qint64>(size) ||
+		!m_socket->waitForBytesWritten(ConnectTimeout))
+		throw std::runtime_error("failed to write to daemon: " + m_socket->errorString().toStdString());
+}
+
+//////////////////////////////////////////////////////////////////////////
+size_t SocketTransport::Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout)
+{
+	if (!m_socket->bytesAvailable() && !m_socket->waitForReadyRead(static_cast<int>(timeout.count())))
+		return 0;
+
+	const qint64 size = m_socket->read(buffer, static_cast<qint64>(capacity));
+	if (size < 0)
+		throw std::runtime_error("failed to read from daemon: " + m_socket->errorString().toStdString());
+	return static_cast<size_t>(size);
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool SocketTransport::IsOpen() const noexcept
+{
+	if (m_tcp)
+		return m_tcp->state() == QAbstractSocket::ConnectedState;
+	return m_local->state() == QLocalSocket::ConnectedState;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void SocketTransport::Close()
+{
+	if (m_tcp)
+		m_tcp->disconnectFromHost();
+	else
+		m_local->disconnectFromServer();
+	m_socket->close();
+}
+
+} // namespace kvasir
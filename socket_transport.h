@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: socket_transport.h
+///
+/// summary: link to the radio shared by the kvasir daemon
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_SOCKET_TRANSPORT_H_INCLUDED
+#define KVASIR_SOCKET_TRANSPORT_H_INCLUDED
+
+#include "serial_transport.h"
+
+#include <QtNetwork/QLocalSocket>
+#include <QtNetwork/QTcpSocket>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Daemon addresses are either a TCP port on the loopback interface
+///   or the name of a local socket (a Unix socket or a Windows pipe)
+/// </summary>
+///
+/// <returns> True and the port if the address is a port number </returns>
+//////////////////////////////////////////////////////////////////////////
+bool ParseLoopbackPort(const std::string& address, uint16_t& port);
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Link to the radio through the daemon owning its serial port. The
+///   daemon speaks the radio's protocol, so the link carries the same
+///   commands and replies as the serial port would.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class SocketTransport : public SerialTransport
+{
+	std::unique_ptr<QLocalSocket> m_local;
+	std::unique_ptr<QTcpSocket> m_tcp;
+	QIODevice* m_socket;
+
+public:
+	explicit SocketTransport(const std::string& address);
+	~SocketTransport();
+
+	void Write(const char* data, size_t size) override;
+	size_t Read(char* buffer, size_t capacity, std::chrono::milliseconds timeout) override;
+	bool IsOpen() const noexcept override;
+	void Close() override;
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_SOCKET_TRANSPORT_H_INCLUDED
@@ -0,0 +1,261 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: sweep.cpp
+///
+/// summary: band sweep mapping the activity on the air
+//////////////////////////////////////////////////////////////////////////
+
+#include "sweep.h"
+#include "scanner.h"
+#include "scan_settings.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace kvasir
+{
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Hold the radio on the frequency:
+///   QSH,FRQ,[RSV],MOD,ATT,DLY,[RSV],CODE_SRCH,BSC,REP,[RSV],[RSV],
+///   AGC_ANALOG,AGC_DIGITAL,P25WAITING with the frequency in 100 Hz units,
+///   no attenuation, delay, code search, broadcast screening nor AGC
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+std::string QuickSearchHold(uint64_t frequency, Modulation mod)
+{
+	// The radio tunes in 100 Hz units: the nearest one is taken
+	char freq[24];
+	std::snprintf(freq, sizeof(freq), "%08llu", static_cast<unsigned long long>((frequency + 50) / 100));
+	return std::string("QSH,").append(freq).append(",,").append(ModToString(mod))
+		.append(",0,0,,0,0000000000000000,0,,,0,0,0\r");
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Expect(const Scanner::Response& response, const std::string& command)
+{
+	if ("OK" != response.front())
+		throw std::runtime_error(command + " is refused: " + response.front());
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+void Occupancy::Merge(const Occupancy& other) noexcept
+{
+	visits += other.visits;
+	hits += other.hits;
+	samples += other.samples;
+	active += other.active;
+	levelSum += other.levelSum;
+	maxLevel = std::max(maxLevel, other.maxLevel);
+	lastHit = std::max(lastHit, other.lastHit);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void OccupancyMap::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+		return;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line.front() < '0' || line.front() > '9')
+			continue;
+
+		std::istringstream fields(line);
+		uint64_t frequency = 0;
+		Occupancy occupancy;
+		long long lastHit = 0;
+		char comma;
+		if (!(fields >> frequency >> comma >> occupancy.visits >> comma >> occupancy.hits >> comma >>
+			occupancy.samples >> comma >> occupancy.active >> comma >> occupancy.levelSum >> comma >>
+			occupancy.maxLevel >> comma >> lastHit))
+			throw std::runtime_error("invalid occupancy record in " + path + ": " + line);
+		occupancy.lastHit = static_cast<std::time_t>(lastHit);
+		Merge(frequency, occupancy);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+void OccupancyMap::Save(const std::string& path) const
+{
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::trunc);
+		if (!file.is_open())
+			throw std::runtime_error("failed to write occupancy file " + temporary);
+
+		file << "frequency_hz,visits,hits,samples,active,level_sum,max_level,last_hit\n";
+		for (const auto& entry : m_frequencies)
+		{
+			const Occupancy& o = entry.second;
+			file << entry.first << ',' << o.visits << ',' << o.hits << ',' << o.samples << ',' << o.active << ','
+				<< o.levelSum << ',' << o.maxLevel << ',' << static_cast<long long>(o.lastHit) << '\n';
+		}
+		if (!file.flush())
+			throw std::runtime_error("failed to write occupancy file " + temporary);
+	}
+
+	// Windows refuses to rename over an existing file
+	if (std::rename(temporary.c_str(), path.c_str()) &&
+		(std::remove(path.c_str()) || std::rename(temporary.c_str(), path.c_str())))
+		throw std::runtime_error("failed to replace occupancy file " + path);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void OccupancyMap::Merge(uint64_t frequency, const Occupancy& occupancy)
+{
+	m_frequencies[frequency].Merge(occupancy);
+}
+
+//////////////////////////////////////////////////////////////////////////
+const Occupancy* OccupancyMap::Find(uint64_t frequency) const
+{
+	const auto found = m_frequencies.find(frequency);
+	return found != m_frequencies.end() ? &found->second : nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::vector<std::pair<uint64_t, Occupancy>> OccupancyMap::Hottest(size_t count) const
+{
+	std::vector<std::pair<uint64_t, Occupancy>> result;
+	for (const auto& entry : m_frequencies)
+	{
+		if (entry.second.hits)
+			result.push_back(entry);
+	}
+
+	const auto byActivity = [](const std::pair<uint64_t, Occupancy>& lhs, const std::pair<uint64_t, Occupancy>& rhs) {
+		return lhs.second.Activity() > rhs.second.Activity();
+	};
+	const size_t size = std::min(count, result.size());
+	std::partial_sort(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(size), result.end(), byActivity);
+	result.resize(size);
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Sweeper::Sweeper(const Scanner& scanner, const ScanSettingsStore& scanSettings, const SweepSettings& settings)
+	: m_scanner(scanner)
+	, m_scanSettings(scanSettings)
+	, m_settings(settings)
+{}
+
+//////////////////////////////////////////////////////////////////////////
+std::vector<uint64_t> Sweeper::Order(const SweepRange& range, const OccupancyMap& map) const
+{
+	std::vector<uint64_t> known;
+	std::vector<uint64_t> rest;
+	for (uint64_t frequency = range.start; frequency <= range.stop; frequency += range.step)
+	{
+		const Occupancy* occupancy = map.Find(frequency);
+		if (occupancy && occupancy->hits)
+			known.push_back(frequency);
+		else
+			rest.push_back(frequency);
+	}
+
+	// A transmission seen before is likely to be caught again soon
+	std::stable_sort(known.begin(), known.end(), [&map](uint64_t lhs, uint64_t rhs) {
+		return map.Find(lhs)->Activity() > map.Find(rhs)->Activity();
+	});
+
+	// Small steps between the neighbours, no jump back to the band start
+	if (m_passes % 2)
+		std::reverse(rest.begin(), rest.end());
+
+	known.insert(known.end(), rest.cbegin(), rest.cend());
+	return known;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Occupancy Sweeper::Dwell(uint64_t frequency, Modulation mod) const
+{
+	const std::string tune = QuickSearchHold(frequency, mod);
+	Expect(m_scanner.IssueCommand(tune, 1, CommandPriority::Bulk), "QSH");
+	std::this_thread::sleep_for(m_settings.settle);
+
+	const ScanSettingsStore::Snapshot scanSettings = m_scanSettings.Current();
+	Occupancy occupancy;
+	occupancy.visits = 1;
+	const auto deadline = std::chrono::steady_clock::now() + m_settings.hitDwell;
+	unsigned int quiet = 0;
+	do
+	{
+		// Both go to the radio back to back
+		auto power = m_scanner.Submit("PWR\r", CommandPriority::Bulk);
+		auto status = m_scanner.Submit("GLG\r", CommandPriority::Bulk);
+		const Scanner::Response level = Scanner::ParseReply("PWR", power.get().text, 2);
+		const ReceptionStatus reception = Scanner::DecodeReceptionStatus(status.get(), *scanSettings);
+
+		const unsigned int value = static_cast<unsigned int>(std::stoul(level.front()));
+		++occupancy.samples;
+		if (value >= m_settings.threshold || reception.squelch)
+		{
+			++occupancy.active;
+			occupancy.levelSum += value;
+			occupancy.maxLevel = std::max(occupancy.maxLevel, value);
+			quiet = 0;
+		}
+		else
+		{
+			++quiet;
+		}
+	} while (occupancy.active && quiet < m_settings.quietSamples && std::chrono::steady_clock::now() < deadline);
+
+	if (occupancy.active)
+	{
+		occupancy.hits = 1;
+		occupancy.lastHit = std::time(nullptr);
+	}
+	return occupancy;
+}
+
+//////////////////////////////////////////////////////////////////////////
+SweepStats Sweeper::Run(const SweepRange& range, OccupancyMap& map, const std::atomic<bool>* stop)
+{
+	if (!range.step || range.stop < range.start)
+		throw std::invalid_argument("invalid sweep range");
+
+	const auto started = std::chrono::steady_clock::now();
+	SweepStats stats;
+	for (const uint64_t frequency : Order(range, map))
+	{
+		if (stop && *stop)
+			break;
+
+		const Occupancy occupancy = Dwell(frequency, range.mod);
+		map.Merge(frequency, occupancy);
+		++stats.steps;
+		stats.samples += occupancy.samples;
+		if (occupancy.hits)
+		{
+			++stats.hits;
+			KVASIR_LOG(DEBUG) << "carrier at " << frequency << " Hz, level " << occupancy.maxLevel;
+		}
+	}
+
+	++m_passes;
+	stats.duration = std::chrono::steady_clock::now() - started;
+	return stats;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Sweeper::Resume() const
+{
+	// Press the scan key
+	Expect(m_scanner.IssueCommand("KEY,S,P\r", 1), "KEY");
+}
+
+} // namespace kvasir
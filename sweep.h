@@ -0,0 +1,159 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: sweep.h
+///
+/// summary: band sweep mapping the activity on the air
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_SWEEP_H_INCLUDED
+#define KVASIR_SWEEP_H_INCLUDED
+
+#include "uniden.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace kvasir
+{
+
+class Scanner;
+class ScanSettingsStore;
+
+//////////////////////////////////////////////////////////////////////////
+/// Band to sweep, frequencies in Hz
+//////////////////////////////////////////////////////////////////////////
+struct SweepRange
+{
+	uint64_t start = 0;
+	uint64_t stop = 0;                      // Included if on the step grid
+	uint64_t step = 12500;
+	Modulation mod = Modulation::Auto;
+};
+
+//////////////////////////////////////////////////////////////////////////
+struct SweepSettings
+{
+	std::chrono::milliseconds settle{ 20 };     // From tuning to the first sample
+	std::chrono::milliseconds hitDwell{ 1000 }; // Max time on a step that is on air
+	unsigned int quietSamples = 3;              // Quiet samples ending the dwell early
+	unsigned int threshold = 150;               // Signal level of a carrier, 0-1023
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Activity seen on a frequency over all the sweeps
+//////////////////////////////////////////////////////////////////////////
+struct Occupancy
+{
+	uint64_t visits = 0;                    // Sweeps which sampled it
+	uint64_t hits = 0;                      // Visits with a carrier seen
+	uint64_t samples = 0;
+	uint64_t active = 0;                    // Samples with a carrier
+	uint64_t levelSum = 0;                  // Of the active samples
+	unsigned int maxLevel = 0;
+	std::time_t lastHit = 0;
+
+	double Activity() const noexcept
+	{
+		return samples ? static_cast<double>(active) / static_cast<double>(samples) : 0.0;
+	}
+
+	void Merge(const Occupancy& other) noexcept;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Occupancy of the frequencies accumulated over the sweeps, kept in a
+///   CSV file between the runs: each sweep adds its samples to the ones
+///   already there.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class OccupancyMap
+{
+	std::map<uint64_t, Occupancy> m_frequencies;
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// Add the file's contents, a missing file is an empty map
+	//////////////////////////////////////////////////////////////////////////
+	void Load(const std::string& path);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Replace the file with the map, written aside and renamed
+	//////////////////////////////////////////////////////////////////////////
+	void Save(const std::string& path) const;
+
+	void Merge(uint64_t frequency, const Occupancy& occupancy);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Occupancy of the frequency, nullptr if never sampled
+	//////////////////////////////////////////////////////////////////////////
+	const Occupancy* Find(uint64_t frequency) const;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Frequencies hit at least once, the most active first
+	//////////////////////////////////////////////////////////////////////////
+	std::vector<std::pair<uint64_t, Occupancy>> Hottest(size_t count) const;
+
+	size_t Size() const noexcept
+	{
+		return m_frequencies.size();
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Totals of a sweep pass
+//////////////////////////////////////////////////////////////////////////
+struct SweepStats
+{
+	size_t steps = 0;
+	size_t hits = 0;
+	size_t samples = 0;
+	std::chrono::steady_clock::duration duration{};
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Tunes the radio through the band with quick search hold and samples
+///   the signal level (PWR) and the squelch (GLG) at each step; the radio's
+///   memory is not touched. A quiet step gets a single sample after the
+///   settling time, a step on air is sampled until it has been quiet for a
+///   few samples or for the hit dwell at most. The steps known to be active
+///   go first, the rest in the order of frequency, reversed every other
+///   pass so that the radio never jumps across the band.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Sweeper
+{
+	const Scanner& m_scanner;
+	const ScanSettingsStore& m_scanSettings;
+	const SweepSettings m_settings;
+	unsigned int m_passes = 0;
+
+	std::vector<uint64_t> Order(const SweepRange& range, const OccupancyMap& map) const;
+	Occupancy Dwell(uint64_t frequency, Modulation mod) const;
+
+public:
+	Sweeper(const Scanner& scanner, const ScanSettingsStore& scanSettings, const SweepSettings& settings);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Sweep the range once and merge the samples into the map
+	/// </summary>
+	///
+	/// <param name="stop"> Set from another thread to end the pass early </param>
+	//////////////////////////////////////////////////////////////////////////
+	SweepStats Run(const SweepRange& range, OccupancyMap& map, const std::atomic<bool>* stop = nullptr);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Let the radio scan its memory again
+	//////////////////////////////////////////////////////////////////////////
+	void Resume() const;
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_SWEEP_H_INCLUDED
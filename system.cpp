@@ -7,13 +7,44 @@
 #include "system.h"
 #include "uniden.h"
 #include "group.h"
+#include "enum_table.h"
 
 namespace kvasir
 {
 
+namespace
+{
+
+constexpr EnumTable<SystemType, 7, 7> SystemTypeNames({ {
+	{ SystemType::Conventional, "CNV" },
+	{ SystemType::Motorola, "MOT" },
+	{ SystemType::EDACS, "EDC" },
+	{ SystemType::EDACS_SCAT, "EDS" },
+	{ SystemType::LTR, "LTR" },
+	{ SystemType::P25Standard, "P25S" },
+	{ SystemType::P25OneFrequency, "P25F" }
+} });
+
+} // namespace
+
 template class System<ConventionalChannel>;
 template class System<TrunkChannel>;
 
+//////////////////////////////////////////////////////////////////////////
+std::optional<SystemType> SystemTypeFromString(std::string_view type) noexcept
+{
+	SystemType result;
+	if (!SystemTypeNames.Find(type, result))
+		return std::nullopt;
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string_view ToString(SystemType type) noexcept
+{
+	return SystemTypeNames.Name(type);
+}
+
 //////////////////////////////////////////////////////////////////////////
 template<>
 System<ConventionalChannel>::System(const int index, const std::vector<std::string>& sinInfo)
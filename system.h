@@ -7,6 +7,9 @@
 #ifndef KVASIR_SYSTEM_H_INCLUDED
 #define KVASIR_SYSTEM_H_INCLUDED
 
+#include "uniden.h"
+
+#include <string_view>
 #include <optional>
 #include <string>
 #include <vector>
@@ -30,6 +33,13 @@ enum class SystemType
 	P25OneFrequency
 };
 
+//////////////////////////////////////////////////////////////////////////
+/// Type of the name in the replies (CNV, MOT, EDC...), none if unknown
+//////////////////////////////////////////////////////////////////////////
+std::optional<SystemType> SystemTypeFromString(std::string_view type) noexcept;
+
+std::string_view ToString(SystemType type) noexcept;
+
 // Forward declaration of Group template
 template<typename Type> class Group;
 
@@ -51,6 +61,7 @@ class System
 	std::optional<int> m_numberTag;
 	std::optional<int> m_agcAnalog;
 	std::optional<int> m_agcDigital;
+	IdFormat m_idFormat = IdFormat::Decimal;
 	std::list<Group<Type>> m_groups;
 
 	explicit System(const int index, const std::string& name)
@@ -103,6 +114,14 @@ public:
 	{
 		return m_protected;
 	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Format the radio shows the talk group IDs of the system in
+	//////////////////////////////////////////////////////////////////////////
+	IdFormat TalkGroupFormat() const noexcept
+	{
+		return m_idFormat;
+	}
 };
 
 // Extern specification for two common cases
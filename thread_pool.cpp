@@ -0,0 +1,75 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: thread_pool.cpp
+///
+/// summary: pool of worker threads for CPU-bound background jobs
+//////////////////////////////////////////////////////////////////////////
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+ThreadPool& ThreadPool::GetInstance()
+{
+	// Leave one core for the serial and audio I/O
+	static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+	return pool;
+}
+
+//////////////////////////////////////////////////////////////////////////
+ThreadPool::ThreadPool(size_t threads)
+	: m_stop(false)
+{
+	m_workers.reserve(threads);
+	for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+		m_workers.emplace_back([this] { Work(); });
+}
+
+//////////////////////////////////////////////////////////////////////////
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_stop = true;
+	}
+	m_ready.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::future<void> ThreadPool::Submit(std::function<void()> job)
+{
+	std::packaged_task<void()> task(std::move(job));
+	std::future<void> result = task.get_future();
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_tasks.emplace_back(std::move(task));
+	}
+	m_ready.notify_one();
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void ThreadPool::Work()
+{
+	for (;;)
+	{
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_ready.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+			if (m_tasks.empty())
+				return;
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
+
+} // namespace kvasir
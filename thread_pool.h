@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: thread_pool.h
+///
+/// summary: pool of worker threads for CPU-bound background jobs
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_THREAD_POOL_H_INCLUDED
+#define KVASIR_THREAD_POOL_H_INCLUDED
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace kvasir
+{
+
+class ThreadPool
+{
+	std::vector<std::thread> m_workers;
+	std::deque<std::packaged_task<void()>> m_tasks;
+	std::mutex m_lock;
+	std::condition_variable m_ready;
+	bool m_stop;
+
+	void Work();
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Get the pool shared by the whole process
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	static ThreadPool& GetInstance();
+
+	explicit ThreadPool(size_t threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t Size() const noexcept
+	{
+		return m_workers.size();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Queue the job, exceptions are passed to the caller via the future
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	std::future<void> Submit(std::function<void()> job);
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_THREAD_POOL_H_INCLUDED
@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: timebase.cpp
+///
+/// summary: common monotonic timebase for audio and reception statuses
+//////////////////////////////////////////////////////////////////////////
+
+#include "timebase.h"
+
+#include <algorithm>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+AudioClock::AudioClock(unsigned int sampleRate, size_t window)
+	: m_sampleRate(sampleRate)
+	, m_window(std::max<size_t>(window, 1))
+{}
+
+//////////////////////////////////////////////////////////////////////////
+Clock::duration AudioClock::SampleDuration(uint64_t samples) const
+{
+	// Split to avoid overflow of nanoseconds on long runs
+	const auto seconds = std::chrono::seconds(samples / m_sampleRate);
+	const auto rest = std::chrono::nanoseconds((samples % m_sampleRate) * 1000000000ull / m_sampleRate);
+	return std::chrono::duration_cast<Clock::duration>(seconds + rest);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AudioClock::Observe(uint64_t sampleEnd, Timestamp arrival)
+{
+	// Sliding window minimum of the sample #0 time over the deliveries
+	const Clock::duration offset = arrival.time_since_epoch() - SampleDuration(sampleEnd);
+	while (!m_minimums.empty() && m_minimums.back().second >= offset)
+		m_minimums.pop_back();
+	m_minimums.emplace_back(m_observations, offset);
+
+	++m_observations;
+	while (m_minimums.front().first + m_window < m_observations)
+		m_minimums.pop_front();
+
+	m_offset = m_minimums.front().second;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Timestamp AudioClock::TimeOf(uint64_t sample) const
+{
+	return Timestamp(m_offset + SampleDuration(sample));
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint64_t AudioClock::SampleAt(Timestamp time) const
+{
+	const auto sinceStart = time.time_since_epoch() - m_offset;
+	if (sinceStart.count() <= 0)
+		return 0;
+
+	const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(sinceStart);
+	const auto rest = std::chrono::duration_cast<std::chrono::nanoseconds>(sinceStart - seconds);
+	return static_cast<uint64_t>(seconds.count()) * m_sampleRate
+		+ static_cast<uint64_t>(rest.count()) * m_sampleRate / 1000000000ull;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void StatusTimeline::Push(const ReceptionStatus& status)
+{
+	if (!m_statuses.empty() && status.time < m_statuses.back().time)
+		return;
+
+	m_statuses.push_back(status);
+	if (m_statuses.size() > m_capacity)
+		m_statuses.pop_front();
+}
+
+//////////////////////////////////////////////////////////////////////////
+Timestamp StatusTimeline::Watermark() const
+{
+	return m_statuses.empty() ? Timestamp{} : m_statuses.back().time;
+}
+
+//////////////////////////////////////////////////////////////////////////
+const ReceptionStatus* StatusTimeline::Lookup(Timestamp time) const
+{
+	// The latest status taken not after the given time
+	const auto next = std::upper_bound(m_statuses.cbegin(), m_statuses.cend(), time,
+		[](Timestamp t, const ReceptionStatus& status) { return t < status.time; });
+	return next == m_statuses.cbegin() ? nullptr : &*std::prev(next);
+}
+
+} // namespace kvasir
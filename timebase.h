@@ -0,0 +1,97 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: timebase.h
+///
+/// summary: common monotonic timebase for audio and reception statuses
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_TIMEBASE_H_INCLUDED
+#define KVASIR_TIMEBASE_H_INCLUDED
+
+#include "uniden.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// All the data sources are stamped on arrival with this clock
+//////////////////////////////////////////////////////////////////////////
+using Clock = std::chrono::steady_clock;
+using Timestamp = Clock::time_point;
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Maps positions in the audio stream to the monotonic time. Blocks of
+///   audio are delivered with a varying delay, so the mapping follows the
+///   least delayed delivery seen within the window.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class AudioClock
+{
+	const unsigned int m_sampleRate;
+	const size_t m_window;
+	uint64_t m_observations = 0;
+	std::deque<std::pair<uint64_t, Clock::duration>> m_minimums; // observation, offset
+	Clock::duration m_offset{};                                  // time of the sample #0
+
+	Clock::duration SampleDuration(uint64_t samples) const;
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// <param name="sampleRate"> Nominal sample rate of the stream </param>
+	/// <param name="window"> Number of the last deliveries to follow </param>
+	//////////////////////////////////////////////////////////////////////////
+	AudioClock(unsigned int sampleRate, size_t window = 128);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Samples before <paramref name="sampleEnd"/> arrived at the given time
+	//////////////////////////////////////////////////////////////////////////
+	void Observe(uint64_t sampleEnd, Timestamp arrival);
+
+	bool Synchronized() const noexcept
+	{
+		return m_observations != 0;
+	}
+
+	Timestamp TimeOf(uint64_t sample) const;
+	uint64_t SampleAt(Timestamp time) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Bounded history of reception statuses ordered by their timestamps
+///   to label spans of audio. The oldest entries are evicted first.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class StatusTimeline
+{
+	const size_t m_capacity;
+	std::deque<ReceptionStatus> m_statuses;
+
+public:
+	explicit StatusTimeline(size_t capacity = 1024)
+		: m_capacity(capacity)
+	{}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Statuses coming out of order are ignored
+	//////////////////////////////////////////////////////////////////////////
+	void Push(const ReceptionStatus& status);
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Time of the latest status: audio older than it is labeled for good
+	//////////////////////////////////////////////////////////////////////////
+	Timestamp Watermark() const;
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Status in effect at the given time, null if it is out of the history
+	//////////////////////////////////////////////////////////////////////////
+	const ReceptionStatus* Lookup(Timestamp time) const;
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_TIMEBASE_H_INCLUDED
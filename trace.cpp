@@ -0,0 +1,295 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: trace.cpp
+///
+/// summary: binary trace log of the serial traffic and other hot events
+//////////////////////////////////////////////////////////////////////////
+
+#include "trace.h"
+#include "ring_buffer.h"
+
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <mutex>
+
+namespace kvasir
+{
+
+using namespace trace_format;
+
+namespace
+{
+
+// Per thread buffer size: room for several flush intervals of events
+constexpr size_t ThreadBufferSize = 64 * 1024;
+
+//////////////////////////////////////////////////////////////////////////
+/// Encoded events of the single thread
+//////////////////////////////////////////////////////////////////////////
+struct ThreadBuffer
+{
+	RingBuffer<char> events;
+	const uint32_t thread;
+	std::atomic<bool> exited{ false };
+
+	explicit ThreadBuffer(uint32_t thread)
+		: events(ThreadBufferSize)
+		, thread(thread)
+	{}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Shared state of the tracer: registered formats, thread buffers, file
+//////////////////////////////////////////////////////////////////////////
+struct TraceState
+{
+	std::mutex lock;                                    // Guards formats and buffers
+	std::vector<std::string> formats;                   // Format text by id
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	uint32_t nextThread = 0;
+	std::atomic<uint64_t> dropped{ 0 };
+
+	// Owned by the writer thread while the trace is open
+	std::ofstream file;
+	size_t formatsWritten = 0;
+	std::vector<char> chunk;
+
+	std::thread writer;
+	std::mutex wakeLock;
+	std::condition_variable wake;
+	bool stop = false;
+
+	void Drain();
+	void Run(std::chrono::milliseconds flushInterval);
+
+	~TraceState()
+	{
+		// Tracer::Close() has not been called: unfinished data is lost
+		if (writer.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> guard(wakeLock);
+				stop = true;
+			}
+			wake.notify_one();
+			writer.join();
+		}
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+TraceState& State()
+{
+	static TraceState state;
+	return state;
+}
+
+//////////////////////////////////////////////////////////////////////////
+template<typename T>
+void WriteValue(std::ofstream& file, const T& value)
+{
+	file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+//////////////////////////////////////////////////////////////////////////
+void TraceState::Drain()
+{
+	// Events are taken first: formats of all of them are registered by now
+	chunk.clear();
+	std::vector<std::shared_ptr<ThreadBuffer>> active;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		active = buffers;
+	}
+	for (const auto& buffer : active)
+	{
+		const bool exited = buffer->exited.load(std::memory_order_acquire);
+		const size_t available = buffer->events.Available();
+		const size_t offset = chunk.size();
+		chunk.resize(offset + available);
+		buffer->events.Read(chunk.data() + offset, available);
+
+		if (exited)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			buffers.erase(std::remove(buffers.begin(), buffers.end(), buffer), buffers.end());
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		for (; formatsWritten < formats.size(); ++formatsWritten)
+		{
+			const std::string& text = formats[formatsWritten];
+			const uint16_t length = static_cast<uint16_t>(std::min<size_t>(text.size(), UINT16_MAX));
+			WriteValue(file, RECORD_FORMAT);
+			WriteValue(file, static_cast<uint32_t>(formatsWritten));
+			WriteValue(file, length);
+			file.write(text.data(), length);
+		}
+	}
+
+	file.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+
+	if (const uint64_t count = dropped.exchange(0, std::memory_order_relaxed))
+	{
+		WriteValue(file, RECORD_DROPPED);
+		WriteValue(file, count);
+	}
+	file.flush();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void TraceState::Run(std::chrono::milliseconds flushInterval)
+{
+	std::unique_lock<std::mutex> guard(wakeLock);
+	while (!stop)
+	{
+		wake.wait_for(guard, flushInterval, [this] { return stop; });
+		guard.unlock();
+		Drain();
+		guard.lock();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Releases the buffer of the exiting thread to the writer
+//////////////////////////////////////////////////////////////////////////
+struct ThreadHandle
+{
+	std::shared_ptr<ThreadBuffer> buffer;
+
+	~ThreadHandle()
+	{
+		if (buffer)
+			buffer->exited.store(true, std::memory_order_release);
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+ThreadBuffer& CurrentBuffer()
+{
+	thread_local ThreadHandle handle;
+	if (!handle.buffer)
+	{
+		TraceState& state = State();
+		std::lock_guard<std::mutex> guard(state.lock);
+		handle.buffer = std::make_shared<ThreadBuffer>(state.nextThread++);
+		state.buffers.push_back(handle.buffer);
+	}
+	return *handle.buffer;
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint64_t Nanoseconds(std::chrono::nanoseconds time)
+{
+	return static_cast<uint64_t>(time.count());
+}
+
+} // namespace
+
+std::atomic<bool> Tracer::s_open{ false };
+
+//////////////////////////////////////////////////////////////////////////
+TraceFormat::TraceFormat(const char* format)
+	: m_id([format] {
+		TraceState& state = State();
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.formats.emplace_back(format);
+		return static_cast<uint32_t>(state.formats.size() - 1);
+	}())
+{}
+
+//////////////////////////////////////////////////////////////////////////
+Tracer::EventBuilder::EventBuilder(uint32_t formatId) noexcept
+{
+	Put(RECORD_EVENT);
+	Put(formatId);
+	Put(uint32_t(0));                                   // Thread, set on commit
+	Put(Nanoseconds(std::chrono::steady_clock::now().time_since_epoch()));
+	Put(uint8_t(0));                                    // Argument count
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Tracer::EventBuilder::Add(std::string_view text) noexcept
+{
+	const size_t header = 1 + sizeof(uint16_t);
+	if (m_size + header > sizeof(m_data))
+		return;
+
+	const size_t room = std::min<size_t>(sizeof(m_data) - m_size - header, UINT16_MAX);
+	const uint16_t length = static_cast<uint16_t>(std::min(text.size(), room));
+	Put(ARG_TEXT);
+	Put(length);
+	std::memcpy(m_data + m_size, text.data(), length);
+	m_size += length;
+	++m_data[CountOffset];
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Tracer::Commit(EventBuilder& event) noexcept
+try
+{
+	ThreadBuffer& buffer = CurrentBuffer();
+	std::memcpy(event.Data() + EventBuilder::ThreadOffset, &buffer.thread, sizeof(buffer.thread));
+
+	// Only whole events get into the buffer, so the writer never sees a
+	// partial one
+	if (buffer.events.Capacity() - buffer.events.Available() < event.Size())
+	{
+		State().dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	buffer.events.Write(event.Data(), event.Size());
+}
+catch (...)
+{
+	// Registration of the thread failed to allocate: the event is lost
+	State().dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Tracer::Open(const std::string& path, std::chrono::milliseconds flushInterval)
+{
+	Close();
+
+	TraceState& state = State();
+	state.file.open(path, std::ios::binary | std::ios::trunc);
+	if (!state.file.is_open())
+		throw std::runtime_error("failed to open trace file \"" + path + "\" for writing");
+
+	state.file.write(Magic, sizeof(Magic));
+	WriteValue(state.file, Nanoseconds(std::chrono::system_clock::now().time_since_epoch()));
+	WriteValue(state.file, Nanoseconds(std::chrono::steady_clock::now().time_since_epoch()));
+
+	// Formats registered by the previous session are written once more
+	state.formatsWritten = 0;
+	state.stop = false;
+	state.writer = std::thread([&state, flushInterval] { state.Run(flushInterval); });
+	s_open.store(true, std::memory_order_relaxed);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void Tracer::Close()
+{
+	TraceState& state = State();
+	if (!state.writer.joinable())
+		return;
+
+	s_open.store(false, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> guard(state.wakeLock);
+		state.stop = true;
+	}
+	state.wake.notify_one();
+	state.writer.join();
+
+	state.Drain();
+	state.file.close();
+}
+
+} // namespace kvasir
@@ -0,0 +1,210 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: trace.h
+///
+/// summary: binary trace log of the serial traffic and other hot events
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_TRACE_H_INCLUDED
+#define KVASIR_TRACE_H_INCLUDED
+
+#include <type_traits>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Put the event into the trace if it is open. The format is a literal
+///   with "{}" placeholders, it is registered once per statement and only
+///   its id goes with the event. Arguments are stored raw: integers,
+///   floating point numbers and text. The text is rebuilt offline by
+///   kvasir-tracedump.
+///   Usage: KVASIR_TRACE("reply {} in {} us", reply, microseconds);
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+#define KVASIR_TRACE(format, ...) \
+    do \
+    { \
+        if (kvasir::Tracer::IsOpen()) \
+        { \
+            static const kvasir::TraceFormat traceFormat(format); \
+            kvasir::Tracer::Write(traceFormat, ##__VA_ARGS__); \
+        } \
+    } while (false)
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Layout of the trace file. All the numbers are in the host byte order.
+///
+///   Header:  "KVTRACE1", u64 system clock ns, u64 steady clock ns (taken
+///            at the same moment to map event times to the wall clock)
+///   Records: u8 kind followed by
+///     Format:  u32 id, u16 length, text
+///     Event:   u32 format id, u32 thread, u64 steady clock ns, u8 count,
+///              arguments: u8 type followed by i64 | u64 | f64 |
+///              u16 length + bytes
+///     Dropped: u64 number of events lost on overflow
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+namespace trace_format
+{
+
+constexpr char Magic[8] = { 'K', 'V', 'T', 'R', 'A', 'C', 'E', '1' };
+
+enum RecordKind : uint8_t
+{
+	RECORD_FORMAT = 1,
+	RECORD_EVENT = 2,
+	RECORD_DROPPED = 3
+};
+
+enum ArgumentType : uint8_t
+{
+	ARG_INT = 1,
+	ARG_UINT = 2,
+	ARG_DOUBLE = 3,
+	ARG_TEXT = 4
+};
+
+// Max size of the single event, longer text arguments are cut
+constexpr size_t MaxEventSize = 1024;
+
+} // namespace trace_format
+
+//////////////////////////////////////////////////////////////////////////
+/// Format string of the trace statement, gets its id on construction
+//////////////////////////////////////////////////////////////////////////
+class TraceFormat
+{
+	const uint32_t m_id;
+
+public:
+	explicit TraceFormat(const char* format);
+
+	uint32_t Id() const noexcept
+	{
+		return m_id;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Binary trace channel. Each thread encodes events into its own
+///   lock-free buffer, the background thread moves them into the file.
+///   Writing never blocks: events which don't fit are counted and the
+///   count is put into the trace.
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+class Tracer
+{
+	//////////////////////////////////////////////////////////////////////////
+	/// Encoder of the single event on the stack of the calling thread
+	//////////////////////////////////////////////////////////////////////////
+	class EventBuilder
+	{
+		char m_data[trace_format::MaxEventSize];
+		size_t m_size = 0;
+
+		template<typename T>
+		void Put(const T& value) noexcept
+		{
+			std::memcpy(m_data + m_size, &value, sizeof(value));
+			m_size += sizeof(value);
+		}
+
+		template<typename T>
+		void AddNumber(trace_format::ArgumentType type, T value) noexcept
+		{
+			if (m_size + 1 + sizeof(value) > sizeof(m_data))
+				return;
+			Put(type);
+			Put(value);
+			++m_data[CountOffset];
+		}
+
+	public:
+		// Offsets of the fields filled on commit
+		static constexpr size_t ThreadOffset = 5;
+		static constexpr size_t CountOffset = 17;
+
+		explicit EventBuilder(uint32_t formatId) noexcept;
+
+		char* Data() noexcept
+		{
+			return m_data;
+		}
+
+		size_t Size() const noexcept
+		{
+			return m_size;
+		}
+
+		void Add(std::string_view text) noexcept;
+
+		template<typename T>
+		void Add(const T& value) noexcept
+		{
+			if constexpr (std::is_convertible_v<const T&, std::string_view>)
+				Add(std::string_view(value));
+			else if constexpr (std::is_floating_point_v<T>)
+				AddNumber(trace_format::ARG_DOUBLE, static_cast<double>(value));
+			else if constexpr (std::is_enum_v<T>)
+				AddNumber(trace_format::ARG_INT, static_cast<int64_t>(value));
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+				AddNumber(trace_format::ARG_INT, static_cast<int64_t>(value));
+			else if constexpr (std::is_integral_v<T>)
+				AddNumber(trace_format::ARG_UINT, static_cast<uint64_t>(value));
+			else
+				static_assert(std::is_integral_v<T>, "unsupported trace argument type");
+		}
+	};
+
+	static std::atomic<bool> s_open;
+
+	static void Commit(EventBuilder& event) noexcept;
+
+public:
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Start tracing into the file, the file is overwritten
+	/// </summary>
+	///
+	/// <param name="path"> Path to the trace file </param>
+	/// <param name="flushInterval"> Period of moving events into the file </param>
+	//////////////////////////////////////////////////////////////////////////
+	static void Open(const std::string& path,
+		std::chrono::milliseconds flushInterval = std::chrono::milliseconds(100));
+
+	//////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	///   Write out the buffered events and close the file
+	/// </summary>
+	//////////////////////////////////////////////////////////////////////////
+	static void Close();
+
+	static bool IsOpen() noexcept
+	{
+		return s_open.load(std::memory_order_relaxed);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	/// Use KVASIR_TRACE instead
+	//////////////////////////////////////////////////////////////////////////
+	template<typename... Args>
+	static void Write(const TraceFormat& format, const Args&... args) noexcept
+	{
+		EventBuilder event(format.Id());
+		(event.Add(args), ...);
+		Commit(event);
+	}
+};
+
+} // namespace kvasir
+
+#endif // KVASIR_TRACE_H_INCLUDED
@@ -0,0 +1,266 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: tracedump.cpp
+///
+/// summary: decoder of the binary trace files into the readable text
+//////////////////////////////////////////////////////////////////////////
+
+#include "trace.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <iterator>
+#include <fstream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <ctime>
+
+#ifdef _WIN32
+# define safe_localtime(timePoint,brokenTime) localtime_s(brokenTime, timePoint)
+#else
+# define safe_localtime(timepoint,brokenTime) localtime_r(timepoint, brokenTime)
+#endif // _WIN32
+
+using namespace kvasir::trace_format;
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+struct Event
+{
+	uint64_t time;                          // Steady clock, ns
+	uint32_t thread;
+	std::string text;
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Sequential reader of the trace file contents
+//////////////////////////////////////////////////////////////////////////
+class Reader
+{
+	const std::vector<char>& m_data;
+	size_t m_pos = 0;
+
+public:
+	explicit Reader(const std::vector<char>& data)
+		: m_data(data)
+	{}
+
+	bool AtEnd() const noexcept
+	{
+		return m_pos == m_data.size();
+	}
+
+	size_t Position() const noexcept
+	{
+		return m_pos;
+	}
+
+	template<typename T>
+	T Get()
+	{
+		T value;
+		std::memcpy(&value, Bytes(sizeof(value)), sizeof(value));
+		return value;
+	}
+
+	const char* Bytes(size_t size)
+	{
+		if (m_data.size() - m_pos < size)
+			throw std::runtime_error("truncated record at offset " + std::to_string(m_pos));
+		const char* result = m_data.data() + m_pos;
+		m_pos += size;
+		return result;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Text argument with the control characters escaped (replies end with \r)
+//////////////////////////////////////////////////////////////////////////
+void AppendEscaped(std::string& out, const char* text, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		const unsigned char c = static_cast<unsigned char>(text[i]);
+		if (c == '\r')
+		{
+			out += "\\r";
+		}
+		else if (c == '\n')
+		{
+			out += "\\n";
+		}
+		else if (c < 0x20 || c == 0x7f)
+		{
+			char buf[8];
+			std::snprintf(buf, sizeof(buf), "\\x%02x", c);
+			out += buf;
+		}
+		else
+		{
+			out += static_cast<char>(c);
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Substitute the next "{}" of the format with the argument
+//////////////////////////////////////////////////////////////////////////
+std::string DecodeEvent(Reader& reader, const std::string& format, uint8_t count)
+{
+	std::string text;
+	size_t pos = 0;
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		std::string argument;
+		switch (reader.Get<uint8_t>())
+		{
+		case ARG_INT:
+			argument = std::to_string(reader.Get<int64_t>());
+			break;
+		case ARG_UINT:
+			argument = std::to_string(reader.Get<uint64_t>());
+			break;
+		case ARG_DOUBLE:
+		{
+			char buf[32];
+			std::snprintf(buf, sizeof(buf), "%g", reader.Get<double>());
+			argument = buf;
+			break;
+		}
+		case ARG_TEXT:
+		{
+			const uint16_t length = reader.Get<uint16_t>();
+			AppendEscaped(argument, reader.Bytes(length), length);
+			break;
+		}
+		default:
+			throw std::runtime_error("unknown argument type at offset " + std::to_string(reader.Position() - 1));
+		}
+
+		const size_t placeholder = format.find("{}", pos);
+		if (placeholder == std::string::npos)
+		{
+			// More arguments than placeholders: keep them anyway
+			text.append(format, pos, std::string::npos);
+			text += ' ';
+			text += argument;
+			pos = format.size();
+			continue;
+		}
+		text.append(format, pos, placeholder - pos);
+		text += argument;
+		pos = placeholder + 2;
+	}
+	text.append(format, std::min(pos, format.size()), std::string::npos);
+	return text;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// "YYYY-MM-DD HH:MM:SS.uuuuuu" of the wall clock time
+//////////////////////////////////////////////////////////////////////////
+std::string FormatTime(uint64_t wallNs)
+{
+	const std::time_t seconds = static_cast<std::time_t>(wallNs / 1000000000);
+	std::tm brokenTime;
+	safe_localtime(&seconds, &brokenTime);
+
+	char buf[64];
+	const size_t length = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &brokenTime);
+	std::snprintf(buf + length, sizeof(buf) - length, ".%06u",
+		static_cast<unsigned int>(wallNs % 1000000000 / 1000));
+	return buf;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+int main(int argc, char* argv[])
+try
+{
+	if (argc != 2)
+	{
+		std::cerr << "usage: kvasir-tracedump <trace file>" << std::endl;
+		return 2;
+	}
+
+	std::ifstream file(argv[1], std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error(std::string("failed to open ") + argv[1]);
+	const std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	Reader reader(data);
+	if (!std::equal(std::begin(Magic), std::end(Magic), reader.Bytes(sizeof(Magic))))
+		throw std::runtime_error("not a kvasir trace file");
+	const uint64_t wallOrigin = reader.Get<uint64_t>();
+	const uint64_t steadyOrigin = reader.Get<uint64_t>();
+
+	// Events of different threads are interleaved by flush batches: they
+	// are put in the time order before printing
+	std::unordered_map<uint32_t, std::string> formats;
+	std::vector<Event> events;
+	try
+	{
+		while (!reader.AtEnd())
+		{
+			switch (reader.Get<uint8_t>())
+			{
+			case RECORD_FORMAT:
+			{
+				const uint32_t id = reader.Get<uint32_t>();
+				const uint16_t length = reader.Get<uint16_t>();
+				formats[id].assign(reader.Bytes(length), length);
+				break;
+			}
+			case RECORD_EVENT:
+			{
+				const uint32_t id = reader.Get<uint32_t>();
+				const uint32_t thread = reader.Get<uint32_t>();
+				const uint64_t time = reader.Get<uint64_t>();
+				const uint8_t count = reader.Get<uint8_t>();
+				const auto format = formats.find(id);
+				const std::string unknown = "<format #" + std::to_string(id) + ">";
+				events.push_back(Event{ time, thread,
+					DecodeEvent(reader, format != formats.end() ? format->second : unknown, count) });
+				break;
+			}
+			case RECORD_DROPPED:
+			{
+				const uint64_t count = reader.Get<uint64_t>();
+				const uint64_t time = events.empty() ? steadyOrigin : events.back().time;
+				events.push_back(Event{ time, UINT32_MAX, std::to_string(count) + " events dropped on overflow" });
+				break;
+			}
+			default:
+				throw std::runtime_error("unknown record at offset " + std::to_string(reader.Position() - 1));
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		// The tail of the file is lost if the process died: print the rest
+		std::cerr << "warning: " << e.what() << std::endl;
+	}
+
+	std::stable_sort(events.begin(), events.end(),
+		[](const Event& lhs, const Event& rhs) { return lhs.time < rhs.time; });
+
+	for (const Event& event : events)
+	{
+		std::cout << FormatTime(wallOrigin + (event.time - steadyOrigin)) << ' ';
+		if (event.thread == UINT32_MAX)
+			std::cout << "--- ";
+		else
+			std::cout << 'T' << event.thread << ' ';
+		std::cout << event.text << '\n';
+	}
+	return 0;
+}
+catch (const std::exception& e)
+{
+	std::cerr << "failure: " << e.what() << std::endl;
+	return 1;
+}
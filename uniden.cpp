@@ -0,0 +1,289 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: uniden.cpp
+///
+/// summary: Uniden-specific types
+//////////////////////////////////////////////////////////////////////////
+
+#include "uniden.h"
+#include "enum_table.h"
+#include "logger.h"
+
+#include <iterator>
+#include <cstdio>
+#include <limits>
+
+namespace kvasir
+{
+
+namespace
+{
+
+constexpr uint64_t MaxValue = std::numeric_limits<uint32_t>::max();
+
+//////////////////////////////////////////////////////////////////////////
+/// Digits of the base, false on anything else or on overflow
+//////////////////////////////////////////////////////////////////////////
+bool ParseDigits(std::string_view text, unsigned int base, uint32_t& value) noexcept
+{
+	if (text.empty())
+		return false;
+
+	uint64_t result = 0;
+	for (const char c : text)
+	{
+		unsigned int digit;
+		if (c >= '0' && c <= '9')
+			digit = static_cast<unsigned int>(c - '0');
+		else if (base == 16 && c >= 'A' && c <= 'F')
+			digit = static_cast<unsigned int>(c - 'A' + 10);
+		else if (base == 16 && c >= 'a' && c <= 'f')
+			digit = static_cast<unsigned int>(c - 'a' + 10);
+		else
+			return false;
+
+		result = result * base + digit;
+		if (result > MaxValue)
+			return false;
+	}
+	value = static_cast<uint32_t>(result);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// MHz with up to 6 decimals into Hz, without going through the floats
+//////////////////////////////////////////////////////////////////////////
+bool ParseFrequency(std::string_view text, uint32_t& hz) noexcept
+{
+	const size_t dot = text.find('.');
+	uint32_t mhz = 0;
+	if (!ParseDigits(text.substr(0, dot), 10, mhz))
+		return false;
+
+	uint32_t fraction = 0;
+	size_t decimals = 0;
+	if (dot != std::string_view::npos)
+	{
+		const std::string_view digits = text.substr(dot + 1);
+		decimals = digits.size();
+		if (decimals > 6 || (decimals && !ParseDigits(digits, 10, fraction)))
+			return false;
+	}
+	for (; decimals < 6; ++decimals)
+		fraction *= 10;
+
+	const uint64_t result = uint64_t(mhz) * 1000000 + fraction;
+	if (result > MaxValue)
+		return false;
+	hz = static_cast<uint32_t>(result);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   EDACS AA-FFS: agency 0-15, fleet 0-15 and subfleet 0-7 packed into
+///   the 11 bit ID
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+bool ParseAfs(std::string_view text, uint32_t& id) noexcept
+{
+	const size_t dash = text.find('-');
+	if (dash == std::string_view::npos || text.size() - dash < 3)
+		return false;
+
+	uint32_t agency = 0, fleet = 0, subfleet = 0;
+	if (!ParseDigits(text.substr(0, dash), 10, agency) ||
+		!ParseDigits(text.substr(dash + 1, text.size() - dash - 2), 10, fleet) ||
+		!ParseDigits(text.substr(text.size() - 1), 10, subfleet) ||
+		agency > 15 || fleet > 15 || subfleet > 7)
+		return false;
+
+	id = agency << 7 | fleet << 3 | subfleet;
+	return true;
+}
+
+constexpr EnumTable<Modulation, 6, 7> ModulationNames({ {
+	{ Modulation::AM, "AM" },
+	{ Modulation::FM, "FM" },
+	{ Modulation::NFM, "NFM" },
+	{ Modulation::WFM, "WFM" },
+	{ Modulation::FMB, "FMB" },
+	{ Modulation::Auto, "AUTO" }
+} });
+
+// Tones from CTCSS_67_0_Hz on, in tenths of Hz
+constexpr uint16_t CtcssTones[] = {
+	670, 693, 719, 744, 770, 797, 825, 854, 885, 915, 948, 974, 1000, 1035, 1072, 1109, 1148,
+	1188, 1230, 1273, 1318, 1365, 1413, 1462, 1514, 1567, 1598, 1622, 1655, 1679, 1713, 1738,
+	1773, 1799, 1835, 1862, 1899, 1928, 1966, 1995, 2035, 2065, 2107, 2181, 2257, 2291, 2336,
+	2418, 2503, 2541
+};
+
+// Codes from DCS_023 on: octal, like the radio shows them
+constexpr uint16_t DcsCodes[] = {
+	0023, 0025, 0026, 0031, 0032, 0036, 0043, 0047, 0051, 0053, 0054, 0065, 0071, 0072, 0073,
+	0074, 0114, 0115, 0116, 0122, 0125, 0131, 0132, 0134, 0143, 0145, 0152, 0155, 0156, 0162,
+	0165, 0172, 0174, 0205, 0212, 0223, 0225, 0226, 0243, 0244, 0245, 0246, 0251, 0252, 0255,
+	0261, 0263, 0265, 0266, 0271, 0274, 0306, 0311, 0315, 0325, 0331, 0332, 0343, 0346, 0351,
+	0356, 0364, 0365, 0371, 0411, 0412, 0413, 0423, 0431, 0432, 0445, 0446, 0452, 0454, 0455,
+	0462, 0464, 0465, 0466, 0503, 0506, 0516, 0523, 0526, 0532, 0546, 0565, 0606, 0612, 0624,
+	0627, 0631, 0632, 0654, 0662, 0664, 0703, 0712, 0723, 0731, 0732, 0734, 0743, 0754
+};
+
+constexpr size_t FirstTone = Offset(CtcssDcsCode::CTCSS_67_0_Hz);
+constexpr size_t FirstDcs = Offset(CtcssDcsCode::DCS_023);
+constexpr size_t CodeCount = Offset(CtcssDcsCode::DCS_754) + 1;
+static_assert(FirstTone + std::size(CtcssTones) == Offset(CtcssDcsCode::CTCSS_254_1_Hz) + 1);
+static_assert(FirstDcs + std::size(DcsCodes) == CodeCount);
+
+//////////////////////////////////////////////////////////////////////////
+struct CodeText
+{
+	char text[8];
+	uint8_t length;
+
+	constexpr std::string_view View() const noexcept
+	{
+		return std::string_view(text, length);
+	}
+
+	constexpr void Append(char c) noexcept
+	{
+		text[length++] = c;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// Texts of the codes by their numbers, empty for the numbers which aren't
+//////////////////////////////////////////////////////////////////////////
+constexpr std::array<CodeText, CodeCount> MakeCodeTexts()
+{
+	std::array<CodeText, CodeCount> texts{};
+	for (size_t i = 0; i < std::size(CtcssTones); ++i)
+	{
+		CodeText& code = texts[FirstTone + i];
+		const unsigned int hz = CtcssTones[i] / 10;
+		if (hz >= 100)
+			code.Append(static_cast<char>('0' + hz / 100));
+		code.Append(static_cast<char>('0' + hz / 10 % 10));
+		code.Append(static_cast<char>('0' + hz % 10));
+		code.Append('.');
+		code.Append(static_cast<char>('0' + CtcssTones[i] % 10));
+		code.Append(' ');
+		code.Append('H');
+		code.Append('z');
+	}
+	for (size_t i = 0; i < std::size(DcsCodes); ++i)
+	{
+		CodeText& code = texts[FirstDcs + i];
+		for (const char c : { 'D', 'C', 'S', ' ' })
+			code.Append(c);
+		code.Append(static_cast<char>('0' + (DcsCodes[i] >> 6)));
+		code.Append(static_cast<char>('0' + (DcsCodes[i] >> 3 & 7)));
+		code.Append(static_cast<char>('0' + (DcsCodes[i] & 7)));
+	}
+	return texts;
+}
+
+constexpr std::array<CodeText, CodeCount> CodeTexts = MakeCodeTexts();
+static_assert(CodeTexts[Offset(CtcssDcsCode::CTCSS_67_0_Hz)].View() == "67.0 Hz");
+static_assert(CodeTexts[Offset(CtcssDcsCode::CTCSS_254_1_Hz)].View() == "254.1 Hz");
+static_assert(CodeTexts[Offset(CtcssDcsCode::DCS_023)].View() == "DCS 023");
+static_assert(CodeTexts[Offset(CtcssDcsCode::DCS_754)].View() == "DCS 754");
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+Modulation ModFromString(std::string_view mod)
+{
+	Modulation result = Modulation::None;
+	if (!ModulationNames.Find(mod, result))
+	{
+		KVASIR_LOG(DEBUG) << "unknown modulation: " << mod;
+	}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string_view ModToString(Modulation mod) noexcept
+{
+	const std::string_view name = ModulationNames.Name(mod);
+	return name.empty() ? "AUTO" : name;
+}
+
+//////////////////////////////////////////////////////////////////////////
+CtcssDcsCode CtcssDcsFromNumber(unsigned int number) noexcept
+{
+	return number < CodeCount && CodeTexts[number].length ? static_cast<CtcssDcsCode>(number) : CtcssDcsCode::None;
+}
+
+//////////////////////////////////////////////////////////////////////////
+unsigned int CtcssTenthsOfHz(CtcssDcsCode code) noexcept
+{
+	const size_t index = Offset(code) - FirstTone;
+	return index < std::size(CtcssTones) ? CtcssTones[index] : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string_view ToString(CtcssDcsCode code) noexcept
+{
+	const size_t number = Offset(code);
+	return number < CodeCount ? CodeTexts[number].View() : std::string_view();
+}
+
+//////////////////////////////////////////////////////////////////////////
+FreqOrTgid ParseFreqOrTgid(std::string_view text, IdFormat format) noexcept
+{
+	FreqOrTgid result;
+	if (text.find('.') != std::string_view::npos)
+	{
+		if (ParseFrequency(text, result.value))
+			result.kind = FreqOrTgid::Kind::Frequency;
+		return result;
+	}
+
+	// The radio shows what the system uses: the dash and the hex letters
+	// tell the format whatever the caller expects
+	if (text.find('-') != std::string_view::npos)
+		format = IdFormat::Afs;
+	else if (format == IdFormat::Decimal && text.find_first_not_of("0123456789") != std::string_view::npos)
+		format = IdFormat::Hex;
+
+	const bool parsed = format == IdFormat::Afs ?
+		ParseAfs(text, result.value) :
+		ParseDigits(text, format == IdFormat::Hex ? 16 : 10, result.value);
+	if (parsed)
+	{
+		result.kind = FreqOrTgid::Kind::TalkGroup;
+		result.format = format;
+	}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string ToString(const FreqOrTgid& freq)
+{
+	char buf[32];
+	switch (freq.kind)
+	{
+	case FreqOrTgid::Kind::None:
+		return std::string();
+	case FreqOrTgid::Kind::Frequency:
+		// The radio's 100 Hz resolution unless the value is finer
+		if (freq.value % 100)
+			std::snprintf(buf, sizeof(buf), "%04u.%06u", freq.value / 1000000, freq.value % 1000000);
+		else
+			std::snprintf(buf, sizeof(buf), "%04u.%04u", freq.value / 1000000, freq.value % 1000000 / 100);
+		break;
+	case FreqOrTgid::Kind::TalkGroup:
+		if (freq.format == IdFormat::Hex)
+			std::snprintf(buf, sizeof(buf), "%X", freq.value);
+		else if (freq.format == IdFormat::Afs)
+			std::snprintf(buf, sizeof(buf), "%02u-%02u%u", freq.value >> 7, freq.value >> 3 & 15, freq.value & 7);
+		else
+			std::snprintf(buf, sizeof(buf), "%u", freq.value);
+		break;
+	}
+	return buf;
+}
+
+} // namespace kvasir
@@ -7,6 +7,9 @@
 #ifndef KVASIR_UNIDEN_H_INCLUDED
 #define KVASIR_UNIDEN_H_INCLUDED
 
+#include <string_view>
+#include <cstdint>
+#include <chrono>
 #include <string>
 
 namespace kvasir
@@ -184,9 +187,94 @@ enum class CtcssDcsCode : unsigned int
 	DCS_754 = 231
 };
 
+//////////////////////////////////////////////////////////////////////////
+/// Modulation of the name in the replies, None if unknown
+//////////////////////////////////////////////////////////////////////////
+Modulation ModFromString(std::string_view mod);
+
+//////////////////////////////////////////////////////////////////////////
+/// Name of the modulation in the commands, AUTO for None and Auto
+//////////////////////////////////////////////////////////////////////////
+std::string_view ModToString(Modulation mod) noexcept;
+
+//////////////////////////////////////////////////////////////////////////
+/// Code of the number in the replies, None if it's not one
+//////////////////////////////////////////////////////////////////////////
+CtcssDcsCode CtcssDcsFromNumber(unsigned int number) noexcept;
+
+//////////////////////////////////////////////////////////////////////////
+/// CTCSS tone in tenths of Hz (670 for 67.0 Hz), 0 for DCS and None
+//////////////////////////////////////////////////////////////////////////
+unsigned int CtcssTenthsOfHz(CtcssDcsCode code) noexcept;
+
+//////////////////////////////////////////////////////////////////////////
+/// Code as the radio shows it: 67.0 Hz, DCS 023; empty for None
+//////////////////////////////////////////////////////////////////////////
+std::string_view ToString(CtcssDcsCode code) noexcept;
+
+//////////////////////////////////////////////////////////////////////////
+/// Display format of the talk group IDs of a trunked system
+//////////////////////////////////////////////////////////////////////////
+enum class IdFormat : uint8_t
+{
+	Decimal,
+	Hex,
+	Afs                                     // EDACS agency-fleet-subfleet: AA-FFS
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Frequency of a conventional channel or talk group ID of a trunked
+///   one, decoded from the radio's text once: compared, sorted and hashed
+///   as integers
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+struct FreqOrTgid
+{
+	enum class Kind : uint8_t
+	{
+		None,
+		Frequency,                          // Value in Hz
+		TalkGroup                           // Value is the ID
+	};
+
+	Kind kind = Kind::None;
+	IdFormat format = IdFormat::Decimal;    // Of the talk group
+	uint32_t value = 0;
+
+	bool operator==(const FreqOrTgid& other) const noexcept
+	{
+		return kind == other.kind && value == other.value;
+	}
+
+	bool operator!=(const FreqOrTgid& other) const noexcept
+	{
+		return !(*this == other);
+	}
+
+	bool operator<(const FreqOrTgid& other) const noexcept
+	{
+		return kind != other.kind ? kind < other.kind : value < other.value;
+	}
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Decode the frequency (MHz with up to 6 decimals, e.g. 0154.4300) or
+///   the talk group ID in the format, Kind::None if it's neither
+/// </summary>
+//////////////////////////////////////////////////////////////////////////
+FreqOrTgid ParseFreqOrTgid(std::string_view text, IdFormat format = IdFormat::Decimal) noexcept;
+
+//////////////////////////////////////////////////////////////////////////
+/// Text as the radio shows it: 0154.4300, 1234, 4D2 or 09-123
+//////////////////////////////////////////////////////////////////////////
+std::string ToString(const FreqOrTgid& freq);
+
 struct ReceptionStatus
 {
-	std::string freq;                       // Frequency or TGID
+	std::chrono::steady_clock::time_point time; // Moment the radio reported the status (estimated)
+	FreqOrTgid freq;                        // Frequency or TGID
 	std::string site;                       // System, site or search name
 	std::string group;                      // Group name
 	std::string channel;                    // Channel name
@@ -200,6 +288,14 @@ struct ReceptionStatus
 	bool mute = false;                      // Mute status (on/off)
 };
 
+//////////////////////////////////////////////////////////////////////////
+/// Statuses describe the same transmission (the same channel is received)
+//////////////////////////////////////////////////////////////////////////
+inline bool SameTransmission(const ReceptionStatus& lhs, const ReceptionStatus& rhs)
+{
+	return lhs.freq == rhs.freq && lhs.channel == rhs.channel && lhs.group == rhs.group;
+}
+
 enum class SIN : unsigned int
 {
 	// Positions 6-10, 17-21 and 27 are reserved for future use
@@ -223,6 +319,14 @@ enum class SIN : unsigned int
 	Protect = 26
 };
 
+enum class TRN : unsigned int
+{
+	// Values of a trunked system the talk group IDs are decoded by;
+	// the reply has 29 of them
+	Afs = 3,                                // EDACS ID format: 1 - AFS, 0 - decimal
+	MotorolaId = 24                         // Motorola/P25 ID format: 1 - hex, 0 - decimal
+};
+
 template<typename E>
 constexpr typename std::underlying_type<E>::type Offset(E e)
 {
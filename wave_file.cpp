@@ -0,0 +1,136 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: wave_file.cpp
+///
+/// summary: writing of RIFF/WAVE audio files
+//////////////////////////////////////////////////////////////////////////
+
+#include "wave_file.h"
+#include "thread_pool.h"
+#include "adpcm.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace kvasir
+{
+
+namespace
+{
+
+//////////////////////////////////////////////////////////////////////////
+void PutU16(std::string& buf, uint16_t value)
+{
+	buf.push_back(static_cast<char>(value & 0xFF));
+	buf.push_back(static_cast<char>(value >> 8));
+}
+
+//////////////////////////////////////////////////////////////////////////
+void PutU32(std::string& buf, uint32_t value)
+{
+	PutU16(buf, static_cast<uint16_t>(value & 0xFFFF));
+	PutU16(buf, static_cast<uint16_t>(value >> 16));
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string MakeInfoChunk(const WaveInfo& info)
+{
+	std::string body("INFO");
+	for (const auto& [tag, text] : info)
+	{
+		if (tag.size() != 4 || text.empty())
+			continue;
+
+		// Text is zero terminated and chunks are padded to the even size
+		const uint32_t size = static_cast<uint32_t>(text.size() + 1);
+		body += tag;
+		PutU32(body, size);
+		body += text;
+		body.push_back('\0');
+		if (size & 1)
+			body.push_back('\0');
+	}
+
+	if (body.size() == 4)
+		return std::string{};
+
+	std::string chunk("LIST");
+	PutU32(chunk, static_cast<uint32_t>(body.size()));
+	return chunk + body;
+}
+
+//////////////////////////////////////////////////////////////////////////
+std::string MakeFormatChunks(WaveCodec codec, unsigned int sampleRate, size_t sampleCount)
+{
+	std::string buf("fmt ");
+	if (WaveCodec::Pcm == codec)
+	{
+		PutU32(buf, 16);
+		PutU16(buf, 1);                  // PCM
+		PutU16(buf, 1);                  // mono
+		PutU32(buf, sampleRate);
+		PutU32(buf, sampleRate * 2);     // byte rate
+		PutU16(buf, 2);                  // block align
+		PutU16(buf, 16);                 // bits per sample
+		return buf;
+	}
+
+	const uint32_t samplesPerBlock = static_cast<uint32_t>(ImaAdpcmSamplesPerBlock(ImaAdpcmBlockAlign));
+	PutU32(buf, 20);
+	PutU16(buf, 0x11);                   // IMA ADPCM
+	PutU16(buf, 1);                      // mono
+	PutU32(buf, sampleRate);
+	PutU32(buf, static_cast<uint32_t>(uint64_t(sampleRate) * ImaAdpcmBlockAlign / samplesPerBlock));
+	PutU16(buf, static_cast<uint16_t>(ImaAdpcmBlockAlign));
+	PutU16(buf, 4);                      // bits per sample
+	PutU16(buf, 2);                      // size of the extension
+	PutU16(buf, static_cast<uint16_t>(samplesPerBlock));
+
+	// Compressed formats have to specify the number of samples
+	buf += "fact";
+	PutU32(buf, 4);
+	PutU32(buf, static_cast<uint32_t>(sampleCount));
+	return buf;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+void WriteWaveFile(const std::string& path, const std::vector<int16_t>& samples,
+	unsigned int sampleRate, const WaveInfo& info, WaveCodec codec)
+{
+	std::string data;
+	if (WaveCodec::Pcm == codec)
+	{
+		data.reserve(samples.size() * sizeof(int16_t));
+		for (const int16_t sample : samples)
+			PutU16(data, static_cast<uint16_t>(sample));
+	}
+	else
+	{
+		const std::vector<uint8_t> encoded = EncodeImaAdpcm(samples, ImaAdpcmBlockAlign, &ThreadPool::GetInstance());
+		data.assign(encoded.cbegin(), encoded.cend());
+	}
+
+	const std::string formatChunks = MakeFormatChunks(codec, sampleRate, samples.size());
+	const std::string infoChunk = MakeInfoChunk(info);
+
+	std::string buf("RIFF");
+	PutU32(buf, static_cast<uint32_t>(4 + formatChunks.size() + infoChunk.size() + 8 + data.size()));
+	buf += "WAVE";
+	buf += formatChunks;
+	buf += infoChunk;
+	buf += "data";
+	PutU32(buf, static_cast<uint32_t>(data.size()));
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("failed to open " + path + " for writing");
+
+	file.write(buf.data(), buf.size());
+	file.write(data.data(), data.size());
+
+	if (!file.good())
+		throw std::runtime_error("failed to write " + path);
+}
+
+} // namespace kvasir
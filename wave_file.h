@@ -0,0 +1,47 @@
+//////////////////////////////////////////////////////////////////////////
+/// file: wave_file.h
+///
+/// summary: writing of RIFF/WAVE audio files
+//////////////////////////////////////////////////////////////////////////
+
+#ifndef KVASIR_WAVE_FILE_H_INCLUDED
+#define KVASIR_WAVE_FILE_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kvasir
+{
+
+//////////////////////////////////////////////////////////////////////////
+/// Entries of the LIST/INFO chunk: four letters tag (INAM, ICMT...) and text
+//////////////////////////////////////////////////////////////////////////
+using WaveInfo = std::vector<std::pair<std::string, std::string>>;
+
+//////////////////////////////////////////////////////////////////////////
+enum class WaveCodec
+{
+	Pcm,                                    // 16-bit linear PCM
+	ImaAdpcm                                // 4-bit IMA ADPCM, ~4:1
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// <summary>
+///   Write mono 16-bit samples into the WAVE file. ADPCM encoding is run
+///   on the shared thread pool.
+/// </summary>
+///
+/// <param name="path"> Path to the file, overwritten if exists </param>
+/// <param name="samples"> Audio samples </param>
+/// <param name="sampleRate"> Sample rate of the audio, Hz </param>
+/// <param name="info"> Text tags to put into the LIST/INFO chunk </param>
+/// <param name="codec"> Encoding of the audio data in the file </param>
+//////////////////////////////////////////////////////////////////////////
+void WriteWaveFile(const std::string& path, const std::vector<int16_t>& samples,
+	unsigned int sampleRate, const WaveInfo& info, WaveCodec codec = WaveCodec::Pcm);
+
+} // namespace kvasir
+
+#endif // KVASIR_WAVE_FILE_H_INCLUDED